@@ -0,0 +1,1014 @@
+/****************************************************************************
+ #
+ #  VSTRING Library
+ #
+ #  Copyright (c) 1996-2023 Vladi Belperchinov-Shabanski "Cade" 
+ #  http://cade.noxrun.com/  <cade@noxrun.com> <cade@bis.bg> <cade@cpan.org>
+ #
+ #  Distributed under the GPL license, you should receive copy of GPLv2!
+ #
+ #  SEE 'README', 'LICENSE' OR 'COPYING' FILE FOR LICENSE AND OTHER DETAILS!
+ #
+ #  VSTRING library provides wide set of string manipulation features
+ #  including dynamic string object that can be freely exchanged with
+ #  standard char* (or wchar_t*) type, so there is no need to change 
+ #  function calls nor the implementation when you change from 
+ #  char* to VString (and from wchar_t* to WString). 
+ # 
+ ***************************************************************************/
+
+/*
+** simple benchmarks, usage:
+**
+**   make bench
+**   ./bench [count] [test-name]
+**
+** count is the base element count (default 1000000), test-name runs only
+** the benchmarks which names start with it.
+*/
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <malloc.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "vstring.h"
+#include "wstring.h"
+#include "vstrlib.h"
+#include "wstrlib.h"
+
+int         bench_count = 1000000;
+const char* bench_only  = NULL;
+
+double bench_now()
+{
+  struct timeval tv;
+  gettimeofday( &tv, NULL );
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int bench_run( const char* name )
+{
+  if ( bench_only && strncmp( name, bench_only, strlen( bench_only ) ) ) return 0;
+  return 1;
+}
+
+void bench_report( const char* name, int ops, double t )
+{
+  printf( "%-32s %10d ops %10.3f sec %10.1f ns/op\n", name, ops, t, ops ? t * 1e9 / ops : 0.0 );
+}
+
+/***************************************************************************/
+
+void bench_array_queue()
+{
+  int n = bench_count;
+  double t;
+
+  if ( bench_run( "array-push" ) )
+    {
+    VArray va;
+    t = bench_now();
+    for( int i = 0; i < n; i++ ) va.push( "element" );
+    bench_report( "array-push", n, bench_now() - t );
+    }
+
+  if ( bench_run( "array-queue" ) )
+    {
+    // FIFO work queue: keep ~n/10 elements, push at the back, shift at the front
+    VArray va;
+    int keep = n / 10;
+    t = bench_now();
+    for( int i = 0; i < keep; i++ ) va.push( "job" );
+    for( int i = 0; i < n; i++ )
+      {
+      va.push( "job" );
+      va.shift();
+      }
+    bench_report( "array-queue push+shift", n, bench_now() - t );
+    }
+
+  if ( bench_run( "array-deque" ) )
+    {
+    // deque: unshift at the front, pop at the back
+    VArray va;
+    int keep = n / 10;
+    t = bench_now();
+    for( int i = 0; i < keep; i++ ) va.unshift( "job" );
+    for( int i = 0; i < n; i++ )
+      {
+      va.unshift( "job" );
+      va.pop();
+      }
+    bench_report( "array-deque unshift+pop", n, bench_now() - t );
+    }
+}
+
+/***************************************************************************/
+
+// synthetic web/app log lines, long shared prefixes like real logs
+void bench_log_lines( VArray& va, int n )
+{
+  const char* meth[] = { "GET", "POST", "PUT", "DELETE" };
+  const char* path[] = { "/index.html", "/api/v1/users", "/api/v1/orders", "/static/app.js", "/login" };
+  char buf[256];
+  srand( 1 );
+  va.undef();
+  va.reserve( n );
+  for( int i = 0; i < n; i++ )
+    {
+    snprintf( buf, sizeof( buf ), "2023-10-%02d %02d:%02d:%02d.%03d host%03d %s %s?id=%d status=%d",
+              1 + rand() % 28, rand() % 24, rand() % 60, rand() % 60, rand() % 1000,
+              rand() % 200, meth[rand() % 4], path[rand() % 5], rand(), rand() % 5 ? 200 : 404 );
+    va.push( buf );
+    }
+}
+
+int bench_strcmp( const char* a, const char* b )
+{
+  return strcmp( a, b );
+}
+
+void bench_array_sort()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+
+  if ( ! bench_run( "array-sort" ) ) return;
+
+  bench_log_lines( va, n );
+
+  VArray vs = va;
+  vs.reserve( n ); // detach before timing
+  t = bench_now();
+  vs.sort();
+  bench_report( "array-sort", n, bench_now() - t );
+
+  t = bench_now();
+  vs.sort();
+  bench_report( "array-sort sorted", n, bench_now() - t );
+
+  vs = va;
+  vs.reserve( n );
+  t = bench_now();
+  vs.sort( 1 );
+  bench_report( "array-sort reverse", n, bench_now() - t );
+
+  vs = va;
+  vs.reserve( n );
+  t = bench_now();
+  vs.sort( 0, bench_strcmp );
+  bench_report( "array-sort comparator", n, bench_now() - t );
+
+  vs = va;
+  vs.reserve( n );
+  t = bench_now();
+  vs.sort_stable();
+  bench_report( "array-sort stable", n, bench_now() - t );
+}
+
+void bench_array_sort_threads()
+{
+  int n = bench_count;
+  double t;
+  char name[64];
+  VArray va;
+
+  if ( ! bench_run( "array-psort" ) ) return;
+
+  bench_log_lines( va, n );
+
+  int threads[] = { 1, 2, 4, 8, 16 };
+  for( int i = 0; i < 5; i++ )
+    {
+    vs_set_parallel_threads( threads[i] );
+
+    VArray vs = va;
+    vs.reserve( n );
+    t = bench_now();
+    vs.sort();
+    snprintf( name, sizeof( name ), "array-psort %d threads", threads[i] );
+    bench_report( name, n, bench_now() - t );
+
+    vs = va;
+    vs.reserve( n );
+    t = bench_now();
+    vs.sort_stable();
+    snprintf( name, sizeof( name ), "array-psort stable %d threads", threads[i] );
+    bench_report( name, n, bench_now() - t );
+    }
+  vs_set_parallel_threads( 0 );
+}
+
+/***************************************************************************/
+
+int bench_numcmp( const char* a, const char* b )
+{
+  double x = strtod( a, NULL );
+  double y = strtod( b, NULL );
+  return x < y ? -1 : x > y;
+}
+
+int bench_natcmp( const char* a, const char* b )
+{
+  while( *a && *b )
+    {
+    if ( isdigit( *a ) && isdigit( *b ) )
+      {
+      char *ea, *eb;
+      unsigned long x = strtoul( a, &ea, 10 );
+      unsigned long y = strtoul( b, &eb, 10 );
+      if ( x != y ) return x < y ? -1 : 1;
+      a = ea;
+      b = eb;
+      continue;
+      }
+    if ( *a != *b ) return (unsigned char)*a < (unsigned char)*b ? -1 : 1;
+    a++;
+    b++;
+    }
+  return (unsigned char)*a - (unsigned char)*b;
+}
+
+void bench_array_sort_keys()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+  VArray vs;
+
+  if ( ! bench_run( "array-ksort" ) ) return;
+
+  srand( 1 );
+  va.reserve( n );
+  for( int i = 0; i < n; i++ )
+    {
+    char buf[64];
+    snprintf( buf, sizeof( buf ), "%d.%03d", rand() % 1000000, rand() % 1000 );
+    va.push( buf );
+    }
+
+  vs = va;
+  vs.reserve( n );
+  t = bench_now();
+  vs.sort( 0, bench_numcmp );
+  bench_report( "array-ksort numeric comparator", n, bench_now() - t );
+
+  vs = va;
+  vs.reserve( n );
+  t = bench_now();
+  vs.sort_numeric();
+  bench_report( "array-ksort numeric", n, bench_now() - t );
+
+  bench_log_lines( va, n );
+
+  vs = va;
+  vs.reserve( n );
+  t = bench_now();
+  vs.sort( 0, bench_natcmp );
+  bench_report( "array-ksort natural comparator", n, bench_now() - t );
+
+  vs = va;
+  vs.reserve( n );
+  t = bench_now();
+  vs.sort_natural();
+  bench_report( "array-ksort natural", n, bench_now() - t );
+
+  vs = va;
+  vs.reserve( n );
+  t = bench_now();
+  vs.sort_field( 4 );
+  bench_report( "array-ksort field", n, bench_now() - t );
+}
+
+/***************************************************************************/
+
+void bench_array_read_shared()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+
+  if ( ! bench_run( "array-read" ) ) return;
+
+  for( int i = 0; i < 1000; i++ ) va.push( "shared element" );
+
+  // copy of a shared array, then read-only scan through operator[]
+  long sum = 0;
+  int rounds = n / 1000 > 0 ? n / 1000 : 1;
+  t = bench_now();
+  for( int r = 0; r < rounds; r++ )
+    {
+    VArray vb = va;
+    for( int i = 0; i < vb.count(); i++ )
+      sum += str_len( vb[i] );
+    }
+  bench_report( "array-read shared copy", rounds * 1000, bench_now() - t );
+  if ( sum < 0 ) printf( "%ld\n", sum );
+}
+
+/***************************************************************************/
+
+void bench_array_cow()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+
+  if ( ! bench_run( "array-cow" ) ) return;
+
+  for( int i = 0; i < n; i++ ) va.push( "shared element" );
+
+  // write one element of a shared array: detach cost
+  int rounds = 100;
+  t = bench_now();
+  for( int r = 0; r < rounds; r++ )
+    {
+    VArray vb = va;
+    vb.set( r * ( n / rounds ), "changed" );
+    }
+  bench_report( "array-cow write one of shared", rounds, bench_now() - t );
+
+  t = bench_now();
+  for( int r = 0; r < rounds; r++ )
+    {
+    VArray vb = va.slice( n / 4, n / 2 );
+    }
+  bench_report( "array-cow slice half", rounds, bench_now() - t );
+
+  t = bench_now();
+  for( int r = 0; r < rounds; r++ )
+    {
+    VArray vc;
+    vc.push( &va );
+    }
+  bench_report( "array-cow concat", rounds, bench_now() - t );
+}
+
+void bench_array_fload()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+  const char* fn = "/tmp/vstring.bench.fload";
+
+  if ( ! bench_run( "array-fload" ) ) return;
+
+  bench_log_lines( va, n );
+  va.fsave( fn );
+
+  t = bench_now();
+  va.fload( fn );
+  bench_report( "array-fload file", va.count(), bench_now() - t );
+
+  FILE* f = fopen( fn, "r" );
+  t = bench_now();
+  va.fload( f );
+  bench_report( "array-fload FILE*", va.count(), bench_now() - t );
+  fclose( f );
+
+  WArray wa;
+  t = bench_now();
+  wa.fload( fn );
+  bench_report( "array-fload wide file", wa.count(), bench_now() - t );
+  remove( fn );
+}
+
+void bench_array_fsave()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+  const char* fn = "/tmp/vstring.bench.fsave";
+
+  if ( ! bench_run( "array-fsave" ) ) return;
+
+  bench_log_lines( va, n );
+
+  t = bench_now();
+  va.fsave( fn );
+  bench_report( "array-fsave", va.count(), bench_now() - t );
+
+  WArray wa;
+  wa.fload( fn );
+  t = bench_now();
+  wa.fsave( fn );
+  bench_report( "array-fsave wide", wa.count(), bench_now() - t );
+
+  VTrie tr;
+  for( int i = 0; i + 1 < va.count(); i += 2 )
+    tr[ va[i] ] = va[i + 1];
+  t = bench_now();
+  tr.fsave( fn );
+  bench_report( "array-fsave trie", tr.count(), bench_now() - t );
+  remove( fn );
+}
+
+void bench_array_bload()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+  const char* fn = "/tmp/vstring.bench.bload";
+
+  if ( ! bench_run( "array-bload" ) ) return;
+
+  bench_log_lines( va, n );
+
+  t = bench_now();
+  va.bsave( fn );
+  bench_report( "array-bload bsave", va.count(), bench_now() - t );
+
+  t = bench_now();
+  va.bload( fn );
+  bench_report( "array-bload bload", va.count(), bench_now() - t );
+
+  VArrayMap vm;
+  int len = 0;
+  t = bench_now();
+  vm.open( fn );
+  bench_report( "array-bload map open", 1, bench_now() - t );
+  t = bench_now();
+  for( int i = 0; i < vm.count(); i++ )
+    len += vm.len( i );
+  bench_report( "array-bload map scan", vm.count(), bench_now() - t );
+  vm.close();
+  if ( len < 0 ) printf( "%d\n", len );
+  remove( fn );
+}
+
+void bench_array_grep_up( VString& s, int, void* )
+{
+  str_up( s );
+}
+
+void bench_array_grep()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+  int i;
+
+  if ( ! bench_run( "array-grep" ) ) return;
+
+  bench_log_lines( va, n );
+
+  t = bench_now();
+  VRegexp re( "status=404" );
+  VArray vl;
+  for( i = 0; i < va.count(); i++ )
+    if ( re.m( va[i] ) ) vl.push( va[i] );
+  bench_report( "array-grep loop m()", n, bench_now() - t );
+
+  t = bench_now();
+  VArray vg = str_grep( va, "status=404" );
+  bench_report( "array-grep str_grep", n, bench_now() - t );
+
+  t = bench_now();
+  vg = str_grep( va, "status=404", "f" );
+  bench_report( "array-grep str_grep find", n, bench_now() - t );
+
+  t = bench_now();
+  VArray vm;
+  for( i = 0; i < va.count(); i++ )
+    {
+    VString s = va[i];
+    str_up( s );
+    vm.push( s );
+    }
+  bench_report( "array-grep loop str_up", n, bench_now() - t );
+
+  t = bench_now();
+  vm = va.map( bench_array_grep_up );
+  bench_report( "array-grep map str_up", n, bench_now() - t );
+  if ( vl.count() != vg.count() ) printf( "grep mismatch\n" );
+}
+
+void bench_array_uniq()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+  VArray vb;
+  char buf[64];
+  int i;
+
+  if ( ! bench_run( "array-uniq" ) ) return;
+
+  // about 4 repeats of each key
+  srand( 1 );
+  for( i = 0; i < n; i++ )
+    {
+    int r = rand() % ( n / 4 + 1 );
+    snprintf( buf, sizeof( buf ), "host%03d /api/v1/users?id=%d", r % 200, r );
+    va.push( buf );
+    r = rand() % ( n / 4 + 1 );
+    snprintf( buf, sizeof( buf ), "host%03d /api/v1/users?id=%d", r % 200, r );
+    vb.push( buf );
+    }
+
+  t = bench_now();
+  VArray vs = va;
+  vs.sort();
+  VArray vu;
+  for( i = 0; i < vs.count(); i++ )
+    if ( i == 0 || strcmp( vs[i], vs[i-1] ) ) vu.push( vs[i] );
+  bench_report( "array-uniq sort+scan", n, bench_now() - t );
+
+  t = bench_now();
+  VTrie tr;
+  VArray vt;
+  for( i = 0; i < va.count(); i++ )
+    if ( ! tr.exists( va[i] ) )
+      {
+      tr[ va[i] ] = "";
+      vt.push( va[i] );
+      }
+  bench_report( "array-uniq trie", n, bench_now() - t );
+
+  t = bench_now();
+  VArray vh = va;
+  vh.uniq();
+  bench_report( "array-uniq hash", n, bench_now() - t );
+
+  t = bench_now();
+  VArray sb = vb;
+  sb.sort();
+  VArray vi;
+  int j = 0;
+  for( i = 0; i < vs.count(); i++ )
+    {
+    if ( i > 0 && strcmp( vs[i], vs[i-1] ) == 0 ) continue;
+    while( j < sb.count() && strcmp( sb[j], vs[i] ) < 0 ) j++;
+    if ( j < sb.count() && strcmp( sb[j], vs[i] ) == 0 ) vi.push( vs[i] );
+    }
+  bench_report( "array-uniq sort intersect", 2 * n, bench_now() - t );
+
+  t = bench_now();
+  VArray hi = va.intersect( &vb );
+  bench_report( "array-uniq hash intersect", 2 * n, bench_now() - t );
+
+  t = bench_now();
+  VArray hu = va.unite( &vb );
+  bench_report( "array-uniq hash unite", 2 * n, bench_now() - t );
+
+  if ( vu.count() != vh.count() || vt.count() != vh.count() || vi.count() != hi.count() )
+    printf( "uniq mismatch\n" );
+}
+
+void bench_str_join()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+
+  if ( ! bench_run( "str-join" ) ) return;
+
+  bench_log_lines( va, n );
+
+  t = bench_now();
+  VString s1;
+  for( int i = 0; i < va.count(); i++ )
+    {
+    if ( i ) s1 += ",";
+    s1 += va[i];
+    }
+  bench_report( "str-join loop +=", n, bench_now() - t );
+
+  t = bench_now();
+  VString s2 = str_join( va, "," );
+  bench_report( "str-join", n, bench_now() - t );
+
+  VTrie tr;
+  for( int i = 0; i + 1 < va.count(); i += 2 )
+    tr[ va[i] ] = va[i + 1];
+  t = bench_now();
+  VString s3 = str_join_values( tr, "," );
+  bench_report( "str-join trie values", tr.count(), bench_now() - t );
+  if ( s1 != s2 ) printf( "join mismatch\n" );
+}
+
+void bench_str_split()
+{
+  int n = bench_count / 10; // old split was quadratic on long lines
+  double t;
+  VArray va;
+
+  if ( ! bench_run( "str-split" ) ) return;
+
+  for( int i = 0; i < n; i++ )
+    va.push( VString( i * 7919 ) );
+  VString line = str_join( va, ", " );
+
+  t = bench_now();
+  va = str_split( ", *", line );
+  bench_report( "str-split regexp", va.count(), bench_now() - t );
+
+  t = bench_now();
+  va = str_split( ",", line );
+  bench_report( "str-split char", va.count(), bench_now() - t );
+
+  t = bench_now();
+  va = str_split( ", ", line );
+  bench_report( "str-split string", va.count(), bench_now() - t );
+
+  VTokenizer tk( ", *" );
+  int c = 0;
+  t = bench_now();
+  tk.reset( line );
+  while( tk.next() ) c++;
+  bench_report( "str-split tokenizer", c, bench_now() - t );
+
+  // typical use: look at first fields of many short lines only
+  VString rec = "GET /index.html 200 5120 - Mozilla/5.0 (X11; Linux x86_64) en-US";
+  t = bench_now();
+  for( int i = 0; i < n; i++ )
+    {
+    va = str_split( " ", rec );
+    c += atoi( va.get( 2 ) );
+    }
+  bench_report( "str-split 3rd field array", n, bench_now() - t );
+  tk.set_string( " " );
+  t = bench_now();
+  for( int i = 0; i < n; i++ )
+    {
+    tk.reset( rec );
+    tk.next(); tk.next(); tk.next();
+    c += atoi( tk.ptr() );
+    }
+  bench_report( "str-split 3rd field tokenizer", n, bench_now() - t );
+
+  int* pos = (int*)malloc( 2 * n * sizeof( int ) );
+  t = bench_now();
+  c = str_split_pos( pos, n, ",", line );
+  bench_report( "str-split char positions", c, bench_now() - t );
+  free( pos );
+}
+
+void bench_csv()
+{
+  int n = bench_count;
+  double t;
+  VArray va;
+  const char* fn = "/tmp/vstring.bench.csv";
+
+  if ( ! bench_run( "csv" ) ) return;
+
+  FILE* f = fopen( fn, "wb" );
+  for( int i = 0; i < n; i++ )
+    fprintf( f, "%d,user%d,\"Doe, John\",%d.%02d,2023-01-%02d,\"said \"\"hi\"\"\",ok\n", i, i % 1000, i % 500, i % 100, i % 28 + 1 );
+  fclose( f );
+
+  VCSV csv;
+  long sum = 0;
+  t = bench_now();
+  csv.open( fn );
+  while( csv.next() ) sum += csv.len( 2 );
+  bench_report( "csv file rows", n, bench_now() - t );
+
+  f = fopen( fn, "rb" );
+  t = bench_now();
+  csv.open( f );
+  while( csv.next() ) sum += csv.len( 2 );
+  bench_report( "csv FILE* rows", n, bench_now() - t );
+  fclose( f );
+
+  // naive way: load lines, split each one (quotes are not handled)
+  t = bench_now();
+  va.fload( fn );
+  VArray row;
+  for( int i = 0; i < va.count(); i++ )
+    {
+    row.undef();
+    str_split( row, ",", va.get( i ) );
+    sum += str_len( row[2] );
+    }
+  bench_report( "csv fload+split rows", n, bench_now() - t );
+
+  csv.open( fn );
+  t = bench_now();
+  while( csv.next() )
+    {
+    row.undef();
+    csv.row( row );
+    }
+  bench_report( "csv file rows to VArray", n, bench_now() - t );
+
+  WCSV wcsv;
+  t = bench_now();
+  wcsv.open( fn );
+  while( wcsv.next() ) sum += wcsv.len( 2 );
+  bench_report( "csv wide file rows", n, bench_now() - t );
+  remove( fn );
+  if ( sum == 42 ) printf( "\n" );
+}
+
+long bench_heap()
+{
+  struct mallinfo2 mi = mallinfo2();
+  return mi.uordblks + mi.hblkhd;
+}
+
+void bench_trie_keys( VArray& va, int n, int paths )
+{
+  char buf[256];
+  srand( 7 );
+  va.undef();
+  va.reserve( n );
+  for( int i = 0; i < n; i++ )
+    {
+    if ( paths )
+      snprintf( buf, sizeof( buf ), "/usr/share/doc/package-%d/examples/file-%d.txt", rand() % ( n / 10 + 1 ), i );
+    else
+      snprintf( buf, sizeof( buf ), "%08x%04x", (unsigned)rand(), i & 0xffff );
+    va.push( buf );
+    }
+}
+
+void bench_trie()
+{
+  int n = bench_count / 2;
+  double t;
+  VArray va;
+
+  if ( ! bench_run( "trie" ) ) return;
+
+  for( int paths = 0; paths < 2; paths++ )
+    {
+    const char* name[] = { "trie hex", "trie path" };
+    char rn[64];
+    bench_trie_keys( va, n, paths );
+    long mem = bench_heap();
+    VTrie tr;
+    t = bench_now();
+    for( int i = 0; i < n; i++ )
+      tr.set( va.get( i ), "v" );
+    snprintf( rn, sizeof( rn ), "%s set", name[paths] );
+    bench_report( rn, n, bench_now() - t );
+    printf( "%-32s %10.1f bytes/key\n", name[paths], (double)( bench_heap() - mem ) / n );
+    tr.print_stats(); // depth is nodes visited (cache misses) per lookup
+
+    long found = 0;
+    t = bench_now();
+    for( int i = 0; i < n; i++ )
+      found += tr.get( va.get( ( i * 7919L ) % n ) ) != NULL;
+    snprintf( rn, sizeof( rn ), "%s get", name[paths] );
+    bench_report( rn, n, bench_now() - t );
+
+    t = bench_now();
+    for( int i = 0; i < n; i++ )
+      found += tr.exists( va.get( i ) + 1 );
+    snprintf( rn, sizeof( rn ), "%s get missing", name[paths] );
+    bench_report( rn, n, bench_now() - t );
+
+    if ( paths )
+      {
+      char buf[128];
+      long hits = 0;
+      t = bench_now();
+      for( int i = 0; i < 1000; i++ )
+        {
+        snprintf( buf, sizeof( buf ), "/usr/share/doc/package-%d/", i );
+        hits += tr.keys_with_prefix( buf ).count();
+        }
+      bench_report( "trie path keys_with_prefix", 1000, bench_now() - t );
+      t = bench_now();
+      for( int i = 0; i < n; i++ )
+        hits += tr.longest_prefix( va.get( i ) ) != NULL;
+      bench_report( "trie path longest_prefix", n, bench_now() - t );
+      if ( hits < n ) printf( "trie path prefixes found %ld!\n", hits );
+
+      // text file vs compiled image
+      const char* fn = "/tmp/vstring.bench.trie";
+      VTrie tl;
+      tr.fsave( fn );
+      t = bench_now();
+      tl.fload( fn );
+      bench_report( "trie path fload", n, bench_now() - t );
+      t = bench_now();
+      tr.bsave( fn );
+      bench_report( "trie path bsave", n, bench_now() - t );
+      t = bench_now();
+      tl.bload( fn );
+      bench_report( "trie path bload", n, bench_now() - t );
+      tl.undef();
+      VTrieMap tm;
+      t = bench_now();
+      tm.open( fn );
+      bench_report( "trie path map open", 1, bench_now() - t );
+      hits = 0;
+      t = bench_now();
+      for( int i = 0; i < n; i++ )
+        hits += tm.get( va.get( ( i * 7919L ) % n ) ) != NULL;
+      bench_report( "trie path map get", n, bench_now() - t );
+      t = bench_now();
+      for( int i = 0; i < 1000; i++ )
+        {
+        snprintf( buf, sizeof( buf ), "/usr/share/doc/package-%d/", i );
+        hits += tm.count( buf );
+        }
+      bench_report( "trie path map count prefix", 1000, bench_now() - t );
+      if ( hits < n || tm.count() != n ) printf( "trie path map found %ld of %d!\n", hits, n );
+      tm.close();
+      remove( fn );
+      }
+
+    t = bench_now();
+    for( int i = 0; i < 1000; i++ )
+      {
+      VTrie ts = tr;
+      ts.set( va.get( i ), "w" ); // copies the path to the key only
+      }
+    snprintf( rn, sizeof( rn ), "%s copy+set", name[paths] );
+    bench_report( rn, 1000, bench_now() - t );
+
+    VTrie tc = tr;
+    t = bench_now();
+    tc.vacuum(); // own copy of all nodes
+    snprintf( rn, sizeof( rn ), "%s clone", name[paths] );
+    bench_report( rn, n, bench_now() - t );
+    t = bench_now();
+    tc.undef();
+    snprintf( rn, sizeof( rn ), "%s undef", name[paths] );
+    bench_report( rn, n, bench_now() - t );
+
+    for( int i = 0; i < n; i += 2 )
+      tr.del( va.get( i ) );
+    t = bench_now();
+    int vc = tr.vacuum();
+    snprintf( rn, sizeof( rn ), "%s vacuum", name[paths] );
+    bench_report( rn, n / 2, bench_now() - t );
+    printf( "%-32s %10.1f bytes/key released\n", name[paths], (double)vc / ( n / 2 ) );
+
+    t = bench_now();
+    for( int i = 1; i < n; i += 2 )
+      tr.del( va.get( i ) );
+    snprintf( rn, sizeof( rn ), "%s del", name[paths] );
+    bench_report( rn, n / 2, bench_now() - t );
+    if ( found != n ) printf( "trie found %ld of %d!\n", found, n );
+    }
+
+  WArray wa;
+  for( int i = 0; i < n / 4; i++ )
+    {
+    WString ws = L"\x43a\x43b\x44e\x447-";
+    ws += i * 7;
+    wa.push( ws );
+    }
+  WTrie wt;
+  t = bench_now();
+  for( int i = 0; i < wa.count(); i++ )
+    wt.set( wa.get( i ), L"v" );
+  bench_report( "trie wide set", wa.count(), bench_now() - t );
+  t = bench_now();
+  long found = 0;
+  for( int i = 0; i < wa.count(); i++ )
+    found += wt.exists( wa.get( i ) );
+  bench_report( "trie wide get", wa.count(), bench_now() - t );
+  if ( found != wa.count() ) printf( "wide trie found %ld of %d!\n", found, wa.count() );
+}
+
+void bench_hash()
+{
+  int n = bench_count / 2;
+  double t;
+  VArray va;
+
+  if ( ! bench_run( "hash" ) ) return;
+
+  bench_trie_keys( va, n, 1 );
+  long mem = bench_heap();
+  VHash hs;
+  t = bench_now();
+  for( int i = 0; i < n; i++ )
+    hs.set( va.get( i ), "v" );
+  bench_report( "hash set", n, bench_now() - t );
+  printf( "%-32s %10.1f bytes/key\n", "hash", (double)( bench_heap() - mem ) / n );
+
+  long found = 0;
+  t = bench_now();
+  for( int i = 0; i < n; i++ )
+    found += hs.get( va.get( ( i * 7919L ) % n ) ) != NULL;
+  bench_report( "hash get", n, bench_now() - t );
+
+  t = bench_now();
+  for( int i = 0; i < n; i++ )
+    found += hs.exists( va.get( i ) + 1 );
+  bench_report( "hash get missing", n, bench_now() - t );
+
+  t = bench_now();
+  for( int i = 0; i < n; i++ )
+    hs.del( va.get( i ) );
+  bench_report( "hash del", n, bench_now() - t );
+  if ( found != n ) printf( "hash found %ld of %d!\n", found, n );
+}
+
+void bench_datrie()
+{
+  int n = bench_count / 2;
+  double t;
+  VArray va;
+
+  if ( ! bench_run( "datrie" ) ) return;
+
+  // same lookups over frozen keys: double-array vs radix tree, hash and std ones
+  for( int paths = 0; paths < 2; paths++ )
+    {
+    const char* name = paths ? "datrie path" : "datrie hex";
+    char rn[64];
+    bench_trie_keys( va, n, paths );
+    VTrie tr;
+    VHash hs;
+    std::map<std::string,std::string> sm;
+    std::unordered_map<std::string,std::string> um;
+    for( int i = 0; i < n; i++ )
+      {
+      tr.set( va.get( i ), "v" );
+      hs.set( va.get( i ), "v" );
+      sm[ va.get( i ) ] = "v";
+      um[ va.get( i ) ] = "v";
+      }
+
+    long mem = bench_heap();
+    VDATrie da;
+    t = bench_now();
+    da.build( tr );
+    snprintf( rn, sizeof( rn ), "%s build", name );
+    bench_report( rn, n, bench_now() - t );
+    printf( "%-32s %10.1f bytes/key\n", name, (double)( bench_heap() - mem ) / n );
+    da.print_stats();
+
+    long found = 0;
+    t = bench_now();
+    for( int i = 0; i < n; i++ )
+      found += da.get( va.get( ( i * 7919L ) % n ) ) != NULL;
+    snprintf( rn, sizeof( rn ), "%s get", name );
+    bench_report( rn, n, bench_now() - t );
+
+    t = bench_now();
+    for( int i = 0; i < n; i++ )
+      found += da.exists( va.get( i ) + 1 );
+    snprintf( rn, sizeof( rn ), "%s get missing", name );
+    bench_report( rn, n, bench_now() - t );
+
+    t = bench_now();
+    for( int i = 0; i < n; i++ )
+      found += tr.get( va.get( ( i * 7919L ) % n ) ) != NULL;
+    snprintf( rn, sizeof( rn ), "%s trie get", name );
+    bench_report( rn, n, bench_now() - t );
+
+    t = bench_now();
+    for( int i = 0; i < n; i++ )
+      found += hs.get( va.get( ( i * 7919L ) % n ) ) != NULL;
+    snprintf( rn, sizeof( rn ), "%s hash get", name );
+    bench_report( rn, n, bench_now() - t );
+
+    t = bench_now();
+    for( int i = 0; i < n; i++ )
+      found += sm.find( va.get( ( i * 7919L ) % n ) ) != sm.end();
+    snprintf( rn, sizeof( rn ), "%s std::map get", name );
+    bench_report( rn, n, bench_now() - t );
+
+    t = bench_now();
+    for( int i = 0; i < n; i++ )
+      found += um.find( va.get( ( i * 7919L ) % n ) ) != um.end();
+    snprintf( rn, sizeof( rn ), "%s std::unordered_map get", name );
+    bench_report( rn, n, bench_now() - t );
+
+    if ( found != 5L * n ) printf( "%s found %ld of %ld!\n", name, found, 5L * n );
+    }
+}
+
+int main( int argc, char** argv )
+{
+  if ( argc > 1 ) bench_count = atoi( argv[1] );
+  if ( argc > 2 ) bench_only  = argv[2];
+  if ( bench_count < 1 ) bench_count = 1;
+
+  bench_array_queue();
+  bench_array_sort();
+  bench_array_sort_threads();
+  bench_array_sort_keys();
+  bench_array_read_shared();
+  bench_array_cow();
+  bench_array_fload();
+  bench_array_fsave();
+  bench_array_bload();
+  bench_array_grep();
+  bench_array_uniq();
+  bench_str_join();
+  bench_str_split();
+  bench_csv();
+  bench_trie();
+  bench_hash();
+  bench_datrie();
+  return 0;
+}
+
+/***************************************************************************
+**
+** EOF
+**
+****************************************************************************/
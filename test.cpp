@@ -18,6 +18,8 @@
  ***************************************************************************/
 
 #include <stdio.h>
+#include <algorithm>
+#include <unistd.h>
 #include "vstring.h"
 #include "vstrlib.h"
 
@@ -464,9 +466,1460 @@ void test9()
   va2.push( &va );
 
   va2.print();
-  
+  ASSERT( va2.count() == 5 + 2 * va.count() );
+  ASSERT( strcmp( va2[0], "one" ) == 0 );
+  ASSERT( strcmp( va2[va.count()], "0" ) == 0 );
+
+  VArray va3;
+  va3.reserve( 100000 );
+  for( int i = 0; i < 100000; i++ )
+    va3.push( VString( i ) );
+  ASSERT( va3.count() == 100000 );
+  while( va3.count() > 10 )
+    va3.pop();
+  ASSERT( strcmp( va3[9], "9" ) == 0 );
+}
+
+void test10()
+{
+  // queue/deque use of VArray, shift()/unshift() work on the head offset
+  VArray va;
+  int i;
+  for( i = 0; i < 5000; i++ )
+    {
+    va.push( VString( i ) );
+    if ( i % 2 ) va.shift();
+    }
+  ASSERT( va.count() == 2500 );
+  ASSERT( strcmp( va[0], "2500" ) == 0 );
+  ASSERT( strcmp( va[2499], "4999" ) == 0 );
+
+  for( i = 0; i < 3000; i++ )
+    va.unshift( VString( -i ) );
+  ASSERT( va.count() == 5500 );
+  ASSERT( strcmp( va[0], "-2999" ) == 0 );
+  ASSERT( strcmp( va[2999], "0" ) == 0 );
+  ASSERT( strcmp( va[3000], "2500" ) == 0 );
+
+  va.ins( 10, "ten" );
+  va.del( 20 );
+  va.ins( 5000, "five thousand" );
+  va.del( 5400 );
+  ASSERT( va.count() == 5500 );
+  ASSERT( strcmp( va[10], "ten" ) == 0 );
+  ASSERT( strcmp( va[5000], "five thousand" ) == 0 );
+
+  VArray vb = va; // shared, shift() must detach
+  vb.shift();
+  ASSERT( va.count() == 5500 && vb.count() == 5499 );
+  ASSERT( strcmp( va[0], "-2999" ) == 0 );
+
+  while( va.count() ) va.shift();
+  va.unshift( "last" );
+  ASSERT( va.count() == 1 && strcmp( va[0], "last" ) == 0 );
+}
+
+int test11_cmp_len( const char* a, const char* b )
+{
+  return (int)strlen( a ) - (int)strlen( b );
+}
+
+void test11()
+{
+  // sort engine: long shared prefixes, duplicates, empty and 8-bit strings
+  VArray va;
+  VArray vs;
+  int i;
+  srand( 11 );
+  for( i = 0; i < 20000; i++ )
+    {
+    VString s;
+    char b[8];
+    switch( i % 4 )
+      {
+      case 0: s = "2023-10-19 12:00:00 host GET /index/"; s += rand() % 500; break;
+      case 1: s = "2023-10-19 12:00:00 host"; break;
+      case 2: s = ""; break;
+      case 3: sprintf( b, "\xd0\xb0\xd0\xb1%c", 'a' + rand() % 26 ); s = b; break;
+      }
+    va.push( s );
+    }
+  vs = va;
+
+  va.sort();
+  ASSERT( va.count() == 20000 && vs.count() == 20000 );
+  for( i = 1; i < va.count(); i++ )
+    ASSERT( strcmp( va[i-1], va[i] ) <= 0 );
+  ASSERT( strcmp( va[0], "" ) == 0 );
+
+  va.sort( 1 );
+  for( i = 1; i < va.count(); i++ )
+    ASSERT( strcmp( va[i-1], va[i] ) >= 0 );
+
+  va.sort( 0, test11_cmp_len );
+  for( i = 1; i < va.count(); i++ )
+    ASSERT( strlen( va[i-1] ) <= strlen( va[i] ) );
+
+  // stable: equal length elements keep their original relative order
+  VArray vo = vs;
+  vs.sort_stable( 1, test11_cmp_len );
+  for( i = 1; i < vs.count(); i++ )
+    ASSERT( strlen( vs[i-1] ) >= strlen( vs[i] ) );
+  VArray v5;
+  for( i = 0; i < vo.count(); i++ )
+    if ( strlen( vo[i] ) == 5 ) v5.push( vo[i] );
+  int z = 0;
+  for( i = 0; i < vs.count(); i++ )
+    if ( strlen( vs[i] ) == 5 ) ASSERT( strcmp( vs[i], v5[z++] ) == 0 );
+  ASSERT( z == v5.count() && z == 5000 );
+
+  vs.sort_stable();
+  va.sort();
+  for( i = 0; i < va.count(); i++ )
+    ASSERT( strcmp( va[i], vs[i] ) == 0 );
+}
+
+void test12()
+{
+  // parallel sort must give exactly the serial order
+  int save_threshold = vs_parallel_threshold();
+  VArray va;
+  int i;
+  srand( 12 );
+  for( i = 0; i < 60000; i++ )
+    {
+    VString s = "line ";
+    s += rand() % 7000;
+    va.push( s );
+    }
+  vs_set_parallel_threshold( 1000 );
+
+  int threads[] = { 2, 3, 4, 7 };
+  for( int t = 0; t < 4; t++ )
+    {
+    VArray ps = va;
+    VArray ss = va;
+    vs_set_parallel_threads( threads[t] );
+    ps.sort( t % 2 );
+    vs_set_parallel_threads( 1 );
+    ss.sort( t % 2 );
+    ASSERT( ps.count() == ss.count() );
+    for( i = 0; i < ps.count(); i++ )
+      ASSERT( strcmp( ps[i], ss[i] ) == 0 );
+
+    ps = va;
+    ss = va;
+    vs_set_parallel_threads( threads[t] );
+    ps.sort_stable( 0, test11_cmp_len );
+    vs_set_parallel_threads( 1 );
+    ss.sort_stable( 0, test11_cmp_len );
+    for( i = 0; i < ps.count(); i++ ) // stable -- same elements, not only same lengths
+      ASSERT( strcmp( ps[i], ss[i] ) == 0 );
+    }
+
+  vs_set_parallel_threads( 0 );
+  vs_set_parallel_threshold( save_threshold );
+}
+
+void test13()
+{
+  // key-extracted sorts
+  VArray va;
+  va.push( "file10.txt" );
+  va.push( "file2.txt" );
+  va.push( "file002.txt" );
+  va.push( "file1.txt" );
+  va.push( "file0.txt" );
+  va.push( "file" );
+  va.push( "file100.txt" );
+
+  va.sort_natural();
+  const char* nat[] = { "file", "file0.txt", "file1.txt", "file2.txt", "file002.txt", "file10.txt", "file100.txt" };
+  for( int i = 0; i < 7; i++ )
+    ASSERT( strcmp( va[i], nat[i] ) == 0 );
+  va.sort_natural( 1 );
+  ASSERT( strcmp( va[0], "file100.txt" ) == 0 );
+  ASSERT( strcmp( va[2], "file2.txt" ) == 0 ); // ties keep original order
+  ASSERT( strcmp( va[3], "file002.txt" ) == 0 );
+  ASSERT( strcmp( va[4], "file1.txt" ) == 0 );
+
+  va.undef();
+  va.push( "10" );
+  va.push( "-3.5" );
+  va.push( "abc" );
+  va.push( "2e3" );
+  va.push( "9" );
+  va.sort_numeric();
+  ASSERT( strcmp( va[0], "-3.5" ) == 0 );
+  ASSERT( strcmp( va[1], "abc"  ) == 0 );
+  ASSERT( strcmp( va[2], "9"    ) == 0 );
+  ASSERT( strcmp( va[3], "10"   ) == 0 );
+  ASSERT( strcmp( va[4], "2e3"  ) == 0 );
+
+  va.undef();
+  va.push( "  host3 GET  404" );
+  va.push( "host1 PUT 200" );
+  va.push( "host2 GET 1000" );
+  va.push( "host4 GET" );
+  va.sort_field( 2, NULL, VS_SORT_NUMERIC );
+  ASSERT( strcmp( va[0], "host4 GET" ) == 0 );
+  ASSERT( strcmp( va[1], "host1 PUT 200" ) == 0 );
+  ASSERT( strcmp( va[3], "host2 GET 1000" ) == 0 );
+  va.sort_field( 1 ); // stable: GET lines keep current order
+  ASSERT( strcmp( va[0], "host4 GET" ) == 0 );
+  ASSERT( strcmp( va[1], "  host3 GET  404" ) == 0 );
+  ASSERT( strcmp( va[2], "host2 GET 1000" ) == 0 );
+  ASSERT( strcmp( va[3], "host1 PUT 200" ) == 0 );
+
+  va.undef();
+  va.push( "b;3;x" );
+  va.push( "a;;y" );
+  va.push( "c;1" );
+  va.sort_field( 2, ";" );
+  ASSERT( strcmp( va[0], "c;1" ) == 0 );
+  ASSERT( strcmp( va[1], "b;3;x" ) == 0 );
+  va.sort_field( 1, ";", VS_SORT_TEXT, 1 );
+  ASSERT( strcmp( va[0], "b;3;x" ) == 0 );
+  ASSERT( strcmp( va[2], "a;;y" ) == 0 );
+
+  va.sort_collate(); // "C" locale, same as strcmp
+  ASSERT( strcmp( va[0], "a;;y" ) == 0 );
+  ASSERT( strcmp( va[2], "c;1" ) == 0 );
+}
+
+const VString* test14_addr( const VString& s )
+{
+  return &s;
+}
+
+void test14()
+{
+  // reading through operator[] must not detach shared containers
+  VArray va;
+  int i;
+  for( i = 0; i < 100; i++ ) va.push( VString( i ) );
+  VArray vb = va;
+  const VArray& ca = va;
+  const VArray& cb = vb;
+  int sum = 0;
+  for( i = 0; i < vb.count(); i++ )
+    sum += atoi( vb[i] ) + str_len( vb[i] ) * 0;
+  ASSERT( sum == 4950 );
+  ASSERT( vb[10] == "10" && vb[10] == va[10] && "10" == vb[10] );
+  ASSERT( &ca[5] == &cb[5] ); // still the same element objects
+  ASSERT( vb[500] == "" && vb.count() == 100 ); // no extending on read
+
+  vb[5] = "five";
+  ASSERT( &ca[6] != &cb[6] ); // write detached
+  ASSERT( va[5] == "5" && vb[5] == "five" );
+  vb[6] += "x";
+  str_reverse( vb[7] );
+  vb[8][0] = 'z';
+  ASSERT( vb[6] == "6x" && vb[7] == "7" && vb[8] == "z" && va[8] == "8" );
+  vb[200] = "x";
+  ASSERT( vb.count() == 201 );
+
+  VTrie tr;
+  tr["one"] = "1";
+  VTrie tt = tr;
+  ASSERT( tt["one"] == "1" && tt["two"] == "" );
+  ASSERT( ! tt.exists( "two" ) );
+  tt["two"] = tt["one"];
+  ASSERT( tt.exists( "two" ) && ! tr.exists( "two" ) );
+
+  VString s1 = "abc";
+  VString s2 = s1;
+  ASSERT( s2[1] == 'b' && s2[-1] == 'c' && s2[9] == 0 );
+  ASSERT( s1.data() == s2.data() );
+  s2[1] = 'X';
+  s2[9] = 'X'; // off-range, ignored
+  ASSERT( s1 == "abc" && s2 == "aXc" );
+
+  // VS_STRING_CLASS methods and char arithmetic through the references
+  VArray vc = va;
+  ASSERT( vc[12].i() == 12 && vc[12].l() == 12 && vc[12].ll() == 12 && vc[12].f() == 12.0 );
+  ASSERT( &ca[12] == &((const VArray&)vc)[12] ); // reads did not detach
+  vc[12].set( "a" );
+  vc[12].cat( "bc" );
+  vc[13].catn( "xyz", 2 );
+  vc[14].i( 77 );
+  vc[15].undef();
+  vc[12].print();
+  ASSERT( vc[12] == "abc" && vc[13] == "13xy" && vc[14] == "77" && vc[15] == "" && va[12] == "12" );
+  tt["pi"].f( 3.5 );
+  tt["one"].cat( "1" );
+  ASSERT( tt["pi"].f() == 3.5 && tt["one"].i() == 11 && tr["one"] == "1" );
+  VHash hs;
+  hs["n"].i( 5 );
+  hs["n"].cat( "0" );
+  ASSERT( hs["n"].i() == 50 );
+
+  VString s3 = s1;
+  s3[0]++;
+  ++s3[1];
+  s3[2] += 2;
+  s3[2] -= 1;
+  ASSERT( s3 == "bcd" && s1 == "abc" );
+  char* p = &s3[1];
+  *p = 'z';
+  char& c = s3[0].ref();
+  c = 'y';
+  ASSERT( s3 == "yzd" && s1 == "abc" && s3[0]-- == 'y' && s3 == "xzd" );
+  vc[16][0]++;
+  ASSERT( vc[16] == "26" && va[16] == "16" );
+  VString& ve = vc[17];
+  ve = "q";
+  ASSERT( vc[17] == "q" && va[17] == "17" );
+
+  // const VS_STRING_CLASS& parameters read the shared element in place
+  VArray vd = va;
+  const VArray& cd = vd;
+  const VString* e5 = &cd[5];
+  ASSERT( test14_addr( vd[5] ) == e5 && &cd[5] == e5 && e5 == &ca[5] );
+  const VString& r5 = vd[5];
+  ASSERT( &r5 == e5 && &cd[6] == &ca[6] );
+  VString& w5 = vd[5]; // write access detaches
+  ASSERT( &w5 != e5 && &ca[5] == e5 );
+}
+
+int test15_check( VArray& va, int* ref, int n )
+{
+  if ( va.count() != n ) return 0;
+  for( int i = 0; i < n; i++ )
+    if ( atoi( va.get( i ) ) != ref[i] ) return 0;
+  return 1;
+}
+
+void test15()
+{
+  // chunked storage: copies share chunks, writes copy only touched ones
+  VArray va;
+  int i;
+  for( i = 0; i < 1000; i++ ) va.push( VString( i ) );
+  VArray vb = va;
+  const VArray& ca = va;
+  const VArray& cb = vb;
+  vb.set( 500, "x" );
+  ASSERT( va[500] == "500" && vb[500] == "x" );
+  ASSERT( &ca[0] == &cb[0] && &ca[999] == &cb[999] ); // untouched chunks are still shared
+  ASSERT( &ca[500] != &cb[500] );
+  vb.unshift( "first" );
+  vb.push( "last" );
+  ASSERT( vb.count() == 1002 && va.count() == 1000 );
+  ASSERT( vb[0] == "first" && vb[1] == "0" && vb[501] == "x" && vb[1001] == "last" );
+
+  VArray vs = va.slice( 300, 400 );
+  const VArray& cs = vs;
+  ASSERT( vs.count() == 400 && vs[0] == "300" && vs[399] == "699" );
+  ASSERT( &cs[100] == &ca[400] ); // whole chunks are shared
+  ASSERT( va.slice( -2 ).count() == 2 && va.slice( 5000 ).count() == 0 );
+  vs.reverse();
+  ASSERT( vs[0] == "699" && va[699] == "699" && va[300] == "300" );
+
+  VArray vc;
+  vc.push( &va );
+  vc.push( &va );
+  ASSERT( vc.count() == 2000 && vc[1000] == "0" && vc[1999] == "999" );
+  vc.splice( 10, 1980 );
+  ASSERT( vc.count() == 20 && vc[9] == "9" && vc[10] == "990" );
+  vc.splice( 5, 2, &vs );
+  ASSERT( vc.count() == 418 && vc[4] == "4" && vc[5] == "699" && vc[404] == "300" && vc[405] == "7" );
+
+  // random operations against plain int array
+  int  cap = 20000;
+  int* ref = new int[cap];
+  int  n   = 0;
+  int  id  = 0;
+  VArray vr;
+  VArray keep;
+  int* kref = new int[cap];
+  int  kn   = 0;
+  srand( 15 );
+  for( int step = 0; step < 20000; step++ )
+    {
+    int op = rand() % 10;
+    int p  = n > 0 ? rand() % n : 0;
+    if ( op < 3 && n < cap )
+      { // insert anywhere, ends included
+      p = rand() % ( n + 1 );
+      memmove( ref + p + 1, ref + p, ( n - p ) * sizeof( int ) );
+      ref[p] = id;
+      n++;
+      vr.ins( p, VString( id++ ) );
+      }
+    else if ( op < 5 && n > 0 )
+      {
+      memmove( ref + p, ref + p + 1, ( n - p - 1 ) * sizeof( int ) );
+      n--;
+      vr.del( p );
+      }
+    else if ( op == 5 && n > 0 )
+      {
+      ref[p] = id;
+      vr[p] = VString( id++ );
+      }
+    else if ( op == 6 )
+      { // take a snapshot and check the old one is intact
+      ASSERT( test15_check( keep, kref, kn ) );
+      keep = vr;
+      memcpy( kref, ref, n * sizeof( int ) );
+      kn = n;
+      }
+    else if ( op == 7 && n + kn <= cap )
+      {
+      if ( rand() % 2 )
+        {
+        memcpy( ref + n, kref, kn * sizeof( int ) );
+        vr.push( &keep );
+        }
+      else
+        {
+        memmove( ref + kn, ref, n * sizeof( int ) );
+        memcpy( ref, kref, kn * sizeof( int ) );
+        vr.unshift( &keep );
+        }
+      n += kn;
+      }
+    else if ( op == 8 && n > 0 )
+      {
+      int c = rand() % ( n - p + 1 );
+      memmove( ref + p, ref + p + c, ( n - p - c ) * sizeof( int ) );
+      n -= c;
+      vr.splice( p, c );
+      }
+    else if ( op == 9 && n > 0 )
+      {
+      int c = rand() % ( n - p + 1 );
+      VArray sl = vr.slice( p, c );
+      memmove( ref, ref + p, c * sizeof( int ) );
+      n = c;
+      vr = sl;
+      }
+    if ( step % 64 == 0 ) ASSERT( test15_check( vr, ref, n ) );
+    }
+  ASSERT( test15_check( vr, ref, n ) );
+  ASSERT( test15_check( keep, kref, kn ) );
+  delete [] ref;
+  delete [] kref;
+
+  // emptied by shift()/pop() then filled from other array, head chunk of
+  // the old elements must not stay in the way
+  VArray src;
+  for( i = 0; i < 200; i++ ) src.push( VString( i ) );
+  for( int u = 0; u < 2; u++ )
+    {
+    VArray ve;
+    ve.push( "x" );
+    ve.push( "y" );
+    ve.push( "z" );
+    ve.shift();
+    ve.shift();
+    u ? ve.pop() : ve.shift();
+    if ( u ) ve.unshift( &src ); else ve.push( &src );
+    ASSERT( ve.count() == 200 && ve[0] == "0" && ve[199] == "199" );
+    ve.splice( 0, 200 );
+    ve.splice( 0, 0, &src );
+    ASSERT( ve.count() == 200 && ve[128] == "128" );
+    }
+}
+
+void test16()
+{
+  // fload() maps regular files, FILE* version reads blocks
+  const char* fn = "/tmp/vstring.test16";
+  FILE* f = fopen( fn, "wb" );
+  ASSERT( f );
+  fputs( "one\r\n\ntwo\r\r\nthree\n", f );
+  VString big = "0123456789";
+  str_mul( big, 250000 ); // longer than one load window
+  fputs( big, f );
+  fputs( "\n\xD1\x8E\xFF\xD1\n", f );
+  fputs( "last", f );
+  fclose( f );
+
+  VArray va;
+  ASSERT( va.fload( fn ) == 0 );
+  ASSERT( va.count() == 7 );
+  ASSERT( va[0] == "one" && va[1] == "" && va[2] == "two" && va[3] == "three" );
+  ASSERT( va[4] == big && va[6] == "last" );
+
+  VArray vb;
+  f = fopen( fn, "rb" );
+  ASSERT( vb.fload( f ) == 0 );
+  fclose( f );
+  ASSERT( vb.count() == va.count() );
+  for( int i = 0; i < va.count(); i++ )
+    ASSERT( vb[i] == va[i] );
+
+  f = fopen( fn, "wb" );
+  fclose( f );
+  ASSERT( va.fload( fn ) == 0 && va.count() == 0 );
+  ASSERT( va.fload( "/tmp/vstring.test16.missing" ) != 0 );
+  remove( fn );
+}
+
+void test17()
+{
+  // buffered fsave(), elements larger than the write buffer included
+  const char* fn = "/tmp/vstring.test17";
+  VArray va;
+  VString big = "abc";
+  str_mul( big, 200000 );
+  for( int i = 0; i < 20000; i++ ) va.push( VString( i ) );
+  va.ins( 100, big );
+  va.push( "" );
+  ASSERT( va.fsave( fn ) == 0 );
+  VArray vb;
+  ASSERT( vb.fload( fn ) == 0 );
+  ASSERT( vb.count() == va.count() );
+  for( int i = 0; i < va.count(); i++ )
+    ASSERT( vb[i] == va[i] );
+
+  // trie is saved straight from the nodes in keys_and_values() order
+  VTrie tr;
+  tr["one"]   = "1";
+  tr["on"]    = "2";
+  tr["other"] = "3";
+  tr["x"]     = "";
+  tr["long"]  = big;
+  ASSERT( tr.fsave( fn ) == 0 );
+  VArray kv;
+  kv.push( &tr );
+  ASSERT( vb.fload( fn ) == 0 );
+  ASSERT( vb.count() == kv.count() && vb.count() == 10 );
+  ASSERT( kv[0] == "long" && kv[2] == "on" && kv[4] == "one" ); // sorted keys
+  for( int i = 0; i < kv.count(); i++ )
+    ASSERT( vb[i] == kv[i] );
+  VTrie tt;
+  ASSERT( tt.fload( fn ) == 0 );
+  ASSERT( tt["other"] == "3" && tt["long"] == big && tt.exists( "x" ) && tt.count() == 5 );
+  remove( fn );
+}
+
+void test18()
+{
+  // binary format keeps newlines, VArrayMap reads it in place
+  const char* fn = "/tmp/vstring.test18";
+  VArray va;
+  va.push( "one" );
+  va.push( "" );
+  va.push( "multi\nline\r\nvalue" );
+  for( int i = 0; i < 1000; i++ ) va.push( VString( i ) );
+  ASSERT( va.bsave( fn ) == 0 );
+
+  VArray vb;
+  ASSERT( vb.bload( fn ) == 0 );
+  ASSERT( vb.count() == va.count() );
+  for( int i = 0; i < va.count(); i++ )
+    ASSERT( vb[i] == va[i] );
+
+  VArrayMap vm;
+  ASSERT( vm.open( fn ) == 0 );
+  ASSERT( vm.count() == va.count() );
+  ASSERT( strcmp( vm[2], "multi\nline\r\nvalue" ) == 0 && vm.len( 2 ) == 17 );
+  ASSERT( vm.get( 1 ) && vm.len( 1 ) == 0 && strcmp( vm[1002], "999" ) == 0 );
+  ASSERT( vm.get( 1003 ) == NULL && vm.len( -1 ) == -1 && strcmp( vm[5000], "" ) == 0 );
+  vm.close();
+  ASSERT( vm.count() == 0 );
+
+  VArray ve;
+  ASSERT( ve.bsave( fn ) == 0 && vb.bload( fn ) == 0 && vb.count() == 0 );
+
+  // text files are not binary ones
+  va.fsave( fn );
+  ASSERT( vb.bload( fn ) == 3 && vm.open( fn ) == 3 );
+  ASSERT( vb.bload( "/tmp/vstring.test18.missing" ) == 1 );
+  remove( fn );
+}
+
+int test19_even( const char* s, int, void* )
+{
+  return atoi( s + 5 ) % 2 == 0;
+}
+
+void test19_up( VString& s, int, void* arg )
+{
+  str_up( s );
+  str_add_ch( s, *(const char*)arg );
+}
+
+void test19()
+{
+  // bulk grep/map keep order and give the same result in parallel
+  int save_threshold = vs_parallel_threshold();
+  VArray va;
+  int i;
+  for( i = 0; i < 20000; i++ )
+    {
+    VString s = "line ";
+    s += i;
+    va.push( s );
+    }
+  VArray vb = va;
+  vs_set_parallel_threshold( 1000 );
+
+  int threads[] = { 1, 2, 3, 7 };
+  for( int t = 0; t < 4; t++ )
+    {
+    vs_set_parallel_threads( threads[t] );
+
+    VArray ev = va.grep( test19_even );
+    ASSERT( ev.count() == 10000 );
+    for( i = 0; i < ev.count(); i++ )
+      ASSERT( atoi( ev[i].data() + 5 ) == 2 * i );
+
+    VArray re = str_grep( va, "7$" );
+    VArray nr = str_grep( va, "7$", NULL, 1 );
+    ASSERT( re.count() == 2000 && nr.count() == 18000 );
+    ASSERT( re[0] == "line 7" && re[1999] == "line 19997" && nr[7] == "line 8" );
+
+    VRegexp fre( "LINE 1999", "fi" );
+    VArray fi = str_grep( va, fre );
+    ASSERT( fi.count() == 11 && fi[0] == "line 1999" && fi[10] == "line 19999" );
+
+    char tail = '!';
+    VArray up = va.map( test19_up, &tail );
+    ASSERT( up.count() == va.count() );
+    for( i = 0; i < up.count(); i += 997 )
+      ASSERT( up[i] == str_up( va.get( i ) ) + "!" );
+
+    // dest versions append to pre-sized arrays, also to the source itself
+    VArray dest;
+    dest.push( "head" );
+    dest.reserve( 1 + 10000 + 2000 + va.count() );
+    ASSERT( va.grep( dest, test19_even ) == 10000 );
+    ASSERT( str_grep( dest, va, "7$" ) == 2000 );
+    ASSERT( va.map( dest, test19_up, &tail ) == va.count() );
+    ASSERT( dest.count() == 1 + 10000 + 2000 + va.count() );
+    ASSERT( dest[0] == "head" && dest[1] == "line 0" && dest[10000] == "line 19998" );
+    ASSERT( dest[10001] == "line 7" && dest[12001] == "LINE 0!" && dest[12000 + va.count()] == "LINE 19999!" );
+    VArray self = va;
+    ASSERT( self.grep( self, test19_even ) == 10000 );
+    ASSERT( self.count() == 30000 && self[20000] == "line 0" && self[29999] == "line 19998" );
+    ASSERT( va.count() == 20000 );
+    }
+  // source stays shared and intact
+  ASSERT( va[5] == "line 5" && vb[5] == "line 5" );
+  ASSERT( str_grep( va, "(" ).count() == 0 );
+  ASSERT( str_grep( vb, va, "(" ) == -1 && vb.count() == 20000 );
+  VArray empty;
+  ASSERT( empty.grep( test19_even ).count() == 0 && empty.map( test19_up ).count() == 0 );
+
+  vs_set_parallel_threads( 0 );
+  vs_set_parallel_threshold( save_threshold );
+}
+
+void test20()
+{
+  // hash based uniq and set operations keep order of first appearance
+  VArray va;
+  VArray vb;
+  int i;
+  for( i = 0; i < 5000; i++ )
+    {
+    va.push( VString( i % 1000 ) );
+    vb.push( VString( 500 + i % 1000 ) );
+    }
+  va.push( "" );
+  va.push( "" );
+
+  VArray vs = va;
+  VArray vu = va;
+  vu.uniq();
+  ASSERT( vu.count() == 1001 && va.count() == 5002 && vs.count() == 5002 );
+  for( i = 0; i < 1000; i++ )
+    ASSERT( vu[i] == VString( i ) );
+  ASSERT( vu[1000] == "" );
+  VArray vc = vu;
+  vc.uniq(); // nothing to remove, stays shared
+  ASSERT( vc.count() == 1001 );
+
+  VArray is = va.intersect( &vb );
+  ASSERT( is.count() == 500 && is[0] == "500" && is[499] == "999" );
+  VArray df = va.difference( &vb );
+  ASSERT( df.count() == 501 && df[0] == "0" && df[499] == "499" && df[500] == "" );
+  VArray un = va.unite( &vb );
+  ASSERT( un.count() == 1501 && un[1000] == "" && un[1001] == "1000" && un[1500] == "1499" );
+
+  VArray empty;
+  ASSERT( va.intersect( &empty ).count() == 0 && empty.difference( &va ).count() == 0 );
+  ASSERT( va.difference( &empty ).count() == 1001 && empty.unite( &vb ).count() == 1000 );
+
+  // same prefix, different lengths and embedded long strings
+  VArray vl;
+  VString big = "abcdefgh";
+  str_mul( big, 100 );
+  vl.push( big );
+  vl.push( "abcdefgh" );
+  vl.push( big );
+  vl.push( "abcdefg" );
+  vl.uniq();
+  ASSERT( vl.count() == 3 && vl[0] == big && vl[2] == "abcdefg" );
+}
+
+int test21_less( const VString& a, const VString& b )
+{
+  return strcmp( a, b ) < 0;
+}
+
+void test21()
+{
+  // iterators: independent positions, no detach on read, <algorithm> works
+  VArray va;
+  int i;
+  srand( 21 );
+  for( i = 0; i < 1000; i++ )
+    va.push( VString( rand() % 500 ) );
+  VArray vb = va;
+
+  i = 0;
+  for( const VString& s : va )
+    {
+    int j = 0;
+    for( const VString& t : va ) // nested loop over the same array
+      if ( s == t ) j++;
+    ASSERT( j >= 1 );
+    ASSERT( s == vb[i++] );
+    }
+  ASSERT( i == 1000 && va.end() - va.begin() == 1000 );
+  ASSERT( std::count( va.begin(), va.end(), va[7] ) >= 1 );
+  ASSERT( *std::find( va.begin(), va.end(), VString( va[500] ) ) == va[500] );
+  ASSERT( va.begin()[3] == va[3] && ( va.begin() + 10 )->data() == va[10].data() );
+
+  VArray vs = va;
+  std::sort( vs.begin_rw(), vs.end_rw(), test21_less );
+  va.sort();
+  ASSERT( vs.count() == va.count() );
+  for( i = 0; i < va.count(); i++ )
+    ASSERT( vs[i] == va[i] );
+  ASSERT( vb[0] != va[0] || vb[999] != va[999] ); // copies untouched
+  VArray::const_iterator ci = vs.begin_rw();
+  ASSERT( ci == vs.begin() );
+
+  // copy taken while writable iterator is held does not see its writes
+  VArray::iterator wi = vs.begin_rw();
+  VArray vc = vs;
+  *wi = "x";
+  wi[1] = "y";
+  ASSERT( vs[0] == "x" && vs[1] == "y" && vc[0] == va[0] && vc[1] == va[1] );
+  VArray vd = vs;
+  std::reverse( wi, vs.end_rw() );
+  ASSERT( vd[0] == "x" && vs[999] == "x" && vs[0] == va[999] );
+
+  VArray empty;
+  ASSERT( empty.begin() == empty.end() );
+
+  // trie iterator walks keys_and_values() order
+  VTrie tr;
+  for( i = 0; i < 300; i++ )
+    tr[ VString( i * 7 ) ] = VString( i );
+  tr[ "a" ] = "1";
+  tr[ "ab" ] = "2";
+  tr[ "abc" ] = "3";
+  VArray ks;
+  VArray vl;
+  tr.keys_and_values( &ks, &vl );
+  i = 0;
+  for( const VTrie::entry& e : tr )
+    {
+    ASSERT( ks[i] == e.key && vl[i] == e.value );
+    i++;
+    }
+  ASSERT( i == tr.count() && i == 303 );
+  VTrie::const_iterator it = tr.begin();
+  ++it;
+  VTrie::const_iterator it2 = it;
+  it++;
+  ASSERT( it2 != it && ks[1] == it2->key && ks[2] == it->key );
+  ASSERT( std::distance( tr.begin(), tr.end() ) == 303 );
+  VTrie te;
+  ASSERT( te.begin() == te.end() );
+}
+
+void test22()
+{
+  // str_join() sizes the result once, ranges and destinations
+  VArray va;
+  ASSERT( str_join( va, "," ) == "" );
+  va.push( "a" );
+  ASSERT( str_join( va, "," ) == "a" );
+  va.push( "" );
+  va.push( "ccc" );
+  va.push( "dd" );
+  ASSERT( str_join( va, ", " ) == "a, , ccc, dd" );
+  ASSERT( str_join( va ) == "acccdd" );
+
+  VString dest = "list: ";
+  VString keep = dest;
+  str_join( dest, va, "-", 2 );
+  ASSERT( dest == "list: ccc-dd" && keep == "list: " );
+  str_join( dest, va, "+", -3, 2 );
+  ASSERT( dest == "list: ccc-dd+ccc" );
+  str_join( dest, va, "+", 9 );
+  str_join( dest, va, NULL, 1, 0 );
+  ASSERT( dest == "list: ccc-dd+ccc" );
+
+  VArray vb;
+  for( int i = 0; i < 1000; i++ ) vb.push( "0123456789" );
+  VString big = str_join( vb, "," );
+  ASSERT( str_len( big ) == 10999 && big[10] == ',' && big[-1] == '9' );
+
+  VTrie tr;
+  tr[ "one" ] = "1";
+  tr[ "two" ] = "2";
+  tr[ "three" ] = "";
+  VArray ks = tr.keys();
+  VArray vl = tr.values();
+  ASSERT( str_join_keys( tr, "|" ) == str_join( ks, "|" ) );
+  ASSERT( str_join_values( tr, "|" ) == str_join( vl, "|" ) );
+  VTrie te;
+  ASSERT( str_join_keys( te, "|" ) == "" );
+
+  // appends grow the buffer and never shrink a reserved one
+  VString s;
+  s.reserve( 10000 );
+  for( int i = 0; i < 1000; i++ ) s.catn( "0123456789", 10 );
+  s.catn( "ab\0cd", 5 );
+  ASSERT( str_len( s ) == 10002 && s[-1] == 'b' );
+}
+
+void test23()
+{
+  // str_split(): literal and regexp delimiters, offsets, flat positions
+  VArray va = str_split( ",", ",a,,bb,c," );
+  ASSERT( va.count() == 5 && va[0] == "" && va[2] == "" && va[3] == "bb" && va[4] == "c" );
+  va = str_split( "::", "a::b:c::::d" );
+  ASSERT( va.count() == 4 && va[1] == "b:c" && va[2] == "" && va[3] == "d" );
+  va = str_split( "[,;] *", "a, b;c ,d", 3 );
+  ASSERT( va.count() == 3 && va[1] == "b" && va[2] == "c ,d" );
+  va = str_split( "^a", "aXaYa" ); // anchor sees the whole string
+  ASSERT( va.count() == 2 && va[0] == "" && va[1] == "XaYa" );
+  va = str_split( "(?<=b)", "abcbd" ); // lookbehind, empty matches
+  ASSERT( va.count() == 3 && va[0] == "ab" && va[1] == "cb" && va[2] == "d" );
+  va = str_split( "", "xyz" );
+  ASSERT( va.count() == 3 && va[2] == "z" );
+  va = str_split( " *", "a bc" );
+  ASSERT( va.count() == 3 && va[0] == "a" && va[1] == "b" && va[2] == "c" );
+  ASSERT( str_split( ",", "" ).count() == 0 );
+  va = str_split_simple( ".", "1.2.3" );
+  ASSERT( va.count() == 3 && va[2] == "3" );
+
+  VArray dest;
+  dest.push( "first" );
+  ASSERT( str_split( dest, "\t", "x\ty\tz" ) == 3 && dest.count() == 4 && dest[3] == "z" );
+  ASSERT( str_split( dest, "(", "x" ) == -1 );
+
+  int pos[6];
+  ASSERT( str_split_pos( pos, 3, " +", "aa  bbb c dd" ) == 4 );
+  ASSERT( pos[0] == 0 && pos[1] == 2 && pos[2] == 4 && pos[3] == 7 && pos[4] == 8 && pos[5] == 9 );
+
+  // long input with many fields, must be one forward pass
+  VString big;
+  for( int i = 0; i < 20000; i++ )
+    {
+    big += i;
+    big += ", ";
+    }
+  va = str_split( ", *", big );
+  ASSERT( va.count() == 20000 && va[19999] == "19999" );
+  va = str_split( ",", big );
+  ASSERT( va.count() == 20001 && va[1] == " 1" && va[20000] == " " );
+
+  VRegexp re( "[0-9]+" );
+  ASSERT( re.m( "ab12cd345", 9, 4 ) && re.sub_sp( 0 ) == 6 && re[0] == "345" );
+  ASSERT( ! re.m( "ab12cd345", 4, 4 ) && re.m( "ab12" ) && re[0] == "12" );
+  VRegexp fr( "cd", "f" );
+  ASSERT( fr.m( "cdab12cd345", 11, 1 ) && fr.sub_sp( 0 ) == 6 );
+}
+
+void test24()
+{
+  // lazy tokenizer: same fields as str_split(), early exit, reuse
+  VTokenizer tk( ", *" );
+  ASSERT( tk.ok() );
+  const char* line = "aa, bb,cc,  dd";
+  tk.reset( line );
+  VString s;
+  ASSERT( tk.next() && tk.len() == 2 && tk.sp() == 0 && tk.str( s ) == "aa" );
+  ASSERT( tk.next() && tk.str() == "bb" && tk.sp() == 4 && tk.ep() == 6 );
+  ASSERT( tk.count() == 2 ); // stop here, rest is never scanned
+
+  tk.reset( line, -1, 2 ); // reused, last field holds the rest
+  ASSERT( tk.next() && tk.next() && tk.str() == "bb,cc,  dd" && ! tk.next() );
+  tk.reset( line, 6 ); // only first `len' chars
+  ASSERT( tk.next() && tk.next() && tk.str() == "bb" && ! tk.next() && tk.count() == 2 );
+
+  tk.set_string( "::" );
+  tk.reset( "a::b:c::::d" );
+  VArray va;
+  while( tk.next() ) va.push( tk.ptr(), tk.len() );
+  ASSERT( va.count() == 4 && va[1] == "b:c" && va[2] == "" && va[3] == "d" );
+  tk.reset( "a::b::", 4 ); // delimiter must fit within `len'
+  ASSERT( tk.next() && tk.str() == "a" && tk.next() && tk.str() == "b" && ! tk.next() );
+
+  tk.set_charset( " \t;" );
+  tk.reset( "x y\tz;;w " );
+  va.undef();
+  while( tk.next() ) va.push( tk.str() );
+  ASSERT( va.count() == 5 && va[2] == "z" && va[3] == "" && va[4] == "w" );
+  tk.set_charset( "\xC3" ); // high chars are not negative
+  tk.reset( "a\xC3" "b" );
+  ASSERT( tk.next() && tk.str() == "a" && tk.next() && tk.str() == "b" );
+
+  // same results as str_split()
+  const char* delims[] = { ",", "", " *", "(?<=b)", "^a", "[,;] *", NULL };
+  const char* srcs[]   = { ",a,,bb,c,", "abcbd", "aXaYa", "a bc", "a, b;c ,d", "", NULL };
+  for( int d = 0; delims[d]; d++ )
+    for( int i = 0; srcs[i]; i++ )
+      for( int mc = -1; mc < 4; mc++ )
+        {
+        va = str_split( delims[d], srcs[i], mc );
+        tk.set_regexp( delims[d] );
+        tk.reset( srcs[i], -1, mc );
+        int n = 0;
+        while( tk.next() )
+          ASSERT( n < va.count() && tk.str() == va.get( n++ ) );
+        ASSERT( n == va.count() && tk.count() == n );
+        }
+
+  ASSERT( ! tk.set_regexp( "(" ) && ! tk.ok() );
+  tk.reset( "x" );
+  ASSERT( ! tk.next() );
+}
+
+void test25()
+{
+  // CSV: quotes, escaped quotes, embedded delimiters and newlines
+  VCSV csv;
+  csv.reset( "a,\"b,1\",c\r\n\"x \"\"y\"\"\",,\"multi\nline\"\n\nlast,\"open" );
+  ASSERT( csv.next() && csv.count() == 3 && strcmp( csv[1], "b,1" ) == 0 && strcmp( csv[2], "c" ) == 0 );
+  ASSERT( csv.next() && csv.count() == 3 && strcmp( csv[0], "x \"y\"" ) == 0 && csv.len( 1 ) == 0 );
+  ASSERT( strcmp( csv[2], "multi\nline" ) == 0 && csv.len( 2 ) == 10 && csv.get( 3 ) == NULL );
+  ASSERT( csv.next() && csv.count() == 0 ); // empty line
+  VArray va;
+  ASSERT( csv.next() && csv.row( va ) == 2 && va[1] == "open" ); // unterminated quote
+  ASSERT( ! csv.next() && ! csv.next() );
+
+  csv.reset( "a,b,\n\"q\"tail,x", 12 ); // only first `len' chars
+  ASSERT( csv.next() && csv.count() == 3 && csv.len( 2 ) == 0 );
+  ASSERT( csv.next() && csv.count() == 1 && strcmp( csv[0], "qtail" ) == 0 && ! csv.next() );
+
+  VCSV tsv( '\t', 0 ); // no quoting
+  tsv.reset( "\"a\"\tb c\n1\t2\t3\n" );
+  ASSERT( tsv.next() && tsv.count() == 2 && strcmp( tsv[0], "\"a\"" ) == 0 );
+  ASSERT( tsv.next() && tsv.count() == 3 && ! tsv.next() );
+
+  // trailing '\r' is dropped also from the last row without newline
+  csv.reset( "a,b\r" );
+  ASSERT( csv.next() && csv.count() == 2 && csv.len( 1 ) == 1 && strcmp( csv[1], "b" ) == 0 && ! csv.next() );
+  csv.reset( "a,\"b\"\r" );
+  ASSERT( csv.next() && csv.count() == 2 && csv.len( 1 ) == 1 && strcmp( csv[1], "b" ) == 0 && ! csv.next() );
+  csv.reset( "x\r" );
+  ASSERT( csv.next() && csv.count() == 1 && csv.len( 0 ) == 1 && ! csv.next() );
+  csv.reset( "x\n\r" );
+  ASSERT( csv.next() && csv.count() == 1 && csv.next() && csv.count() == 0 && ! csv.next() );
+  csv.reset( "\"q\r\",y\rz\r\n" ); // quoted and inner ones are kept
+  ASSERT( csv.next() && csv.count() == 2 && strcmp( csv[0], "q\r" ) == 0 && strcmp( csv[1], "y\rz" ) == 0 && ! csv.next() );
+
+  va.undef();
+  ASSERT( str_csv_split( va, "1,\"2\n3\",4\n5,6" ) == 3 && va[1] == "2\n3" );
+
+  // files: mapped and streamed in windows, long quoted field crosses them
+  const char* fn = "/tmp/vstring.test25";
+  FILE* f = fopen( fn, "wb" );
+  for( int i = 0; i < 20000; i++ )
+    fprintf( f, "%d,\"row \"\"%d\"\"\r\n,x\",%s\n", i, i, i == 9000 ? "" : "z" );
+  fputc( '"', f );
+  for( int i = 0; i < 3 * VCSV_READ_WINDOW; i++ ) fputc( i % 100 ? 'a' : '\n', f );
+  fputs( "\",end", f );
+  fclose( f );
+
+  for( int pass = 0; pass < 2; pass++ )
+    {
+    f = fopen( fn, "rb" );
+    ASSERT( pass == 0 ? csv.open( fn ) == 0 : csv.open( f ) == 0 );
+    int n = 0;
+    while( csv.next() )
+      {
+      if ( n < 20000 )
+        {
+        VString e = "row \"";
+        e += n;
+        e += "\"\r\n,x";
+        ASSERT( csv.count() == 3 && atoi( csv[0] ) == n && e == csv[1] && csv.len( 2 ) == ( n == 9000 ? 0 : 1 ) );
+        }
+      else
+        ASSERT( csv.count() == 2 && csv.len( 0 ) == 3 * VCSV_READ_WINDOW && strcmp( csv[1], "end" ) == 0 );
+      n++;
+      }
+    ASSERT( n == 20001 );
+    csv.close();
+    fclose( f );
+    }
+  ASSERT( csv.open( "/tmp/vstring.test25.missing" ) == 1 && ! csv.next() );
+  remove( fn );
+}
+
+void test26()
+{
+  // radix tree trie: shared prefixes, long keys, node growth and shrink
+  VTrie tr;
+  VString k;
+  for( int i = 0; i < 3000; i++ )
+    {
+    k = "key/";
+    k += i;
+    tr[k] = k;
+    }
+  k = "p";
+  str_mul( k, 100 );
+  tr[k] = "long";
+  str_add_ch( k, 'x' );
+  tr[k] = "longer";
+  tr["key"] = "short";
+  ASSERT( tr.count() == 3003 && tr.count( "key/" ) == 3000 && tr.count( "key/1" ) == 1111 );
+  ASSERT( tr.count( "pppp" ) == 2 && tr.count( "pq" ) == 0 && tr.count( "key/30" ) == 11 );
+  ASSERT( tr["key/2999"] == "key/2999" && tr[k] == "longer" && ! tr.exists( "key/3000" ) && ! tr.exists( "ke" ) );
+  str_sleft( k, 100 );
+  ASSERT( tr[k] == "long" );
+  str_sleft( k, 50 );
+  ASSERT( ! tr.exists( k ) );
+
+  // iteration is in keys order
+  VString prev;
+  int n = 0;
+  for( const VTrie::entry& e : tr )
+    {
+    ASSERT( n == 0 || strcmp( prev, e.key ) < 0 );
+    prev = e.key;
+    n++;
+    }
+  ASSERT( n == 3003 );
+
+  // copy-on-write clone
+  VTrie tc = tr;
+  tc.del( "key/1", 1 );
+  ASSERT( tc.count() == 3003 - 1111 && tr.count() == 3003 && tr["key/1"] == "key/1" && ! tc.exists( "key/1" ) );
+  tc["key/2"] = "two";
+  ASSERT( tr["key/2"] == "key/2" && tc["key/2"] == "two" );
+
+  // removing everything leaves an empty tree
+  for( int i = 0; i < 3000; i++ )
+    {
+    k = "key/";
+    k += i;
+    tr.del( k );
+    ASSERT( tr.count() == 3002 - i );
+    }
+  ASSERT( tr["key"] == "short" && tr.count( "key" ) == 1 );
+  tr.del( "p", 1 );
+  tr.del( "key" );
+  ASSERT( tr.count() == 0 && tr.begin() == tr.end() && tc.count() == 3003 - 1111 );
+}
+
+void test27()
+{
+  // hash: grow, delete and reuse slots, copy-on-write, iteration
+  VHash hs;
+  VString k;
+  ASSERT( hs.count() == 0 && hs.begin() == hs.end() && ! hs.exists( "a" ) && hs.get( "a" ) == NULL );
+  for( int i = 0; i < 20000; i++ )
+    {
+    k = "key.";
+    k += i;
+    hs[k] = i;
+    }
+  ASSERT( hs.count() == 20000 && hs["key.12345"] == "12345" && ! hs.exists( "key.20000" ) );
+  for( int i = 0; i < 20000; i += 2 )
+    {
+    k = "key.";
+    k += i;
+    hs.del( k );
+    }
+  hs.del( "missing" );
+  ASSERT( hs.count() == 10000 && ! hs.exists( "key.0" ) && hs["key.1"] == "1" );
+
+  // many add+del rounds must reuse deleted slots
+  for( int r = 0; r < 50; r++ )
+    for( int i = 0; i < 2000; i++ )
+      {
+      k = "tmp.";
+      k += i;
+      if ( r % 2 == 0 ) hs[k] = r; else hs.del( k );
+      }
+  ASSERT( hs.count() == 10000 && ! hs.exists( "tmp.5" ) );
+
+  int n = 0;
+  long sum = 0;
+  for( const VHash::entry& e : hs )
+    {
+    ASSERT( atoi( e.key + 4 ) % 2 == 1 && atoi( e.key + 4 ) == atoi( e.value ) );
+    sum += atoi( e.value );
+    n++;
+    }
+  ASSERT( n == 10000 && sum == 10000L * 10000 );
+
+  VHash hc = hs;
+  const VHash& hr = hc;
+  ASSERT( hr["nope"] == "" && hc.count() == 10000 );
+  hc["key.1"] = "one";
+  hc.del( "key.3" );
+  ASSERT( hs["key.1"] == "1" && hs.exists( "key.3" ) && hc["key.1"] == "one" && ! hc.exists( "key.3" ) );
+
+  // same file format as VTrie
+  const char* fn = "/tmp/vstring.test27";
+  ASSERT( hc.fsave( fn ) == 0 );
+  VTrie tr;
+  ASSERT( tr.fload( fn ) == 0 && tr.count() == 9999 && tr["key.1"] == "one" );
+  VHash hl;
+  ASSERT( hl.fload( fn ) == 0 && hl.count() == 9999 && hl["key.19999"] == "19999" );
+  remove( fn );
+
+  VArray va;
+  va.push( "a" );
+  va.push( "1" );
+  va.push( "b" );
+  va.push( "2" );
+  VHash ha = va;
+  ha.reverse();
+  ASSERT( ha.count() == 2 && ha["1"] == "a" && ha["2"] == "b" );
+  ha.merge( &hl );
+  ASSERT( ha.count() == 10001 && ha.keys().count() == 10001 && ha.values().count() == 10001 );
+  ha.undef();
+  ASSERT( ha.count() == 0 && hl.count() == 9999 );
 }
 
+void test28()
+{
+  // trie nodes in slabs: keys over the slab block limit, reuse of freed
+  // blocks, copies and undef of the whole tree
+  VTrie tr;
+  VString k;
+  k = "k";
+  str_mul( k, 10000 );
+  for( int i = 0; i < 10; i++ )
+    {
+    VString kk = k;
+    kk += i;
+    tr[kk] = i;
+    }
+  for( int r = 0; r < 20; r++ )
+    for( int i = 0; i < 1000; i++ )
+      {
+      VString kk = "short.";
+      kk += i;
+      if ( r % 2 == 0 ) tr[kk] = r; else tr.del( kk );
+      }
+  VTrie tc = tr;
+  tc[ "short.1" ] = "one";
+  k += 7;
+  ASSERT( tr.count() == 10 && tc.count() == 11 && tr[k] == "7" && tc[k] == "7" && ! tr.exists( "short.1" ) );
+  tr.undef();
+  ASSERT( tr.count() == 0 && tc.count() == 11 );
+  tc.del( k );
+  ASSERT( tc.count() == 10 && tc[ "short.1" ] == "one" );
+}
+
+void test29()
+{
+  // long common paths: splits past the stored part of node prefix, merges
+  // on del(), vacuum() repacks what is left, shared copies stay intact
+  VTrie tr;
+  VString k;
+  for( int i = 0; i < 2000; i++ )
+    {
+    k = "/usr/share/doc/package-";
+    k += i % 50;
+    k += "/examples/file-";
+    k += i;
+    tr[k] = i;
+    }
+  tr.print_stats();
+  ASSERT( tr.count() == 2000 && tr.count( "/usr/share/doc/package-7/" ) == 40 );
+  for( int i = 0; i < 2000; i++ )
+    if ( i % 10 )
+      {
+      k = "/usr/share/doc/package-";
+      k += i % 50;
+      k += "/examples/file-";
+      k += i;
+      tr.del( k );
+      }
+  int vc = tr.vacuum();
+  VTrie tc = tr;
+  tr.print_stats();
+  ASSERT( vc > 0 && tr.count() == 200 && tc.count() == 200 );
+  ASSERT( tr.count( "/usr/share/doc/package-7/" ) == 0 && tr.count( "/usr/share/doc/package-0/" ) == 40 );
+  ASSERT( tr[ "/usr/share/doc/package-40/examples/file-1990" ] == "1990" );
+  ASSERT( ! tr.exists( "/usr/share/doc/package-40/examples/file-199" ) );
+  tr.del( "/usr/share/doc/package-", 1 );
+  ASSERT( tr.count() == 0 && tc[ "/usr/share/doc/package-10/examples/file-10" ] == "10" );
+}
+
+int test30_collect( const char* key, const char*, void* arg )
+{
+  VArray* va = (VArray*)arg;
+  va->push( key );
+  return va->count() == 5; // stop after 5 keys
+}
+
+void test30()
+{
+  // prefix and range queries against full ordered key list
+  VTrie tr;
+  VArray all;
+  VString k;
+  for( int i = 0; i < 3000; i++ )
+    {
+    k = "/srv/www/htdocs/site-with-long-name-";
+    k += i % 30;
+    k += "/page-";
+    k += i;
+    tr[k] = i;
+    }
+  tr[ "/srv" ] = "root";
+  tr[ "/srv/www/htdocs/site-with-long-name-1" ] = "site1";
+  all = tr.keys();
+
+  VArray va = tr.keys_with_prefix( "/srv/www/htdocs/site-with-long-name-1" );
+  int n = 0;
+  for( int i = 0; i < all.count(); i++ )
+    n += str_find( all[i], "/srv/www/htdocs/site-with-long-name-1" ) == 0;
+  ASSERT( va.count() == n && n == 1101 && va[0] == "/srv/www/htdocs/site-with-long-name-1" );
+  ASSERT( tr.count( "/srv/www/htdocs/site-with-long-name-1", 10 ) == 10 );
+  ASSERT( tr.count( "/srv/www/htdocs/site-with-long-name-1" ) == 1101 );
+  ASSERT( tr.keys_with_prefix( "/srv/www/x" ).count() == 0 );
+
+  int len;
+  const char* ps;
+  ps = tr.longest_prefix( "/srv/www/htdocs/site-with-long-name-1/page-x", &len );
+  ASSERT( ps && strcmp( ps, "site1" ) == 0 && len == 37 );
+  ps = tr.longest_prefix( "/srv/www/htdocs/site-with-long-name-2/page-32" );
+  ASSERT( ps && strcmp( ps, "32" ) == 0 );
+  ps = tr.longest_prefix( "/srv/www/htdocs/site-with-long-name-2/page-3", &len );
+  ASSERT( ps && strcmp( ps, "root" ) == 0 && len == 4 );
+  ASSERT( tr.longest_prefix( "/srv" ) && ! tr.longest_prefix( "/sr", &len ) && len == 0 );
+
+  // ranges with bounds on and between keys
+  const char* from[] = { "/srv/www/htdocs/site-with-long-name-12/page-1002", "/srv/www/htdocs/site-with-long-name-12/", "/", "/srv/www/htdocs/site-with-long-name-3", "~" };
+  const char* to[]   = { "/srv/www/htdocs/site-with-long-name-13", "/srv/www/htdocs/site-with-long-name-12/page-5", "/srv/www", NULL, NULL };
+  for( int r = 0; r < 5; r++ )
+    {
+    VArray ra;
+    int cnt = tr.walk_range( from[r], to[r], test30_collect, &ra );
+    int i = 0;
+    while( i < all.count() && strcmp( all[i], from[r] ) < 0 ) i++;
+    for( int j = 0; j < ra.count(); j++, i++ )
+      ASSERT( i < all.count() && ra[j] == all[i] && ( ! to[r] || strcmp( all[i], to[r] ) < 0 ) );
+    ASSERT( cnt == ra.count() && ( cnt == 5 || i == all.count() || ( to[r] && strcmp( all[i], to[r] ) >= 0 ) ) );
+    i = 0;
+    while( i < all.count() && strcmp( all[i], from[r] ) < 0 ) i++;
+    for( VTrie::const_iterator it = tr.lower_bound( from[r] ); it != tr.end(); ++it, i++ )
+      ASSERT( i < all.count() && all[i] == it->key );
+    ASSERT( i == all.count() );
+    }
+  // random bounds over wide nodes
+  VTrie th;
+  srand( 30 );
+  for( int i = 0; i < 2000; i++ )
+    {
+    k = "";
+    for( int j = rand() % 4 + 1; j > 0; j-- )
+      str_add_ch( k, 33 + rand() % 90 );
+    th[k] = "1";
+    }
+  all = th.keys();
+  for( int r = 0; r < 500; r++ )
+    {
+    k = "";
+    for( int j = rand() % 5; j > 0; j-- )
+      str_add_ch( k, 33 + rand() % 90 );
+    int i = 0;
+    while( i < all.count() && strcmp( all[i], k ) < 0 ) i++;
+    VTrie::const_iterator it = th.lower_bound( k );
+    ASSERT( i == all.count() ? it == th.end() : all[i] == it->key );
+    }
+
+  n = 0;
+  for( VTrie::const_iterator it = tr.begin( "/srv/www/htdocs/site-with-long-name-29/" ); it != tr.end(); ++it )
+    n++;
+  va.undef();
+  ASSERT( n == 100 && tr.walk( "/srv/www/htdocs/site-with-long-name-29/", test30_collect, &va ) == 5 );
+}
+
+void test31()
+{
+  // copies share nodes, writes copy only their path
+  VTrie base;
+  VString k;
+  for( int i = 0; i < 5000; i++ )
+    {
+    k = "cfg.";
+    k += i % 7;
+    k += ".key";
+    k += i;
+    base[k] = i;
+    }
+  VTrie snap[8];
+  for( int s = 0; s < 8; s++ )
+    {
+    snap[s] = base;
+    k = "cfg.";
+    k += s * 100 % 7;
+    k += ".key";
+    k += s * 100;
+    snap[s][k] = "changed";     // existing key
+    snap[s][ "new.key" ] = s;   // new key
+    if ( s % 2 ) snap[s].del( "cfg.3.key10" );
+    if ( s == 7 ) snap[s].del( "cfg.1", 1 );
+    }
+  ASSERT( base.count() == 5000 && base[ "cfg.0.key0" ] == "0" && ! base.exists( "new.key" ) );
+  ASSERT( base[ "cfg.3.key10" ] == "10" && base.count( "cfg.1" ) == 715 );
+  for( int s = 0; s < 8; s++ )
+    {
+    k = "cfg.";
+    k += s * 100 % 7;
+    k += ".key";
+    k += s * 100;
+    ASSERT( snap[s][k] == "changed" && base[k] != "changed" && snap[s][ "new.key" ] == s );
+    ASSERT( snap[s].exists( "cfg.3.key10" ) == ! ( s % 2 ) );
+    ASSERT( snap[s].count() == 5001 - s % 2 - ( s == 7 ? 715 : 0 ) );
+    }
+  ASSERT( snap[1][ "cfg.0.key0" ] == "0" && snap[0][ "cfg.0.key0" ] == "changed" );
+
+  // walk one copy while others change and go away
+  int n = 0;
+  for( VTrie::const_iterator it = snap[2].begin(); it != snap[2].end(); ++it, n++ )
+    if ( n == 100 )
+      {
+      base.del( "cfg.", 1 );
+      snap[3].undef();
+      snap[4].vacuum();
+      }
+  ASSERT( n == 5001 && base.count() == 0 && snap[4].count() == 5001 && snap[4][ "cfg.1.key400" ] == "changed" );
+  for( int s = 0; s < 8; s++ )
+    snap[s].undef();
+  ASSERT( snap[2].count() == 0 );
+}
+
+void test32()
+{
+  // compiled trie image served from the mapping
+  const char* fn = "/tmp/vstring.test32";
+  VTrie tr;
+  VString k;
+  for( int i = 0; i < 3000; i++ )
+    {
+    k = i % 3 ? "/very/long/common/path/prefix/to/make/nodes/" : "dict.";
+    k += i;
+    tr[k] = i;
+    }
+  tr[ "dict.1" ] = "";                    // empty value
+  tr[ "dict.12" ] = "multi\nline";
+  tr[ "d" ] = "short";                    // prefix of other keys
+  ASSERT( tr.bsave( fn ) == 0 );
+
+  VTrieMap tm;
+  ASSERT( tm.open( fn ) == 0 && tm.count() == tr.count() );
+  VArray ka = tr.keys();
+  VArray va = tr.values();
+  for( int i = 0; i < ka.count(); i++ )
+    ASSERT( tm.get( ka[i] ) && va[i] == tm[ ka[i] ] );
+  ASSERT( tm.exists( "d" ) && ! tm.exists( "di" ) && ! tm.exists( "dict.30000" ) && ! tm.exists( "" ) );
+  ASSERT( ! tm.get( "/very/long/common/path/prefix/to/make/nodes/" ) && strcmp( tm[ "dict.1" ], "" ) == 0 );
+  ASSERT( strcmp( tm[ "dict.12" ], "multi\nline" ) == 0 && ! tm.get( "dict.12x" ) && ! tm.get( "dict." ) );
+  const char* px[] = { "d", "dict.1", "dict.12", "/very/long/common/", "/very/long/common/path/prefix/to/make/nodes/29", "x", "dict.1299" };
+  for( int i = 0; i < 7; i++ )
+    {
+    VArray a = tr.keys_with_prefix( px[i] );
+    VArray b = tm.keys_with_prefix( px[i] );
+    ASSERT( tm.count( px[i] ) == tr.count( px[i] ) && a.count() == b.count() );
+    for( int j = 0; j < a.count(); j++ )
+      ASSERT( a[j] == b[j] );
+    }
+  ASSERT( tm.keys_with_prefix( NULL ).count() == ka.count() && tm.keys_with_prefix( "" )[0] == ka[0] );
+
+  VTrie tb;
+  ASSERT( tb.bload( fn ) == 0 && tb.count() == tr.count() && tb[ "dict.2997" ] == "2997" );
+  tm.close();
+  ASSERT( tm.count() == 0 && ! tm.get( "d" ) );
+
+  // single key and empty tries
+  tb.undef();
+  tb[ "one" ] = "1";
+  ASSERT( tb.bsave( fn ) == 0 && tm.open( fn ) == 0 && tm.count() == 1 && strcmp( tm[ "one" ], "1" ) == 0 );
+  ASSERT( ! tm.exists( "on" ) && ! tm.exists( "onex" ) && tm.count( "o" ) == 1 && tm.count( "x" ) == 0 );
+  tb.undef();
+  ASSERT( tb.bsave( fn ) == 0 && tm.open( fn ) == 0 && tm.count() == 0 && ! tm.exists( "one" ) );
+
+  // text and damaged files
+  tr.fsave( fn );
+  ASSERT( tm.open( fn ) == 3 && tb.bload( fn ) == 3 );
+  tr.bsave( fn );
+  FILE* f = fopen( fn, "r+b" );
+  fseek( f, -3000, SEEK_END ); // nodes are at the end
+  for( int i = 0; i < 300; i++ )
+    fputc( i * 37, f );
+  fclose( f );
+  ASSERT( tm.open( fn ) == 0 );
+  int n = 0;
+  for( int i = 0; i < ka.count(); i++ )
+    n += tm.get( ka[i] ) != NULL;
+  ASSERT( n < ka.count() && tm.keys_with_prefix( "" ).count() < ka.count() );
+  ASSERT( truncate( fn, 50000 ) == 0 && tm.open( fn ) == 3 );
+  ASSERT( tm.open( "/tmp/vstring.test32.missing" ) == 1 );
+  remove( fn );
+}
+
+void test33()
+{
+  // double-array trie built from trie and from key+value pairs
+  VTrie tr;
+  VString k;
+  srand( 33 );
+  for( int i = 0; i < 5000; i++ )
+    {
+    k = i % 4 ? "/usr/share/doc/" : "\xD0\xBF\xD1\x80\xD0\xBE\xD0\xB1\xD0\xB0.";
+    k += rand() % 1000;
+    k += "/";
+    k += i;
+    tr[k] = i;
+    }
+  tr[ "/" ] = "root";                     // prefix of other keys
+  tr[ "/usr/share/doc/1/1" ] = "";        // empty value
+  tr[ "\xFF\x01" ] = "high bytes";
+
+  VDATrie da;
+  ASSERT( ! da.get( "/" ) && da.count() == 0 );
+  ASSERT( da.build( tr ) == 0 && da.count() == tr.count() );
+  VArray ka = tr.keys();
+  VArray va = tr.values();
+  for( int i = 0; i < ka.count(); i++ )
+    ASSERT( da.get( ka[i] ) && va[i] == da[ ka[i] ] );
+  ASSERT( strcmp( da[ "/" ], "root" ) == 0 && strcmp( da[ "\xFF\x01" ], "high bytes" ) == 0 );
+  ASSERT( da.exists( "/usr/share/doc/1/1" ) && strcmp( da[ "/usr/share/doc/1/1" ], "" ) == 0 );
+  ASSERT( ! da.exists( "" ) && ! da.exists( "/usr" ) && ! da.exists( "/usr/share/doc/" ) && ! da.exists( "\xFF" ) );
+  for( int i = 0; i < ka.count(); i += 7 )
+    {
+    k = ka[i];
+    k += "x";
+    ASSERT( ! da.exists( k ) );
+    str_trim_right( k, 2 );
+    ASSERT( da.exists( k ) == tr.exists( k ) );
+    }
+
+  VArray pa;
+  pa.push( "one" );
+  pa.push( "1" );
+  pa.push( "two" );
+  pa.push( "2" );
+  pa.push( "one" );
+  pa.push( "3" ); // repeated keys keep the last value, as VTrie
+  ASSERT( da.build( pa ) == 0 && da.count() == 2 );
+  ASSERT( strcmp( da[ "one" ], "3" ) == 0 && strcmp( da[ "two" ], "2" ) == 0 && ! da.exists( "/" ) );
+  da.undef();
+  ASSERT( da.count() == 0 && ! da.exists( "one" ) );
+}
 
 void test0()
 {
@@ -562,6 +2015,30 @@ int main( void )
   test7();
   test8();
   test9();
+  test10();
+  test11();
+  test12();
+  test13();
+  test14();
+  test15();
+  test16();
+  test17();
+  test18();
+  test19();
+  test20();
+  test21();
+  test22();
+  test23();
+  test24();
+  test25();
+  test26();
+  test27();
+  test28();
+  test29();
+  test30();
+  test31();
+  test32();
+  test33();
   //*/
   return 0;
 }
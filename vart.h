@@ -0,0 +1,1141 @@
+/****************************************************************************
+ #
+ #  VSTRING Library
+ #
+ #  Copyright (c) 1996-2023 Vladi Belperchinov-Shabanski "Cade"
+ #  http://cade.noxrun.com/  <cade@noxrun.com> <cade@bis.bg> <cade@cpan.org>
+ #
+ #  Distributed under the GPL license, you should receive copy of GPLv2!
+ #
+ #  SEE 'README', 'LICENSE' OR 'COPYING' FILE FOR LICENSE AND OTHER DETAILS!
+ #
+ #  VSTRING library provides wide set of string manipulation features
+ #  including dynamic string object that can be freely exchanged with
+ #  standard char* (or wchar_t*) type, so there is no need to change
+ #  function calls nor the implementation when you change from
+ #  char* to VString (and from wchar_t* to WString).
+ #
+ ***************************************************************************/
+
+/****************************************************************************
+**
+** adaptive radix tree -- INTERNAL!
+**
+** byte keys, inner nodes grow 4 -> 16 -> 48 -> 256 children as needed and
+** shrink back on removal. chains without branches are compressed to node
+** prefix (only first VS_ART_MAX_PREFIX bytes are kept, the rest is checked
+** against leaf keys). leaves are tagged pointers (low bit set) to LEAF
+** objects derived from vs_art_leaf.
+**
+** keys must not be prefix of other keys, i.e. 0-terminated strings with
+** the terminator included. walks are in byte order of the keys.
+**
+** nodes of a tree are cut from its slabs, which are released at once by
+** clear(), so there are neither per node malloc() headers nor deep
+** recursion on destroy. leaves may use the same slabs (vs_art_alloc()).
+**
+** trees may share nodes and leaves (share()), which are refcounted then.
+** changes copy only the nodes on the path to the key (path copying), the
+** rest stays shared. trees sharing nodes share the slabs as well.
+**
+****************************************************************************/
+
+#ifndef _VART_H_
+#define _VART_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
+#define VS_ART_NODE4         1
+#define VS_ART_NODE16        2
+#define VS_ART_NODE48        3
+#define VS_ART_NODE256       4
+
+#define VS_ART_MAX_PREFIX   17            // fills node4 header up to its slab block
+
+#define VS_ART_ALIGN        16            // slab blocks size step and alignment
+#define VS_ART_BIG          ( 4*1024 )    // bigger blocks are plain malloc()-ed
+#define VS_ART_SLAB_MIN     ( 4*1024 )    // first slab, next ones double up to max
+#define VS_ART_SLAB_MAX     ( 256*1024 )
+
+struct vs_art_slab
+{
+  int     refs;   // trees using the slabs
+  void*   slabs;  // slabs list, each one starts with pointer to the next one
+  char*   top;    // free space in the current slab
+  size_t  left;
+  size_t  next;   // next slab size
+  void**  free;   // free blocks lists per size, allocated with the first slab
+  size_t  used;   // bytes in live blocks
+  size_t  total;  // bytes in slabs and big blocks
+};
+
+inline size_t vs_art_block_size( size_t size )
+{
+  return ( size + VS_ART_ALIGN - 1 ) & ~(size_t)( VS_ART_ALIGN - 1 );
+}
+
+inline void* vs_art_alloc( vs_art_slab* s, size_t size )
+{
+  size = vs_art_block_size( size );
+  if ( size > VS_ART_BIG )
+    {
+    void* p = malloc( size );
+    if ( p ) { s->used += size; s->total += size; }
+    return p;
+    }
+  void** fl = s->free ? s->free + size / VS_ART_ALIGN : NULL;
+  if ( fl && *fl )
+    {
+    void* p = *fl;
+    *fl = *(void**)p;
+    s->used += size;
+    return p;
+    }
+  if ( s->left < size )
+    {
+    if ( ! s->free && ! ( s->free = (void**)calloc( VS_ART_BIG / VS_ART_ALIGN + 1, sizeof( void* ) ) ) )
+      return NULL;
+    size_t ss = s->next ? s->next : VS_ART_SLAB_MIN;
+    char* slab = (char*)malloc( ss );
+    if ( ! slab ) return NULL;
+    if ( s->left )
+      { // the rest of the current slab is kept as free block
+      void** tl = s->free + s->left / VS_ART_ALIGN;
+      *(void**)s->top = *tl;
+      *tl = s->top;
+      }
+    *(void**)slab = s->slabs;
+    s->slabs  = slab;
+    s->top    = slab + VS_ART_ALIGN;
+    s->left   = ss - VS_ART_ALIGN;
+    s->next   = ss < VS_ART_SLAB_MAX ? ss * 2 : ss;
+    s->total += ss;
+    }
+  void* p = s->top;
+  s->top  += size;
+  s->left -= size;
+  s->used += size;
+  return p;
+}
+
+/* `size' must be the same as on vs_art_alloc() */
+inline void vs_art_free( vs_art_slab* s, void* p, size_t size )
+{
+  size = vs_art_block_size( size );
+  s->used -= size;
+  if ( size > VS_ART_BIG )
+    {
+    s->total -= size;
+    free( p );
+    return;
+    }
+  void** fl = s->free + size / VS_ART_ALIGN;
+  *(void**)p = *fl;
+  *fl = p;
+}
+
+/* drop all slabs, big blocks must be freed before */
+inline void vs_art_slab_release( vs_art_slab* s )
+{
+  while( s->slabs )
+    {
+    void* next = *(void**)s->slabs;
+    free( s->slabs );
+    s->slabs = next;
+    }
+  free( s->free );
+  int refs = s->refs;
+  memset( s, 0, sizeof( *s ) );
+  s->refs = refs;
+}
+
+inline vs_art_slab* vs_art_slab_new()
+{
+  vs_art_slab* s = (vs_art_slab*)calloc( 1, sizeof( vs_art_slab ) );
+  if ( s ) s->refs = 1;
+  return s;
+}
+
+inline void vs_art_slab_unref( vs_art_slab* s )
+{
+  if ( --s->refs > 0 ) return;
+  vs_art_slab_release( s );
+  free( s );
+}
+
+struct vs_art_leaf
+{
+  unsigned int         refs; // trees (or parent nodes) holding the leaf
+  unsigned int         kl;   // key length
+  const unsigned char* kb;   // key bytes
+};
+
+struct vs_art_node
+{
+  unsigned int   refs;    // parent nodes (or trees) holding the node
+  unsigned int   pl;      // compressed path length
+  unsigned short n;       // children count
+  unsigned char  type;
+  unsigned char  prefix[VS_ART_MAX_PREFIX];
+};
+
+struct vs_art_node4
+{
+  vs_art_node    h;
+  unsigned char  keys[4];  // sorted
+  void*          child[4];
+};
+
+struct vs_art_node16
+{
+  vs_art_node    h;
+  unsigned char  keys[16]; // sorted
+  void*          child[16];
+};
+
+struct vs_art_node48
+{
+  vs_art_node    h;
+  unsigned char  index[256]; // child position + 1, 0 for none
+  void*          child[48];
+};
+
+struct vs_art_node256
+{
+  vs_art_node    h;
+  void*          child[256];
+};
+
+inline int   vs_art_is_leaf( const void* p ) { return ( (uintptr_t)p & 1 ) != 0; }
+inline void* vs_art_tag( const void* leaf )  { return (void*)( (uintptr_t)leaf | 1 ); }
+inline void* vs_art_untag( const void* p )   { return (void*)( (uintptr_t)p & ~(uintptr_t)1 ); }
+
+inline size_t vs_art_node_size( int type )
+{
+  switch( type )
+    {
+    case VS_ART_NODE4  : return sizeof( vs_art_node4 );
+    case VS_ART_NODE16 : return sizeof( vs_art_node16 );
+    case VS_ART_NODE48 : return sizeof( vs_art_node48 );
+    default            : return sizeof( vs_art_node256 );
+    }
+}
+
+inline vs_art_node* vs_art_new_node( vs_art_slab* s, int type )
+{
+  size_t size = vs_art_node_size( type );
+  vs_art_node* n = (vs_art_node*)vs_art_alloc( s, size );
+  if ( ! n ) return NULL;
+  memset( n, 0, size );
+  n->type = type;
+  n->refs = 1;
+  return n;
+}
+
+inline void vs_art_free_node( vs_art_slab* s, vs_art_node* n )
+{
+  vs_art_free( s, n, vs_art_node_size( n->type ) );
+}
+
+inline void vs_art_ref( void* p )
+{
+  if ( vs_art_is_leaf( p ) )
+    ((vs_art_leaf*)vs_art_untag( p ))->refs++;
+  else
+    ((vs_art_node*)p)->refs++;
+}
+
+/* copy header of `from' to `to' of another type */
+inline void vs_art_copy_header( vs_art_node* to, const vs_art_node* from )
+{
+  to->n  = from->n;
+  to->pl = from->pl;
+  memcpy( to->prefix, from->prefix, from->pl < VS_ART_MAX_PREFIX ? from->pl : VS_ART_MAX_PREFIX );
+}
+
+/* return child slot for byte `c', NULL if none */
+inline void** vs_art_find_child( vs_art_node* n, unsigned char c )
+{
+  switch( n->type )
+    {
+    case VS_ART_NODE4:
+      {
+      vs_art_node4* p = (vs_art_node4*)n;
+      for( int i = 0; i < n->n; i++ )
+        if ( p->keys[i] == c ) return &p->child[i];
+      return NULL;
+      }
+    case VS_ART_NODE16:
+      {
+      vs_art_node16* p = (vs_art_node16*)n;
+      #if defined( __SSE2__ )
+      // all 16 keys are compared at once
+      __m128i cmp = _mm_cmpeq_epi8( _mm_set1_epi8( (char)c ), _mm_loadu_si128( (const __m128i*)p->keys ) );
+      int mask = _mm_movemask_epi8( cmp ) & ( ( 1 << n->n ) - 1 );
+      return mask ? &p->child[ __builtin_ctz( mask ) ] : NULL;
+      #else
+      for( int i = 0; i < n->n; i++ )
+        if ( p->keys[i] == c ) return &p->child[i];
+      return NULL;
+      #endif
+      }
+    case VS_ART_NODE48:
+      {
+      vs_art_node48* p = (vs_art_node48*)n;
+      return p->index[c] ? &p->child[ p->index[c] - 1 ] : NULL;
+      }
+    default:
+      {
+      vs_art_node256* p = (vs_art_node256*)n;
+      return p->child[c] ? &p->child[c] : NULL;
+      }
+    }
+}
+
+/* return first child at position `*i' or after it (positions are indexes
+   for 4/16 nodes and bytes for 48/256 ones), NULL if there are no more */
+inline void* vs_art_child_at( const vs_art_node* n, int* i )
+{
+  switch( n->type )
+    {
+    case VS_ART_NODE4  : return *i < n->n ? ((vs_art_node4*)n)->child[*i] : NULL;
+    case VS_ART_NODE16 : return *i < n->n ? ((vs_art_node16*)n)->child[*i] : NULL;
+    case VS_ART_NODE48 :
+      {
+      const vs_art_node48* p = (const vs_art_node48*)n;
+      for( ; *i < 256; (*i)++ )
+        if ( p->index[*i] ) return p->child[ p->index[*i] - 1 ];
+      return NULL;
+      }
+    default:
+      {
+      const vs_art_node256* p = (const vs_art_node256*)n;
+      for( ; *i < 256; (*i)++ )
+        if ( p->child[*i] ) return p->child[*i];
+      return NULL;
+      }
+    }
+}
+
+/* byte of the child at position `i' (see vs_art_child_at()) */
+inline unsigned char vs_art_key_at( const vs_art_node* n, int i )
+{
+  switch( n->type )
+    {
+    case VS_ART_NODE4  : return ((const vs_art_node4*)n)->keys[i];
+    case VS_ART_NODE16 : return ((const vs_art_node16*)n)->keys[i];
+    default            : return i;
+    }
+}
+
+/* first child for byte `c' or the next bigger one, `*i' gets its position
+   and `*k' its byte, NULL if there is none */
+inline void* vs_art_child_from( const vs_art_node* n, unsigned char c, int* i, int* k )
+{
+  if ( n->type == VS_ART_NODE4 || n->type == VS_ART_NODE16 )
+    {
+    const unsigned char* keys = n->type == VS_ART_NODE4 ? ((const vs_art_node4*)n)->keys : ((const vs_art_node16*)n)->keys;
+    for( *i = 0; *i < n->n; (*i)++ )
+      if ( keys[*i] >= c )
+        {
+        *k = keys[*i];
+        return vs_art_child_at( n, i );
+        }
+    return NULL;
+    }
+  *i = c;
+  void* ch = vs_art_child_at( n, i );
+  *k = *i;
+  return ch;
+}
+
+/* all child slots, 48/256 nodes may have empty ones */
+inline void** vs_art_slots( vs_art_node* n, int* cnt )
+{
+  switch( n->type )
+    {
+    case VS_ART_NODE4  : *cnt = n->n; return ((vs_art_node4*)n)->child;
+    case VS_ART_NODE16 : *cnt = n->n; return ((vs_art_node16*)n)->child;
+    case VS_ART_NODE48 : *cnt = 48;   return ((vs_art_node48*)n)->child;
+    default            : *cnt = 256;  return ((vs_art_node256*)n)->child;
+    }
+}
+
+/* make node at `*ref' private before change, shared one is replaced by its
+   copy (children get one more owner), returns NULL if out of memory */
+inline vs_art_node* vs_art_own( vs_art_slab* s, void** ref )
+{
+  vs_art_node* n = (vs_art_node*)*ref;
+  if ( n->refs == 1 ) return n;
+  size_t size = vs_art_node_size( n->type );
+  vs_art_node* nn = (vs_art_node*)vs_art_alloc( s, size );
+  if ( ! nn ) return NULL;
+  memcpy( nn, n, size );
+  nn->refs = 1;
+  int cnt;
+  void** slots = vs_art_slots( nn, &cnt );
+  for( int i = 0; i < cnt; i++ )
+    if ( slots[i] ) vs_art_ref( slots[i] );
+  n->refs--;
+  *ref = nn;
+  return nn;
+}
+
+/* add `child' for byte `c', node may be replaced by bigger one at `*ref',
+   returns 0 if out of memory */
+inline int vs_art_add_child( vs_art_slab* s, vs_art_node* n, void** ref, unsigned char c, void* child )
+{
+  switch( n->type )
+    {
+    case VS_ART_NODE4:
+      {
+      vs_art_node4* p = (vs_art_node4*)n;
+      if ( n->n < 4 )
+        {
+        int i = 0;
+        while( i < n->n && p->keys[i] < c ) i++;
+        memmove( p->keys  + i + 1, p->keys  + i, n->n - i );
+        memmove( p->child + i + 1, p->child + i, ( n->n - i ) * sizeof( void* ) );
+        p->keys[i]  = c;
+        p->child[i] = child;
+        n->n++;
+        return 1;
+        }
+      vs_art_node16* nn = (vs_art_node16*)vs_art_new_node( s, VS_ART_NODE16 );
+      if ( ! nn ) return 0;
+      vs_art_copy_header( &nn->h, n );
+      memcpy( nn->keys,  p->keys,  4 );
+      memcpy( nn->child, p->child, 4 * sizeof( void* ) );
+      *ref = nn;
+      vs_art_free_node( s, n );
+      return vs_art_add_child( s, &nn->h, ref, c, child );
+      }
+    case VS_ART_NODE16:
+      {
+      vs_art_node16* p = (vs_art_node16*)n;
+      if ( n->n < 16 )
+        {
+        int i = 0;
+        while( i < n->n && p->keys[i] < c ) i++;
+        memmove( p->keys  + i + 1, p->keys  + i, n->n - i );
+        memmove( p->child + i + 1, p->child + i, ( n->n - i ) * sizeof( void* ) );
+        p->keys[i]  = c;
+        p->child[i] = child;
+        n->n++;
+        return 1;
+        }
+      vs_art_node48* nn = (vs_art_node48*)vs_art_new_node( s, VS_ART_NODE48 );
+      if ( ! nn ) return 0;
+      vs_art_copy_header( &nn->h, n );
+      for( int i = 0; i < 16; i++ )
+        {
+        nn->index[ p->keys[i] ] = i + 1;
+        nn->child[i] = p->child[i];
+        }
+      *ref = nn;
+      vs_art_free_node( s, n );
+      return vs_art_add_child( s, &nn->h, ref, c, child );
+      }
+    case VS_ART_NODE48:
+      {
+      vs_art_node48* p = (vs_art_node48*)n;
+      if ( n->n < 48 )
+        {
+        int i = 0;
+        while( p->child[i] ) i++;
+        p->child[i] = child;
+        p->index[c] = i + 1;
+        n->n++;
+        return 1;
+        }
+      vs_art_node256* nn = (vs_art_node256*)vs_art_new_node( s, VS_ART_NODE256 );
+      if ( ! nn ) return 0;
+      vs_art_copy_header( &nn->h, n );
+      for( int i = 0; i < 256; i++ )
+        if ( p->index[i] ) nn->child[i] = p->child[ p->index[i] - 1 ];
+      *ref = nn;
+      vs_art_free_node( s, n );
+      return vs_art_add_child( s, &nn->h, ref, c, child );
+      }
+    default:
+      {
+      vs_art_node256* p = (vs_art_node256*)n;
+      p->child[c] = child;
+      n->n++;
+      return 1;
+      }
+    }
+}
+
+/* remove child at `slot' (for byte `c'), node may be replaced by smaller
+   one at `*ref'. node 4 with single child left is merged into the child */
+inline void vs_art_remove_child( vs_art_slab* s, vs_art_node* n, void** ref, unsigned char c, void** slot )
+{
+  switch( n->type )
+    {
+    case VS_ART_NODE4:
+      {
+      vs_art_node4* p = (vs_art_node4*)n;
+      int i = slot - p->child;
+      memmove( p->keys  + i, p->keys  + i + 1, n->n - i - 1 );
+      memmove( p->child + i, p->child + i + 1, ( n->n - i - 1 ) * sizeof( void* ) );
+      n->n--;
+      if ( n->n > 1 ) return;
+      if ( ! vs_art_is_leaf( p->child[0] ) )
+        { // child takes node prefix + key byte + its own prefix
+        vs_art_node* cn = vs_art_own( s, &p->child[0] );
+        if ( ! cn ) return; // keep single child node
+        unsigned int pl = n->pl;
+        if ( pl < VS_ART_MAX_PREFIX ) n->prefix[pl++] = p->keys[0];
+        if ( pl < VS_ART_MAX_PREFIX )
+          {
+          unsigned int sub = cn->pl < VS_ART_MAX_PREFIX - pl ? cn->pl : VS_ART_MAX_PREFIX - pl;
+          memcpy( n->prefix + pl, cn->prefix, sub );
+          pl += sub;
+          }
+        memcpy( cn->prefix, n->prefix, pl < VS_ART_MAX_PREFIX ? pl : VS_ART_MAX_PREFIX );
+        cn->pl += n->pl + 1;
+        }
+      *ref = p->child[0];
+      vs_art_free_node( s, n );
+      return;
+      }
+    case VS_ART_NODE16:
+      {
+      vs_art_node16* p = (vs_art_node16*)n;
+      int i = slot - p->child;
+      memmove( p->keys  + i, p->keys  + i + 1, n->n - i - 1 );
+      memmove( p->child + i, p->child + i + 1, ( n->n - i - 1 ) * sizeof( void* ) );
+      n->n--;
+      if ( n->n > 3 ) return;
+      vs_art_node4* nn = (vs_art_node4*)vs_art_new_node( s, VS_ART_NODE4 );
+      if ( ! nn ) return; // keep the bigger one
+      vs_art_copy_header( &nn->h, n );
+      memcpy( nn->keys,  p->keys,  3 );
+      memcpy( nn->child, p->child, 3 * sizeof( void* ) );
+      *ref = nn;
+      vs_art_free_node( s, n );
+      return;
+      }
+    case VS_ART_NODE48:
+      {
+      vs_art_node48* p = (vs_art_node48*)n;
+      p->child[ p->index[c] - 1 ] = NULL;
+      p->index[c] = 0;
+      n->n--;
+      if ( n->n > 12 ) return;
+      vs_art_node16* nn = (vs_art_node16*)vs_art_new_node( s, VS_ART_NODE16 );
+      if ( ! nn ) return;
+      vs_art_copy_header( &nn->h, n );
+      int k = 0;
+      for( int i = 0; i < 256; i++ )
+        if ( p->index[i] )
+          {
+          nn->keys[k]  = i;
+          nn->child[k] = p->child[ p->index[i] - 1 ];
+          k++;
+          }
+      *ref = nn;
+      vs_art_free_node( s, n );
+      return;
+      }
+    default:
+      {
+      vs_art_node256* p = (vs_art_node256*)n;
+      p->child[c] = NULL;
+      n->n--;
+      if ( n->n > 37 ) return;
+      vs_art_node48* nn = (vs_art_node48*)vs_art_new_node( s, VS_ART_NODE48 );
+      if ( ! nn ) return;
+      vs_art_copy_header( &nn->h, n );
+      int k = 0;
+      for( int i = 0; i < 256; i++ )
+        if ( p->child[i] )
+          {
+          nn->child[k] = p->child[i];
+          nn->index[i] = ++k;
+          }
+      *ref = nn;
+      vs_art_free_node( s, n );
+      return;
+      }
+    }
+}
+
+/* in-order (byte order of the keys) walk over leaves of a subtree */
+template< class LEAF >
+class vs_art_iter
+{
+  struct pos
+    {
+    const vs_art_node* node;
+    int                i;
+    };
+
+  pos* stack;
+  int  depth;
+  int  size;
+
+  int push( const vs_art_node* n, int i )
+  {
+    if ( depth >= size )
+      {
+      int new_size = size * 2 + 16;
+      pos* new_stack = (pos*)realloc( stack, new_size * sizeof( pos ) );
+      if ( ! new_stack ) return 0;
+      stack = new_stack;
+      size  = new_size;
+      }
+    stack[depth].node = n;
+    stack[depth].i    = i;
+    depth++;
+    return 1;
+  }
+
+  LEAF* descend( const void* n )
+  {
+    fresh = depth;
+    while( ! vs_art_is_leaf( n ) )
+      {
+      int i = 0;
+      const void* c = vs_art_child_at( (const vs_art_node*)n, &i );
+      if ( ! push( (const vs_art_node*)n, i ) ) return NULL; // end
+      n = c;
+      }
+    return (LEAF*)vs_art_untag( n );
+  }
+
+  public:
+
+  LEAF* leaf;  // current leaf, NULL at the end
+  int   fresh; // nodes from this level down were entered by the last step
+
+  vs_art_iter()  { stack = NULL; depth = size = fresh = 0; leaf = NULL; };
+
+  int level() const { return depth; } // inner nodes above current leaf
+  const vs_art_node* node( int i ) const { return stack[i].node; }
+  ~vs_art_iter() { free( stack ); };
+
+  void start( const void* root )
+  {
+    depth = 0;
+    leaf  = root ? descend( root ) : NULL;
+  }
+
+  /* start at the first leaf with key not less than `key' */
+  void lower_bound( const void* root, const unsigned char* key, int kl )
+  {
+    depth = 0;
+    leaf  = NULL;
+    const void* n = root;
+    int d = 0; // key bytes matched
+    while( n )
+      {
+      if ( vs_art_is_leaf( n ) )
+        {
+        LEAF* l = (LEAF*)vs_art_untag( n );
+        int r = memcmp( l->kb, key, (int)l->kl < kl ? l->kl : kl );
+        if ( r > 0 || ( r == 0 && (int)l->kl >= kl ) )
+          leaf = l;
+        else
+          next();
+        return;
+        }
+      const vs_art_node* p = (const vs_art_node*)n;
+      if ( p->pl )
+        { // full prefix, bytes above the stored part are taken from any leaf
+        const unsigned char* pb = p->prefix;
+        if ( p->pl > VS_ART_MAX_PREFIX )
+          {
+          const void* m = n;
+          while( ! vs_art_is_leaf( m ) )
+            {
+            int i = 0;
+            m = vs_art_child_at( (const vs_art_node*)m, &i );
+            }
+          pb = ((LEAF*)vs_art_untag( m ))->kb + d;
+          }
+        for( int i = 0; i < (int)p->pl; i++ )
+          {
+          if ( d + i >= kl || pb[i] > key[d + i] )
+            { // all keys below are bigger
+            leaf = descend( n );
+            return;
+            }
+          if ( pb[i] < key[d + i] )
+            { // all keys below are smaller
+            next();
+            return;
+            }
+          }
+        d += p->pl;
+        }
+      if ( d >= kl )
+        {
+        leaf = descend( n );
+        return;
+        }
+      int i;
+      int k;
+      const void* c = vs_art_child_from( p, key[d], &i, &k );
+      if ( ! c )
+        {
+        next();
+        return;
+        }
+      if ( ! push( p, i ) ) return;
+      if ( k != key[d] )
+        {
+        leaf = descend( c );
+        return;
+        }
+      n = c;
+      d++;
+      }
+  }
+
+  void next()
+  {
+    leaf = NULL;
+    while( depth > 0 )
+      {
+      pos* t = stack + depth - 1;
+      t->i++;
+      const void* c = vs_art_child_at( t->node, &t->i );
+      if ( c )
+        {
+        leaf = descend( c );
+        return;
+        }
+      depth--;
+      }
+  }
+
+  void copy( const vs_art_iter& it )
+  {
+    depth = 0;
+    leaf  = NULL;
+    if ( ! it.leaf ) return;
+    for( int i = 0; i < it.depth; i++ )
+      if ( ! push( it.stack[i].node, it.stack[i].i ) )
+        {
+        depth = 0;
+        return;
+        }
+    fresh = it.fresh;
+    leaf  = it.leaf;
+  }
+};
+
+struct vs_art_stats
+{
+  int    nodes[5];  // inner nodes count by type, [0] is leaves count
+  long   depth;     // inner nodes above all leaves, i.e. find() steps
+  int    max_depth;
+  size_t used;      // slabs bytes in live blocks
+  size_t total;     // slabs bytes
+};
+
+template< class LEAF >
+class vs_art
+{
+  public:
+
+  void*        root;
+  int          count; // leaves count
+  vs_art_slab* slab;  // inner nodes, shared with the trees sharing nodes
+
+  vs_art()  { root = NULL; count = 0; slab = vs_art_slab_new(); };
+  ~vs_art() { vs_art_slab_unref( slab ); }; // clear() must be called before
+
+  static LEAF* leaf( const void* p ) { return (LEAF*)vs_art_untag( p ); };
+
+  static int leaf_match( const LEAF* l, const unsigned char* key, int kl )
+    { return (int)l->kl == kl && memcmp( l->kb, key, kl ) == 0; };
+
+  /* leaf with the smallest key below `n' */
+  static LEAF* minimum( const void* n )
+  {
+    while( ! vs_art_is_leaf( n ) )
+      {
+      int i = 0;
+      n = vs_art_child_at( (const vs_art_node*)n, &i );
+      }
+    return leaf( n );
+  }
+
+  /* matched bytes of `n' prefix against `key' from `depth', full prefix
+     (not only the stored part) is compared */
+  static int prefix_mismatch( const vs_art_node* n, const unsigned char* key, int kl, int depth )
+  {
+    int max = n->pl < VS_ART_MAX_PREFIX ? n->pl : VS_ART_MAX_PREFIX;
+    if ( max > kl - depth ) max = kl - depth;
+    int i;
+    for( i = 0; i < max; i++ )
+      if ( n->prefix[i] != key[depth + i] ) return i;
+    if ( n->pl > VS_ART_MAX_PREFIX )
+      {
+      const LEAF* l = minimum( n );
+      max = ( (int)l->kl < kl ? (int)l->kl : kl ) - depth;
+      if ( max > (int)n->pl ) max = n->pl;
+      for( ; i < max; i++ )
+        if ( l->kb[depth + i] != key[depth + i] ) return i;
+      }
+    return i;
+  }
+
+  /* leaf with the longest key which is prefix of `key' or the same, keys
+     are compared without their terminating 0, NULL if none */
+  LEAF* longest_prefix( const unsigned char* key, int kl ) const
+  {
+    LEAF* best = NULL;
+    const void* n = root;
+    int depth = 0;
+    while( n )
+      {
+      if ( vs_art_is_leaf( n ) )
+        {
+        LEAF* l = leaf( n );
+        if ( (int)l->kl - 1 <= kl && memcmp( l->kb, key, l->kl - 1 ) == 0 ) return l;
+        return best;
+        }
+      const vs_art_node* p = (const vs_art_node*)n;
+      if ( p->pl )
+        {
+        if ( prefix_mismatch( p, key, kl, depth ) != (int)p->pl ) return best;
+        depth += p->pl;
+        }
+      void** slot = vs_art_find_child( (vs_art_node*)p, 0 );
+      if ( slot ) best = leaf( *slot ); // key ends here
+      if ( depth >= kl ) return best;
+      slot = vs_art_find_child( (vs_art_node*)p, key[depth] );
+      if ( ! slot ) return best;
+      n = *slot;
+      depth++;
+      }
+    return best;
+  }
+
+  LEAF* find( const unsigned char* key, int kl ) const
+  {
+    const void* n = root;
+    int depth = 0;
+    while( n )
+      {
+      if ( vs_art_is_leaf( n ) )
+        return leaf_match( leaf( n ), key, kl ) ? leaf( n ) : NULL;
+      vs_art_node* p = (vs_art_node*)n;
+      if ( p->pl )
+        { // only stored part is checked, leaf compare does the rest
+        int max = p->pl < VS_ART_MAX_PREFIX ? p->pl : VS_ART_MAX_PREFIX;
+        if ( max > kl - depth ) return NULL;
+        if ( memcmp( p->prefix, key + depth, max ) ) return NULL;
+        depth += p->pl;
+        }
+      if ( depth >= kl ) return NULL;
+      void** slot = vs_art_find_child( p, key[depth] );
+      n = slot ? *slot : NULL;
+      depth++;
+      }
+    return NULL;
+  }
+
+  /* leaf with `key' for change, NULL if not found. shared nodes on the
+     path are copied, shared leaf is replaced by `clone_leaf( l )' */
+  template< class CLONE >
+  LEAF* own( const unsigned char* key, int kl, CLONE& clone_leaf )
+  {
+    LEAF* l = find( key, kl );
+    if ( ! l || slab->refs == 1 ) return l; // nothing is shared
+    void** ref = &root;
+    int depth = 0;
+    while( ! vs_art_is_leaf( *ref ) )
+      {
+      vs_art_node* p = vs_art_own( slab, ref );
+      if ( ! p ) return NULL;
+      depth += p->pl;
+      ref = vs_art_find_child( p, key[depth] );
+      depth++;
+      }
+    if ( l->refs > 1 )
+      {
+      LEAF* nl = clone_leaf( l );
+      if ( ! nl ) return NULL;
+      l->refs--;
+      *ref = vs_art_tag( nl );
+      l = nl;
+      }
+    return l;
+  }
+
+  /* insert `l', its key must not be in the tree, returns 0 if out of memory */
+  int insert( LEAF* l )
+  {
+    if ( ! insert_at( &root, l, 0 ) ) return 0;
+    count++;
+    return 1;
+  }
+
+  int insert_at( void** ref, LEAF* l, int depth )
+  {
+    const unsigned char* key = l->kb;
+    while(4)
+      {
+      void* n = *ref;
+      if ( ! n )
+        {
+        *ref = vs_art_tag( l );
+        return 1;
+        }
+      if ( vs_art_is_leaf( n ) )
+        { // split leaf, new node gets the common part as prefix
+        LEAF* o = leaf( n );
+        int i = depth;
+        while( o->kb[i] == key[i] ) i++; // keys are prefix free
+        vs_art_node* nn = vs_art_new_node( slab, VS_ART_NODE4 );
+        if ( ! nn ) return 0;
+        nn->pl = i - depth;
+        memcpy( nn->prefix, key + depth, nn->pl < VS_ART_MAX_PREFIX ? nn->pl : VS_ART_MAX_PREFIX );
+        vs_art_add_child( slab, nn, ref, o->kb[i], n );
+        vs_art_add_child( slab, nn, ref, key[i], vs_art_tag( l ) );
+        *ref = nn;
+        return 1;
+        }
+      vs_art_node* p = vs_art_own( slab, ref );
+      if ( ! p ) return 0;
+      if ( p->pl )
+        {
+        int pd = prefix_mismatch( p, key, l->kl, depth );
+        if ( pd < (int)p->pl )
+          { // split prefix at the first mismatch
+          vs_art_node* nn = vs_art_new_node( slab, VS_ART_NODE4 );
+          if ( ! nn ) return 0;
+          nn->pl = pd;
+          memcpy( nn->prefix, p->prefix, pd < VS_ART_MAX_PREFIX ? pd : VS_ART_MAX_PREFIX );
+          if ( p->pl <= VS_ART_MAX_PREFIX )
+            {
+            vs_art_add_child( slab, nn, ref, p->prefix[pd], p );
+            p->pl -= pd + 1;
+            memmove( p->prefix, p->prefix + pd + 1, p->pl < VS_ART_MAX_PREFIX ? p->pl : VS_ART_MAX_PREFIX );
+            }
+          else
+            {
+            p->pl -= pd + 1;
+            const LEAF* m = minimum( p );
+            vs_art_add_child( slab, nn, ref, m->kb[depth + pd], p );
+            memcpy( p->prefix, m->kb + depth + pd + 1, p->pl < VS_ART_MAX_PREFIX ? p->pl : VS_ART_MAX_PREFIX );
+            }
+          vs_art_add_child( slab, nn, ref, key[depth + pd], vs_art_tag( l ) );
+          *ref = nn;
+          return 1;
+          }
+        depth += p->pl;
+        }
+      void** slot = vs_art_find_child( p, key[depth] );
+      if ( ! slot ) return vs_art_add_child( slab, p, ref, key[depth], vs_art_tag( l ) );
+      ref = slot;
+      depth++;
+      }
+  }
+
+  /* unlink leaf with `key', returns it or NULL if not found. the leaf may
+     be still used by other trees, caller drops its reference */
+  LEAF* remove( const unsigned char* key, int kl )
+  {
+    if ( slab->refs > 1 && ! find( key, kl ) ) return NULL; // no copies for missing keys
+    void** ref = &root;
+    int depth = 0;
+    while( *ref )
+      {
+      void* n = *ref;
+      if ( vs_art_is_leaf( n ) )
+        { // single leaf tree
+        if ( ! leaf_match( leaf( n ), key, kl ) ) return NULL;
+        *ref = NULL;
+        count--;
+        return leaf( n );
+        }
+      vs_art_node* p = vs_art_own( slab, ref );
+      if ( ! p ) return NULL;
+      if ( p->pl )
+        {
+        int max = p->pl < VS_ART_MAX_PREFIX ? p->pl : VS_ART_MAX_PREFIX;
+        if ( max > kl - depth ) return NULL;
+        if ( memcmp( p->prefix, key + depth, max ) ) return NULL;
+        depth += p->pl;
+        }
+      if ( depth >= kl ) return NULL;
+      void** slot = vs_art_find_child( p, key[depth] );
+      if ( ! slot ) return NULL;
+      if ( vs_art_is_leaf( *slot ) )
+        {
+        LEAF* l = leaf( *slot );
+        if ( ! leaf_match( l, key, kl ) ) return NULL;
+        vs_art_remove_child( slab, p, ref, key[depth], slot );
+        count--;
+        return l;
+        }
+      ref = slot;
+      depth++;
+      }
+    return NULL;
+  }
+
+  /* subtree with all keys starting with `prefix', NULL if none */
+  const void* seek( const unsigned char* prefix, int pl ) const
+  {
+    const void* n = root;
+    int depth = 0;
+    while( n )
+      {
+      if ( vs_art_is_leaf( n ) )
+        {
+        const LEAF* l = leaf( n );
+        return (int)l->kl >= pl && memcmp( l->kb, prefix, pl ) == 0 ? n : NULL;
+        }
+      const vs_art_node* p = (const vs_art_node*)n;
+      if ( depth == pl )
+        { // skipped prefix bytes are checked against any leaf
+        const LEAF* l = minimum( p );
+        return memcmp( l->kb, prefix, pl ) == 0 ? n : NULL;
+        }
+      if ( p->pl )
+        {
+        int m = prefix_mismatch( p, prefix, pl, depth );
+        if ( depth + m == pl ) return n; // prefix ends inside the path
+        if ( m < (int)p->pl ) return NULL;
+        depth += p->pl;
+        }
+      void** slot = vs_art_find_child( (vs_art_node*)p, prefix[depth] );
+      n = slot ? *slot : NULL;
+      depth++;
+      }
+    return NULL;
+  }
+
+  /* nodes count, lookup depth and memory, walks the whole tree */
+  void stats( vs_art_stats* st ) const
+  {
+    memset( st, 0, sizeof( *st ) );
+    st->used  = slab->used;
+    st->total = slab->total;
+    vs_art_iter<LEAF> it;
+    for( it.start( root ); it.leaf; it.next() )
+      {
+      int d = it.level();
+      for( int i = it.fresh; i < d; i++ )
+        st->nodes[it.node( i )->type]++;
+      st->nodes[0]++;
+      st->depth += d;
+      if ( st->max_depth < d ) st->max_depth = d;
+      }
+  }
+
+  /* share all nodes of `a' with this (empty) tree, O(1) */
+  void share( const vs_art& a )
+  {
+    vs_art_slab_unref( slab );
+    slab = a.slab;
+    slab->refs++;
+    root  = a.root;
+    count = a.count;
+    if ( root ) vs_art_ref( root );
+  }
+
+  /* drop reference to `n', `free_leaf( l )' is called for each leaf no
+     longer used. shared subtrees are not walked */
+  template< class FREE >
+  void unref( void* n, FREE& free_leaf )
+  {
+    void** stack = NULL;
+    int depth = 0;
+    int size  = 0;
+    while( n )
+      {
+      if ( vs_art_is_leaf( n ) )
+        {
+        LEAF* l = leaf( n );
+        if ( --l->refs == 0 ) free_leaf( l );
+        }
+      else if ( --((vs_art_node*)n)->refs == 0 )
+        {
+        vs_art_node* p = (vs_art_node*)n;
+        int cnt;
+        void** slots = vs_art_slots( p, &cnt );
+        if ( depth + cnt > size )
+          {
+          int new_size = size * 2 + cnt + 64;
+          void** new_stack = (void**)realloc( stack, new_size * sizeof( void* ) );
+          if ( ! new_stack ) break; // the rest is left to the slabs
+          stack = new_stack;
+          size  = new_size;
+          }
+        for( int i = 0; i < cnt; i++ )
+          if ( slots[i] ) stack[depth++] = slots[i];
+        vs_art_free_node( slab, p );
+        }
+      n = depth > 0 ? stack[--depth] : NULL;
+      }
+    free( stack );
+  }
+
+  /* free all nodes, `free_leaf( l )' is called for each leaf no longer
+     used. inner nodes are released with the slabs if not shared */
+  template< class FREE >
+  void clear( FREE& free_leaf )
+  {
+    if ( slab->refs == 1 )
+      {
+      vs_art_iter<LEAF> it;
+      for( it.start( root ); it.leaf; it.next() )
+        free_leaf( it.leaf );
+      vs_art_slab_release( slab );
+      }
+    else
+      {
+      unref( root, free_leaf );
+      vs_art_slab_unref( slab );
+      slab = vs_art_slab_new();
+      }
+    root  = NULL;
+    count = 0;
+  }
+
+  /* deep copy of `n' (from another tree) into this one, `clone_leaf( l )'
+     returns leaf copy or NULL */
+  template< class CLONE >
+  void* clone( const void* n, CLONE& clone_leaf )
+  {
+    if ( ! n ) return NULL;
+    if ( vs_art_is_leaf( n ) )
+      {
+      LEAF* l = clone_leaf( leaf( n ) );
+      return l ? vs_art_tag( l ) : NULL;
+      }
+    const vs_art_node* p = (const vs_art_node*)n;
+    size_t size = vs_art_node_size( p->type );
+    vs_art_node* nn = (vs_art_node*)vs_art_alloc( slab, size );
+    if ( ! nn ) return NULL;
+    memcpy( nn, p, size );
+    nn->refs = 1;
+    int cnt;
+    void** slots = vs_art_slots( nn, &cnt );
+    for( int i = 0; i < cnt; i++ )
+      if ( slots[i] ) slots[i] = clone( slots[i], clone_leaf );
+    return nn;
+  }
+};
+
+#endif /* TOP */
+
+/***************************************************************************
+**
+** EOF
+**
+****************************************************************************/
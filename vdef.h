@@ -27,14 +27,25 @@
   #undef VS_STRING_CLASS  
   #undef VS_STRING_CLASS_R
   #undef VS_ARRAY_CLASS   
+  #undef VS_ARRAY_MAP_CLASS
   #undef VS_TRIE_CLASS    
+  #undef VS_TRIE_MAP_CLASS
+  #undef VS_DATRIE_CLASS
+  #undef VS_HASH_CLASS
   #undef VS_REGEXP_CLASS
   #undef VS_CHARSET_CLASS
+  #undef VS_TOKENIZER_CLASS
+  #undef VS_CSV_CLASS
+  #undef VS_STRING_REF
+  #undef VS_CHAR_REF
 
   #undef VS_STRING_BOX    
   #undef VS_ARRAY_BOX     
+  #undef VS_ARRAY_CHUNK
   #undef VS_TRIE_BOX      
   #undef VS_TRIE_NODE     
+  #undef VS_HASH_BOX
+  #undef VS_HASH_NODE
 
   #undef VS_FN_PRINTF     
   #undef VS_FN_SPRINTF    
@@ -51,6 +62,8 @@
   #undef VS_FN_STRTOL
   #undef VS_FN_STRTOLL
   #undef VS_FN_STRTOD
+  #undef VS_FN_STRXFRM
+  #undef VS_FN_MEMCHR
   #undef VS_FN_TOUPPER    
   #undef VS_FN_TOLOWER    
   
@@ -73,14 +86,25 @@
   #define VS_STRING_CLASS   WString
   #define VS_STRING_CLASS_R VString
   #define VS_ARRAY_CLASS    WArray
+  #define VS_ARRAY_MAP_CLASS WArrayMap
   #define VS_TRIE_CLASS     WTrie
+  #define VS_TRIE_MAP_CLASS WTrieMap
+  #define VS_DATRIE_CLASS   WDATrie
+  #define VS_HASH_CLASS     WHash
   #define VS_REGEXP_CLASS   WRegexp
   #define VS_CHARSET_CLASS  WCharSet
+  #define VS_TOKENIZER_CLASS WTokenizer
+  #define VS_CSV_CLASS      WCSV
+  #define VS_STRING_REF     WStringRef
+  #define VS_CHAR_REF       WCharRef
 
   #define VS_STRING_BOX     WStringBox
   #define VS_ARRAY_BOX      WArrayBox
+  #define VS_ARRAY_CHUNK    WArrayChunk
   #define VS_TRIE_BOX       WTrieBox
   #define VS_TRIE_NODE      WTrieNode
+  #define VS_HASH_BOX       WHashBox
+  #define VS_HASH_NODE      WHashNode
 
   #define VS_FN_PRINTF      wprintf
   #define VS_FN_SPRINTF     swprintf
@@ -97,6 +121,8 @@
   #define VS_FN_STRTOL(s)   wcstol(s,NULL,10)
   #define VS_FN_STRTOLL(s)  wcstoll(s,NULL,10)
   #define VS_FN_STRTOD(s)   wcstod(s,NULL)
+  #define VS_FN_STRXFRM     wcsxfrm
+  #define VS_FN_MEMCHR(s,c,n) wmemchr(s,c,n)
   #define VS_FN_TOUPPER     towupper
   #define VS_FN_TOLOWER     towlower
 
@@ -114,14 +140,25 @@
   #define VS_STRING_CLASS   VString
   #define VS_STRING_CLASS_R WString
   #define VS_ARRAY_CLASS    VArray
+  #define VS_ARRAY_MAP_CLASS VArrayMap
   #define VS_TRIE_CLASS     VTrie
+  #define VS_TRIE_MAP_CLASS VTrieMap
+  #define VS_DATRIE_CLASS   VDATrie
+  #define VS_HASH_CLASS     VHash
   #define VS_REGEXP_CLASS   VRegexp
   #define VS_CHARSET_CLASS  VCharSet
+  #define VS_TOKENIZER_CLASS VTokenizer
+  #define VS_CSV_CLASS      VCSV
+  #define VS_STRING_REF     VStringRef
+  #define VS_CHAR_REF       VCharRef
 
   #define VS_STRING_BOX     VStringBox
   #define VS_ARRAY_BOX      VArrayBox
+  #define VS_ARRAY_CHUNK    VArrayChunk
   #define VS_TRIE_BOX       VTrieBox
   #define VS_TRIE_NODE      VTrieNode
+  #define VS_HASH_BOX       VHashBox
+  #define VS_HASH_NODE      VHashNode
 
   #define VS_FN_PRINTF      printf
   #define VS_FN_SPRINTF     snprintf
@@ -138,6 +175,8 @@
   #define VS_FN_STRTOL(s)   strtol(s,NULL,10)
   #define VS_FN_STRTOLL(s)  strtoll(s,NULL,10)
   #define VS_FN_STRTOD(s)   strtod(s,NULL)
+  #define VS_FN_STRXFRM     strxfrm
+  #define VS_FN_MEMCHR(s,c,n) ((const char*)memchr(s,c,n))
   #define VS_FN_TOUPPER     toupper
   #define VS_FN_TOLOWER     tolower
 
@@ -17,6 +17,8 @@
  # 
  ***************************************************************************/
 
+#include <unistd.h>
+#include <pthread.h>
 #include "vdef.h"
 #include "vref.h"
 
@@ -46,4 +48,164 @@
     return memmove( dest, src, n * sizeof( wchar_t ) );
   }
 
+/****************************************************************************
+**
+** parallel execution
+**
+****************************************************************************/
+
+  static int __vs_parallel_threads   = 0;
+  static int __vs_parallel_threshold = 1 << 17;
+
+  int vs_parallel_threads()
+  {
+    int n = __vs_parallel_threads;
+    if ( n < 1 )
+      {
+      long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+      n = cpus > 0 ? (int)cpus : 1;
+      }
+    return n;
+  }
+
+  void vs_set_parallel_threads( int threads )
+  {
+    __vs_parallel_threads = threads > 0 ? threads : 0;
+  }
+
+  int vs_parallel_threshold()
+  {
+    return __vs_parallel_threshold;
+  }
+
+  void vs_set_parallel_threshold( int min_count )
+  {
+    __vs_parallel_threshold = min_count > 2 ? min_count : 2;
+  }
+
+  struct __vs_parallel_task
+  {
+    void (*fn)( int k, void* arg );
+    void* arg;
+    int   k;
+  };
 
+  static void* __vs_parallel_start( void* p )
+  {
+    __vs_parallel_task* t = (__vs_parallel_task*)p;
+    t->fn( t->k, t->arg );
+    return NULL;
+  }
+
+  // own threads for each task, used while the pool is busy (nested or
+  // concurrent runs) so tasks never wait for each other
+  static void __vs_parallel_spawn( int n, void (*fn)( int k, void* arg ), void* arg )
+  {
+    pthread_t*          th    = (pthread_t*)malloc( n * sizeof( pthread_t ) );
+    __vs_parallel_task* tasks = (__vs_parallel_task*)malloc( n * sizeof( __vs_parallel_task ) );
+    char*               ok    = (char*)malloc( n );
+    if ( ! th || ! tasks || ! ok )
+      { // no memory even for bookkeeping, just do it here
+      for( int k = 0; k < n; k++ ) fn( k, arg );
+      free( th );
+      free( tasks );
+      free( ok );
+      return;
+      }
+
+    int k;
+    for( k = 1; k < n; k++ )
+      {
+      tasks[k].fn  = fn;
+      tasks[k].arg = arg;
+      tasks[k].k   = k;
+      ok[k] = pthread_create( th + k, NULL, __vs_parallel_start, tasks + k ) == 0;
+      }
+    fn( 0, arg );
+    for( k = 1; k < n; k++ )
+      if ( ok[k] )
+        pthread_join( th[k], NULL );
+      else
+        fn( k, arg ); // could not start thread, run in place
+
+    free( th );
+    free( tasks );
+    free( ok );
+  }
+
+  // persistent workers, started on first use and grown up to the largest
+  // run. one run at a time, the caller takes tasks too, so a run always
+  // completes even if no worker could be started (or after fork())
+  static pthread_mutex_t __vs_pool_run  = PTHREAD_MUTEX_INITIALIZER; // held for the whole run
+  static pthread_mutex_t __vs_pool_lock = PTHREAD_MUTEX_INITIALIZER; // guards the fields below
+  static pthread_cond_t  __vs_pool_work = PTHREAD_COND_INITIALIZER;
+  static pthread_cond_t  __vs_pool_done = PTHREAD_COND_INITIALIZER;
+  static int             __vs_pool_workers = 0;
+  static unsigned        __vs_pool_gen     = 0; // run counter, wakes the workers
+  static void          (*__vs_pool_fn)( int k, void* arg ) = NULL;
+  static void*           __vs_pool_arg     = NULL;
+  static int             __vs_pool_n       = 0;
+  static int             __vs_pool_next    = 0; // next task to take
+  static int             __vs_pool_left    = 0; // tasks not finished yet
+
+  // takes and runs tasks of the current run, called with the lock held
+  static void __vs_pool_take()
+  {
+    while( __vs_pool_next < __vs_pool_n )
+      {
+      int   k   = __vs_pool_next++;
+      void (*fn)( int k, void* arg ) = __vs_pool_fn;
+      void* arg = __vs_pool_arg;
+      pthread_mutex_unlock( &__vs_pool_lock );
+      fn( k, arg );
+      pthread_mutex_lock( &__vs_pool_lock );
+      if ( --__vs_pool_left == 0 ) pthread_cond_signal( &__vs_pool_done );
+      }
+  }
+
+  static void* __vs_pool_worker( void* )
+  {
+    pthread_mutex_lock( &__vs_pool_lock );
+    unsigned seen = __vs_pool_gen;
+    while(4)
+      {
+      while( seen == __vs_pool_gen )
+        pthread_cond_wait( &__vs_pool_work, &__vs_pool_lock );
+      seen = __vs_pool_gen;
+      __vs_pool_take();
+      }
+    return NULL;
+  }
+
+  void vs_parallel_run( int n, void (*fn)( int k, void* arg ), void* arg )
+  {
+    if ( n < 1 ) return;
+    if ( n == 1 ) { fn( 0, arg ); return; }
+
+    if ( pthread_mutex_trylock( &__vs_pool_run ) )
+      {
+      __vs_parallel_spawn( n, fn, arg );
+      return;
+      }
+
+    pthread_mutex_lock( &__vs_pool_lock );
+    while( __vs_pool_workers < n - 1 )
+      {
+      pthread_t th;
+      if ( pthread_create( &th, NULL, __vs_pool_worker, NULL ) ) break;
+      pthread_detach( th );
+      __vs_pool_workers++;
+      }
+    __vs_pool_fn   = fn;
+    __vs_pool_arg  = arg;
+    __vs_pool_n    = n;
+    __vs_pool_next = 0;
+    __vs_pool_left = n;
+    __vs_pool_gen++;
+    pthread_cond_broadcast( &__vs_pool_work );
+    __vs_pool_take();
+    while( __vs_pool_left > 0 )
+      pthread_cond_wait( &__vs_pool_done, &__vs_pool_lock );
+    pthread_mutex_unlock( &__vs_pool_lock );
+    pthread_mutex_unlock( &__vs_pool_run );
+  }
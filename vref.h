@@ -27,6 +27,7 @@
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <iterator>
 
 #include <assert.h>
 #ifndef ASSERT
@@ -65,6 +66,27 @@ public:
   void *vs_memcpy(  wchar_t *dest, const wchar_t *src, size_t n );
   void *vs_memmove( wchar_t *dest, const wchar_t *src, size_t n );
 
+/****************************************************************************
+**
+** parallel execution
+**
+** large operations (VArray/WArray sort, grep() and map()) split work between
+** threads when element count is at least vs_parallel_threshold().
+** threads count 0 means all online CPUs, 1 disables threading.
+** note: custom sort comparators must be thread-safe then.
+**
+****************************************************************************/
+
+  int  vs_parallel_threads(); // effective threads count, at least 1
+  void vs_set_parallel_threads( int threads );
+  int  vs_parallel_threshold();
+  void vs_set_parallel_threshold( int min_count );
+
+  // calls fn( k, arg ) for k in [0,n) in n threads, returns when all done.
+  // threads are kept in a pool started on first use, runs nested in `fn'
+  // or concurrent with other run use their own threads
+  void vs_parallel_run( int n, void (*fn)( int k, void* arg ), void* arg );
+
 #endif /* TOP */
 
 /***************************************************************************
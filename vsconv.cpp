@@ -0,0 +1,75 @@
+/****************************************************************************
+ #
+ #  VSTRING Library
+ #
+ #  Copyright (c) 1996-2023 Vladi Belperchinov-Shabanski "Cade" 
+ #  http://cade.noxrun.com/  <cade@noxrun.com> <cade@bis.bg> <cade@cpan.org>
+ #
+ #  Distributed under the GPL license, you should receive copy of GPLv2!
+ #
+ #  SEE 'README', 'LICENSE' OR 'COPYING' FILE FOR LICENSE AND OTHER DETAILS!
+ #
+ #  VSTRING library provides wide set of string manipulation features
+ #  including dynamic string object that can be freely exchanged with
+ #  standard char* (or wchar_t*) type, so there is no need to change 
+ #  function calls nor the implementation when you change from 
+ #  char* to VString (and from wchar_t* to WString). 
+ # 
+ ***************************************************************************/
+
+/*
+** text <-> binary VArray file converter, usage:
+**
+**   vsconv -b text-file binary-file   -- text lines to VArray::bsave() format
+**   vsconv -t binary-file text-file   -- VArray::bsave() format to text lines
+**
+** add -w to convert through WArray (binary file holds wide chars then).
+**
+*/
+
+#include <stdio.h>
+#include <locale.h>
+#include "vstring.h"
+#include "wstring.h"
+
+int main( int argc, char** argv )
+{
+  setlocale( LC_ALL, "" );
+
+  int wide = argc > 1 && strcmp( argv[1], "-w" ) == 0;
+  if ( wide )
+    {
+    argc--;
+    argv++;
+    }
+  if ( argc != 4 || ( strcmp( argv[1], "-b" ) && strcmp( argv[1], "-t" ) ) )
+    {
+    fprintf( stderr, "usage: vsconv [-w] -b text-file binary-file\n"
+                     "       vsconv [-w] -t binary-file text-file\n" );
+    return 1;
+    }
+
+  int to_bin = argv[1][1] == 'b';
+  int r;
+  if ( wide )
+    {
+    WArray wa;
+    r = to_bin ? wa.fload( argv[2] ) : wa.bload( argv[2] );
+    if ( r == 0 ) r = to_bin ? wa.bsave( argv[3] ) : wa.fsave( argv[3] );
+    }
+  else
+    {
+    VArray va;
+    r = to_bin ? va.fload( argv[2] ) : va.bload( argv[2] );
+    if ( r == 0 ) r = to_bin ? va.bsave( argv[3] ) : va.fsave( argv[3] );
+    }
+  if ( r )
+    fprintf( stderr, "vsconv: %s failed, error %d\n", argv[2], r );
+  return r;
+}
+
+/***************************************************************************
+**
+** EOF
+**
+****************************************************************************/
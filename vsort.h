@@ -0,0 +1,307 @@
+/****************************************************************************
+ #
+ #  VSTRING Library
+ #
+ #  Copyright (c) 1996-2023 Vladi Belperchinov-Shabanski "Cade"
+ #  http://cade.noxrun.com/  <cade@noxrun.com> <cade@bis.bg> <cade@cpan.org>
+ #
+ #  Distributed under the GPL license, you should receive copy of GPLv2!
+ #
+ #  SEE 'README', 'LICENSE' OR 'COPYING' FILE FOR LICENSE AND OTHER DETAILS!
+ #
+ #  VSTRING library provides wide set of string manipulation features
+ #  including dynamic string object that can be freely exchanged with
+ #  standard char* (or wchar_t*) type, so there is no need to change
+ #  function calls nor the implementation when you change from
+ #  char* to VString (and from wchar_t* to WString).
+ #
+ ***************************************************************************/
+
+/****************************************************************************
+**
+** generic sort helpers -- INTERNAL!
+**
+** all sorts work on plain arrays of T (usually pointers) and take `less'
+** functor, which must implement strict weak ordering: less( a, b ) != 0
+** when `a' must go before `b'.
+**
+** vs_pdq_sort()   -- pattern-defeating quicksort, O(n log n) worst case,
+**                    O(n) for sorted/reversed/equal input, not stable
+** vs_merge_sort() -- stable bottom-up merge sort, O(n log n), needs `tmp'
+**                    buffer with room for n elements
+**
+****************************************************************************/
+
+#ifndef _VSORT_H_
+#define _VSORT_H_
+
+#define VS_SORT_INSERTION_SIZE     24
+#define VS_SORT_NINTHER_SIZE      128
+#define VS_SORT_PARTIAL_MOVES       8
+#define VS_SORT_MERGE_RUN_SIZE     32
+
+template< class T >
+inline void vs_sort_swap( T& a, T& b )
+{
+  T t = a;
+  a = b;
+  b = t;
+}
+
+template< class T, class LESS >
+void vs_insertion_sort( T* a, int n, LESS& less )
+{
+  for( int i = 1; i < n; i++ )
+    {
+    if ( ! less( a[i], a[i-1] ) ) continue;
+    T t = a[i];
+    int j = i;
+    do
+      {
+      a[j] = a[j-1];
+      j--;
+      }
+    while( j > 0 && less( t, a[j-1] ) );
+    a[j] = t;
+    }
+}
+
+/* insertion sort which gives up after VS_SORT_PARTIAL_MOVES moves,
+   returns 1 if the range is sorted */
+template< class T, class LESS >
+int vs_partial_insertion_sort( T* a, int n, LESS& less )
+{
+  int moves = 0;
+  for( int i = 1; i < n; i++ )
+    {
+    if ( ! less( a[i], a[i-1] ) ) continue;
+    T t = a[i];
+    int j = i;
+    do
+      {
+      a[j] = a[j-1];
+      j--;
+      }
+    while( j > 0 && less( t, a[j-1] ) );
+    a[j] = t;
+    moves += i - j;
+    if ( moves > VS_SORT_PARTIAL_MOVES ) return 0;
+    }
+  return 1;
+}
+
+template< class T, class LESS >
+void vs_heap_sift( T* a, int i, int n, LESS& less )
+{
+  T t = a[i];
+  while(4)
+    {
+    int c = 2 * i + 1;
+    if ( c >= n ) break;
+    if ( c + 1 < n && less( a[c], a[c+1] ) ) c++;
+    if ( ! less( t, a[c] ) ) break;
+    a[i] = a[c];
+    i = c;
+    }
+  a[i] = t;
+}
+
+template< class T, class LESS >
+void vs_heap_sort( T* a, int n, LESS& less )
+{
+  for( int i = n / 2 - 1; i >= 0; i-- )
+    vs_heap_sift( a, i, n, less );
+  for( int i = n - 1; i > 0; i-- )
+    {
+    vs_sort_swap( a[0], a[i] );
+    vs_heap_sift( a, 0, i, less );
+    }
+}
+
+template< class T, class LESS >
+inline void vs_sort3( T* a, int i, int j, int k, LESS& less )
+{
+  if ( less( a[j], a[i] ) ) vs_sort_swap( a[i], a[j] );
+  if ( less( a[k], a[j] ) ) vs_sort_swap( a[j], a[k] );
+  if ( less( a[j], a[i] ) ) vs_sort_swap( a[i], a[j] );
+}
+
+/* partition around a[0], elements equal to pivot go right,
+   returns final pivot position, `already' is set if no swaps were needed */
+template< class T, class LESS >
+int vs_partition_right( T* a, int n, LESS& less, int* already )
+{
+  T pivot = a[0];
+  int first = 1;
+  int last  = n - 1;
+
+  while( first <= last &&   less( a[first], pivot ) ) first++;
+  while( first <= last && ! less( a[last],  pivot ) ) last--;
+
+  *already = first > last;
+
+  while( first < last )
+    {
+    vs_sort_swap( a[first], a[last] );
+    first++;
+    last--;
+    while(   less( a[first], pivot ) ) first++;
+    while( ! less( a[last],  pivot ) ) last--;
+    }
+
+  int p = first - 1;
+  a[0] = a[p];
+  a[p] = pivot;
+  return p;
+}
+
+/* partition around a[0], elements equal to pivot go left,
+   used when pivot equals the element preceding the range */
+template< class T, class LESS >
+int vs_partition_left( T* a, int n, LESS& less )
+{
+  T pivot = a[0];
+  int first = 0;
+  int last  = n;
+
+  while( less( pivot, a[--last] ) );
+  while( first < last && ! less( pivot, a[++first] ) );
+
+  while( first < last )
+    {
+    vs_sort_swap( a[first], a[last] );
+    while(   less( pivot, a[--last]  ) );
+    while( ! less( pivot, a[++first] ) );
+    }
+
+  a[0] = a[last];
+  a[last] = pivot;
+  return last;
+}
+
+template< class T, class LESS >
+void vs_pdq_loop( T* a, int n, LESS& less, int bad_allowed, int leftmost )
+{
+  while(4)
+    {
+    if ( n < VS_SORT_INSERTION_SIZE )
+      {
+      vs_insertion_sort( a, n, less );
+      return;
+      }
+
+    int h = n / 2;
+    if ( n > VS_SORT_NINTHER_SIZE )
+      {
+      vs_sort3( a, 0, h,     n - 1, less );
+      vs_sort3( a, 1, h - 1, n - 2, less );
+      vs_sort3( a, 2, h + 1, n - 3, less );
+      vs_sort3( a, h - 1, h, h + 1, less );
+      vs_sort_swap( a[0], a[h] );
+      }
+    else
+      {
+      vs_sort3( a, h, 0, n - 1, less );
+      }
+
+    // many equal elements: pivot is equal to the preceding element, so put
+    // all equal ones on the left and never touch them again
+    if ( ! leftmost && ! less( a[-1], a[0] ) )
+      {
+      int p = vs_partition_left( a, n, less );
+      a += p + 1;
+      n -= p + 1;
+      continue;
+      }
+
+    int already;
+    int p  = vs_partition_right( a, n, less, &already );
+    int ls = p;
+    int rs = n - p - 1;
+
+    if ( ls < n / 8 || rs < n / 8 )
+      {
+      // bad pivot, after too many of them switch to guaranteed O(n log n)
+      if ( --bad_allowed == 0 )
+        {
+        vs_heap_sort( a, n, less );
+        return;
+        }
+      // shuffle few elements to break adversarial patterns
+      if ( ls >= VS_SORT_INSERTION_SIZE )
+        {
+        vs_sort_swap( a[0],     a[ls / 4] );
+        vs_sort_swap( a[p - 1], a[p - ls / 4] );
+        }
+      if ( rs >= VS_SORT_INSERTION_SIZE )
+        {
+        vs_sort_swap( a[p + 1], a[p + 1 + rs / 4] );
+        vs_sort_swap( a[n - 1], a[n - rs / 4] );
+        }
+      }
+    else if ( already )
+      {
+      // already partitioned, probably (almost) sorted input
+      if ( vs_partial_insertion_sort( a, ls, less ) &&
+           vs_partial_insertion_sort( a + p + 1, rs, less ) ) return;
+      }
+
+    vs_pdq_loop( a, ls, less, bad_allowed, leftmost );
+    a += p + 1;
+    n  = rs;
+    leftmost = 0;
+    }
+}
+
+template< class T, class LESS >
+void vs_pdq_sort( T* a, int n, LESS& less )
+{
+  if ( n < 2 ) return;
+  int bad_allowed = 1;
+  for( int z = n; z > 1; z >>= 1 ) bad_allowed++;
+  vs_pdq_loop( a, n, less, bad_allowed, 1 );
+}
+
+template< class T, class LESS >
+void vs_merge_sort( T* a, int n, LESS& less, T* tmp )
+{
+  int i;
+  for( i = 0; i < n; i += VS_SORT_MERGE_RUN_SIZE )
+    vs_insertion_sort( a + i, n - i < VS_SORT_MERGE_RUN_SIZE ? n - i : VS_SORT_MERGE_RUN_SIZE, less );
+
+  T* src = a;
+  T* dst = tmp;
+  for( int w = VS_SORT_MERGE_RUN_SIZE; w < n; w *= 2 )
+    {
+    for( i = 0; i < n; i += 2 * w )
+      {
+      int m = i + w     < n ? i + w     : n;
+      int e = i + 2 * w < n ? i + 2 * w : n;
+      int l = i;
+      int r = m;
+      int d = i;
+      if ( m < e && ! less( src[m], src[m-1] ) )
+        { // runs are already in order
+        memcpy( dst + i, src + i, ( e - i ) * sizeof( T ) );
+        continue;
+        }
+      while( l < m && r < e )
+        dst[d++] = less( src[r], src[l] ) ? src[r++] : src[l++];
+      while( l < m ) dst[d++] = src[l++];
+      while( r < e ) dst[d++] = src[r++];
+      }
+    T* t = src;
+    src = dst;
+    dst = t;
+    }
+  if ( src != a )
+    memcpy( a, src, n * sizeof( T ) );
+}
+
+#endif /* TOP */
+
+/***************************************************************************
+**
+** EOF
+**
+****************************************************************************/
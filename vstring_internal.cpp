@@ -18,6 +18,14 @@
  ***************************************************************************/
 
 #include "vstring_internal.h"
+#include <math.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <new>
+#include "vsort.h"
 
   ssize_t str_len( const VS_CHAR *s )
   {
@@ -174,7 +182,7 @@
     if (ps == NULL) return;
     if (ps[0] == 0) return;
     int psl = str_len( ps );
-    resize( box->sl + psl );
+    reserve( box->sl + psl );
     vs_memcpy( box->s + box->sl, ps, psl );
     box->s[ box->sl + psl ] = 0;
     box->sl += psl;
@@ -189,8 +197,10 @@
       box->s[ 0 ] = 0;
       return;
       }
-    int z = str_len( ps );
-    if ( len < z ) z = len;
+    // stop at terminating 0 but never look beyond `len', `ps' may be
+    // a part of larger buffer without one
+    const VS_CHAR* pz = VS_FN_MEMCHR( ps, 0, len );
+    int z = pz ? pz - ps : len;
     resize( z );
     box->sl = z;
     vs_memcpy( box->s, ps, z );
@@ -200,9 +210,9 @@
   void VS_STRING_CLASS::catn( const VS_CHAR* ps, int len )
   {
     if ( !ps || len < 1 ) return;
-    int z = str_len( ps );
-    if ( len < z ) z = len;
-    resize( box->sl + z );
+    const VS_CHAR* pz = VS_FN_MEMCHR( ps, 0, len ); // as setn()
+    int z = pz ? pz - ps : len;
+    reserve( box->sl + z );
     vs_memcpy( box->s + box->sl, ps, z );
     box->sl += z;
     box->s[ box->sl ] = 0;
@@ -404,6 +414,7 @@
 
   void str_add_ch( VS_STRING_CLASS &target, const VS_CHAR ch ) // adds `ch' at the end
   {
+    target.detach();
     int sl = target.box->sl;
     if( sl + 1 >= target.box->size ) target.resize( sl + 1 );
     target.box->s[sl] = ch;
@@ -505,7 +516,7 @@
 
   /* utilities */
 
-  void VS_STRING_CLASS::print() // print string data to stdout (console)
+  void VS_STRING_CLASS::print() const // print string data to stdout (console)
   {
     #ifdef _VSTRING_WIDE_
     wprintf( L"%ls\n", box->s );
@@ -1121,16 +1132,95 @@
     return ( (dc + cc == sl) && ( cc == 1 ) );
   }
 
+/***************************************************************************
+**
+** VARRAYCHUNK
+**
+****************************************************************************/
+
+  VS_ARRAY_CHUNK::~VS_ARRAY_CHUNK()
+  {
+    for( int i = 0; i < VARRAY_CHUNK_SIZE; i++ )
+      if ( e[i] ) delete e[i];
+  }
+
+  VS_ARRAY_CHUNK* VS_ARRAY_CHUNK::clone()
+  {
+    VS_ARRAY_CHUNK *new_chunk = new VS_ARRAY_CHUNK();
+    for( int i = 0; i < VARRAY_CHUNK_SIZE; i++ )
+      if ( e[i] ) new_chunk->e[i] = new VS_STRING_CLASS( *e[i] );
+    return new_chunk;
+  }
+
 /***************************************************************************
 **
 ** VARRAYBOX
 **
 ****************************************************************************/
 
+namespace {
+
+  // directory entries used by elements: first one and count
+  inline void __vs_array_span( const VS_ARRAY_BOX* box, int* first, int* span )
+  {
+    *first = box->_head >> VARRAY_CHUNK_BITS;
+    *span  = ( ( box->_head + box->_count + VARRAY_CHUNK_MASK ) >> VARRAY_CHUNK_BITS ) - *first;
+  }
+
+  inline VS_STRING_CLASS** __vs_array_pos( VS_ARRAY_BOX* box, int p )
+  {
+    return box->_dir[ p >> VARRAY_CHUNK_BITS ]->e + ( p & VARRAY_CHUNK_MASK );
+  }
+
+  // move `cnt' element pointers from `src' to `dst', vacated slots are
+  // cleared. all chunks in the range must be private already.
+  void __vs_array_move( VS_ARRAY_BOX* box, int dst, int src, int cnt )
+  {
+    if ( cnt < 1 || dst == src ) return;
+    int ps = box->_head + src;
+    int pd = box->_head + dst;
+    int left = cnt;
+    if ( dst < src )
+      {
+      while( left > 0 )
+        {
+        int seg = left;
+        if ( seg > VARRAY_CHUNK_SIZE - ( ps & VARRAY_CHUNK_MASK ) ) seg = VARRAY_CHUNK_SIZE - ( ps & VARRAY_CHUNK_MASK );
+        if ( seg > VARRAY_CHUNK_SIZE - ( pd & VARRAY_CHUNK_MASK ) ) seg = VARRAY_CHUNK_SIZE - ( pd & VARRAY_CHUNK_MASK );
+        memmove( __vs_array_pos( box, pd ), __vs_array_pos( box, ps ), seg * sizeof(VS_STRING_CLASS*) );
+        ps += seg;
+        pd += seg;
+        left -= seg;
+        }
+      }
+    else
+      {
+      ps += cnt;
+      pd += cnt;
+      while( left > 0 )
+        {
+        int seg = left;
+        if ( seg > ( ( ps - 1 ) & VARRAY_CHUNK_MASK ) + 1 ) seg = ( ( ps - 1 ) & VARRAY_CHUNK_MASK ) + 1;
+        if ( seg > ( ( pd - 1 ) & VARRAY_CHUNK_MASK ) + 1 ) seg = ( ( pd - 1 ) & VARRAY_CHUNK_MASK ) + 1;
+        ps -= seg;
+        pd -= seg;
+        memmove( __vs_array_pos( box, pd ), __vs_array_pos( box, ps ), seg * sizeof(VS_STRING_CLASS*) );
+        left -= seg;
+        }
+      }
+    int c0 = dst < src ? ( dst + cnt > src ? dst + cnt : src ) : src;
+    int c1 = dst < src ? src + cnt : ( src + cnt < dst ? src + cnt : dst );
+    for( int i = c0; i < c1; i++ )
+      *__vs_array_pos( box, box->_head + i ) = NULL;
+  }
+
+} // namespace
+
   VS_ARRAY_BOX::VS_ARRAY_BOX() 
   { 
-    _data      = NULL; 
-    _size      = 0; 
+    _dir       = NULL; 
+    _dir_size  = 0; 
+    _head      = 0; 
     _count     = 0; 
     block_size = VARRAY_DEFAULT_BLOCK_SIZE; 
   }
@@ -1142,55 +1232,276 @@
 
   void VS_ARRAY_BOX::undef() 
   { 
-    resize( 0 ); 
+    for( int c = 0; c < _dir_size; c++ )
+      if ( _dir[c] ) _dir[c]->unref();
+    if ( _dir ) free( _dir );
+    _dir      = NULL;
+    _dir_size = 0;
+    _head     = 0;
+    _count    = 0;
   }
 
   VS_ARRAY_BOX* VS_ARRAY_BOX::clone()
   {
     VS_ARRAY_BOX *new_box = new VS_ARRAY_BOX();
-    new_box->resize( _size );
-    new_box->_count = _count;
-    int i;
-    for( i = 0; i < _count; i++ )
+    new_box->block_size = block_size;
+    int first;
+    int span;
+    __vs_array_span( this, &first, &span );
+    if ( _count == 0 ) return new_box;
+    new_box->_dir = (VS_ARRAY_CHUNK**)malloc( span * sizeof(VS_ARRAY_CHUNK*) );
+    ASSERT( new_box->_dir );
+    for( int c = 0; c < span; c++ )
       {
-      new_box->_data[i] = new VS_STRING_CLASS;
-      *new_box->_data[i] = *_data[i];
+      new_box->_dir[c] = _dir[first + c];
+      new_box->_dir[c]->ref();
       }
+    new_box->_dir_size = span;
+    new_box->_head     = _head & VARRAY_CHUNK_MASK;
+    new_box->_count    = _count;
     return new_box;
   }
 
-  void VS_ARRAY_BOX::resize( int new_size )
+  VS_ARRAY_CHUNK* VS_ARRAY_BOX::own_chunk( int c )
   {
-    if ( new_size < 0 ) new_size = 0;
-    while ( new_size < _count )
+    VS_ARRAY_CHUNK *chunk = _dir[c];
+    if ( ! chunk )
+      chunk = new VS_ARRAY_CHUNK();
+    else if ( chunk->refs() > 1 )
       {
-      ASSERT( _data[ _count - 1 ] );
-      delete _data[ _count - 1 ];
-      _data[ _count - 1 ] = NULL;
-      _count--;
+      chunk = chunk->clone();
+      _dir[c]->unref();
       }
-    if ( new_size == 0 )
+    _dir[c] = chunk;
+    return chunk;
+  }
+
+  void VS_ARRAY_BOX::own( int n, int cnt )
+  {
+    if ( cnt < 1 ) return;
+    int c1 = ( _head + n + cnt - 1 ) >> VARRAY_CHUNK_BITS;
+    for( int c = ( _head + n ) >> VARRAY_CHUNK_BITS; c <= c1; c++ )
+      if ( ! _dir[c] || _dir[c]->refs() > 1 ) own_chunk( c );
+  }
+
+  void VS_ARRAY_BOX::reserve( int min_size )
+  {
+    if ( min_size > _count ) make_room( 0, min_size - _count );
+  }
+
+  void VS_ARRAY_BOX::make_room( int front, int back )
+  {
+    int end = _head + _count;
+    if ( _head >= front && end + back <= _dir_size * VARRAY_CHUNK_SIZE ) return;
+
+    int first;
+    int span;
+    __vs_array_span( this, &first, &span );
+
+    int head_off = _head & VARRAY_CHUNK_MASK;
+    int tail_off = ( VARRAY_CHUNK_SIZE - ( end & VARRAY_CHUNK_MASK ) ) & VARRAY_CHUNK_MASK;
+    int need_front = front > head_off ? ( front - head_off + VARRAY_CHUNK_MASK ) >> VARRAY_CHUNK_BITS : 0;
+    int need_back  = back  > tail_off ? ( back  - tail_off + VARRAY_CHUNK_MASK ) >> VARRAY_CHUNK_BITS : 0;
+
+    int new_first;
+    if ( need_front > first )
+      new_first = need_front + span; // room for as many unshifts as there are elements
+    else if ( first > span )
+      new_first = need_front; // queue use: reuse slack left by shift() instead of growing
+    else
+      new_first = first;
+
+    int need = new_first + span + need_back;
+    if ( need > _dir_size )
       {
-      if ( _data ) delete [] _data;
-      _data = NULL;
-      _size = 0;
-      _count = 0;
-      return;
+      // grow geometrically so n pushes/unshifts cost O(n) entry copies in total
+      int bc = ( block_size + VARRAY_CHUNK_MASK ) >> VARRAY_CHUNK_BITS;
+      int new_size = _dir_size * 2;
+      if ( new_size < need ) new_size = need;
+      new_size  = new_size / bc + ( new_size % bc != 0 );
+      new_size *= bc;
+      VS_ARRAY_CHUNK** new_dir = (VS_ARRAY_CHUNK**)realloc( _dir, new_size * sizeof(VS_ARRAY_CHUNK*) );
+      ASSERT( new_dir );
+      memset( new_dir + _dir_size, 0, ( new_size - _dir_size ) * sizeof(VS_ARRAY_CHUNK*) );
+      _dir      = new_dir;
+      _dir_size = new_size;
+      }
+    if ( new_first != first )
+      {
+      memmove( _dir + new_first, _dir + first, span * sizeof(VS_ARRAY_CHUNK*) );
+      if ( new_first > first )
+        memset( _dir + first, 0, ( new_first - first < span ? new_first - first : span ) * sizeof(VS_ARRAY_CHUNK*) );
+      else
+        {
+        int c0 = new_first + span > first ? new_first + span : first;
+        memset( _dir + c0, 0, ( first + span - c0 ) * sizeof(VS_ARRAY_CHUNK*) );
+        }
+      _head += ( new_first - first ) * VARRAY_CHUNK_SIZE;
+      }
+  }
+
+  void VS_ARRAY_BOX::open_gap( int n, int cnt )
+  {
+    if ( cnt < 1 ) return;
+    int old_count = _count;
+    if ( 2 * n < _count )
+      {
+      make_room( cnt, 0 );
+      _head  -= cnt;
+      _count += cnt;
+      own( 0, n + cnt );
+      __vs_array_move( this, 0, cnt, n );
+      }
+    else
+      {
+      make_room( 0, cnt );
+      _count += cnt;
+      own( n, _count - n );
+      __vs_array_move( this, n + cnt, n, old_count - n );
+      }
+  }
+
+  void VS_ARRAY_BOX::close_gap( int n, int cnt )
+  {
+    if ( cnt < 1 ) return;
+    int i;
+    if ( 2 * n + cnt < _count )
+      {
+      own( 0, n + cnt );
+      for( i = n; i < n + cnt; i++ )
+        {
+        delete *__vs_array_pos( this, _head + i );
+        *__vs_array_pos( this, _head + i ) = NULL;
+        }
+      __vs_array_move( this, cnt, 0, n );
+      _head += cnt;
+      }
+    else
+      {
+      own( n, _count - n );
+      for( i = n; i < n + cnt; i++ )
+        {
+        delete *__vs_array_pos( this, _head + i );
+        *__vs_array_pos( this, _head + i ) = NULL;
+        }
+      __vs_array_move( this, n, n + cnt, _count - n - cnt );
+      }
+    _count -= cnt;
+    release();
+  }
+
+  void VS_ARRAY_BOX::append( VS_ARRAY_BOX* src, int from, int cnt )
+  {
+    if ( cnt < 1 ) return;
+    int ps = src->_head + from;
+    if ( _count == 0 ) // free to pick alignment which allows chunk sharing
+      _head = ( _head & ~VARRAY_CHUNK_MASK ) | ( ps & VARRAY_CHUNK_MASK );
+    make_room( 0, cnt );
+    int aligned = ( ( _head + _count ) & VARRAY_CHUNK_MASK ) == ( ps & VARRAY_CHUNK_MASK );
+    int z = 0;
+    while( z < cnt )
+      {
+      if ( aligned && ( ( ps + z ) & VARRAY_CHUNK_MASK ) == 0 && cnt - z >= VARRAY_CHUNK_SIZE )
+        { // whole chunk, share it
+        int c = ( _head + _count ) >> VARRAY_CHUNK_BITS;
+        ASSERT( ! _dir[c] );
+        _dir[c] = src->_dir[ ( ps + z ) >> VARRAY_CHUNK_BITS ];
+        _dir[c]->ref();
+        _count += VARRAY_CHUNK_SIZE;
+        z      += VARRAY_CHUNK_SIZE;
+        continue;
+        }
+      slot( _count ) = new VS_STRING_CLASS( *src->at( from + z ) );
+      _count++;
+      z++;
+      }
+  }
+
+  void VS_ARRAY_BOX::prepend( VS_ARRAY_BOX* src, int from, int cnt )
+  {
+    if ( cnt < 1 ) return;
+    int pe = src->_head + from + cnt; // source end position
+    if ( _count == 0 )
+      _head = ( _head & ~VARRAY_CHUNK_MASK ) | ( pe & VARRAY_CHUNK_MASK );
+    make_room( cnt, 0 );
+    int aligned = ( _head & VARRAY_CHUNK_MASK ) == ( pe & VARRAY_CHUNK_MASK );
+    int z = cnt;
+    while( z > 0 )
+      {
+      if ( aligned && ( ( pe - ( cnt - z ) ) & VARRAY_CHUNK_MASK ) == 0 && z >= VARRAY_CHUNK_SIZE )
+        {
+        int c = ( _head - 1 ) >> VARRAY_CHUNK_BITS;
+        ASSERT( ! _dir[c] );
+        _dir[c] = src->_dir[ ( pe - ( cnt - z ) - 1 ) >> VARRAY_CHUNK_BITS ];
+        _dir[c]->ref();
+        _head  -= VARRAY_CHUNK_SIZE;
+        _count += VARRAY_CHUNK_SIZE;
+        z      -= VARRAY_CHUNK_SIZE;
+        continue;
+        }
+      _head--;
+      _count++;
+      z--;
+      slot( 0 ) = new VS_STRING_CLASS( *src->at( from + z ) );
+      }
+  }
+
+  void VS_ARRAY_BOX::gather( VS_STRING_CLASS** data )
+  {
+    own( 0, _count );
+    for( int i = 0; i < _count; i++ )
+      data[i] = *__vs_array_pos( this, _head + i );
+  }
+
+  void VS_ARRAY_BOX::scatter( VS_STRING_CLASS** data )
+  {
+    for( int i = 0; i < _count; i++ )
+      *__vs_array_pos( this, _head + i ) = data[i];
+  }
+
+  void VS_ARRAY_BOX::release()
+  {
+    int first;
+    int span;
+    __vs_array_span( this, &first, &span );
+    int c;
+    for( c = first - 1; c >= 0 && _dir[c]; c-- )
+      {
+      _dir[c]->unref();
+      _dir[c] = NULL;
       }
-    new_size  = new_size / block_size + (new_size % block_size != 0);
-    new_size *= block_size;
-    if ( new_size == _size ) return;
-    VS_STRING_CLASS** new_data = new VS_STRING_CLASS*[ new_size ];
-    ASSERT( new_data );
-    memset( new_data, 0, new_size * sizeof(VS_STRING_CLASS*) );
-    if ( _data )
+    for( c = first + span; c < _dir_size && _dir[c]; c++ )
       {
-      memcpy( new_data, _data,
-              (_size < new_size ? _size : new_size) * sizeof(VS_STRING_CLASS*) );
-      delete [] _data;
+      _dir[c]->unref();
+      _dir[c] = NULL;
       }
-    _size = new_size;
-    _data = new_data;
+    if ( _count == 0 && span > 0 && _dir[first] )
+      { // empty chunk left at unaligned head, append()/prepend() realign over it
+      _dir[first]->unref();
+      _dir[first] = NULL;
+      }
+  }
+
+  void VS_ARRAY_BOX::shrink()
+  {
+    release();
+    int first;
+    int span;
+    __vs_array_span( this, &first, &span );
+    int bc = ( block_size + VARRAY_CHUNK_MASK ) >> VARRAY_CHUNK_BITS;
+    // hysteresis: shrink only below 1/4 usage and keep 2x headroom, so
+    // alternating push/pop around a boundary does not thrash realloc()
+    if ( _dir_size <= bc || span >= _dir_size / 4 ) return;
+    int new_size = span * 2;
+    new_size  = new_size / bc + ( new_size % bc != 0 );
+    new_size *= bc;
+    memmove( _dir, _dir + first, span * sizeof(VS_ARRAY_CHUNK*) );
+    memset( _dir + span, 0, ( _dir_size - span ) * sizeof(VS_ARRAY_CHUNK*) );
+    _head -= first * VARRAY_CHUNK_SIZE;
+    VS_ARRAY_CHUNK** new_dir = (VS_ARRAY_CHUNK**)realloc( _dir, new_size * sizeof(VS_ARRAY_CHUNK*) );
+    ASSERT( new_dir );
+    _dir      = new_dir;
+    _dir_size = new_size;
   }
 
   void VS_ARRAY_BOX::set_block_size( int new_block_size )
@@ -1210,24 +1521,22 @@
     detach();
     if ( n >= box->_count )
       {
-      if ( n + 1 > box->_size ) box->resize( n + 1 );
+      box->reserve( n + 1 );
       for( int i = box->_count; i < n + 1; i++ )
         {
-        box->_data[i] = new VS_STRING_CLASS;
-        if( compact ) box->_data[i]->compact( compact );
+        VS_STRING_CLASS*& e = box->slot( i );
+        e = new VS_STRING_CLASS;
+        if( compact ) e->compact( compact );
         }
       box->_count = n + 1;
       }
     else
       {
-      if ( box->_count == box->_size ) box->resize( box->_size + 1 );
-      memmove( &box->_data[0] + n + 1,
-               &box->_data[0] + n,
-               ( box->_count - n ) * sizeof(VS_STRING_CLASS*) );
-      box->_count++;
-
-      box->_data[n] = new VS_STRING_CLASS;
-      if( compact ) box->_data[n]->compact( compact );
+      // open the gap by moving the shorter side, so unshift() is O(1)
+      box->open_gap( n, 1 );
+      VS_STRING_CLASS*& e = box->slot( n );
+      e = new VS_STRING_CLASS;
+      if( compact ) e->compact( compact );
       }  
   }
   
@@ -1235,12 +1544,9 @@
   {
     if ( n < 0 || n >= box->_count ) return;
     detach();
-    delete box->_data[n];
-    memmove( &box->_data[0] + n,
-             &box->_data[0] + n + 1,
-             ( box->_count - n ) * sizeof(VS_STRING_CLASS*) );
-    box->_count--;
-    if ( box->_size - box->_count > box->block_size ) box->resize( box->_count );
+    // close the gap by moving the shorter side, so shift() is O(1)
+    box->close_gap( n, 1 );
+    box->shrink();
   }
 
   VS_ARRAY_CLASS::VS_ARRAY_CLASS()
@@ -1276,10 +1582,20 @@
     box = new_box;
   }
 
+  VS_STRING_CLASS& VS_ARRAY_CLASS::ref( int n )
+  {
+    if ( n < 0 ) { _ret_str = VS_CHAR_L(""); return _ret_str; }
+    if ( n >= box->_count )
+      set( n, VS_CHAR_L("") );
+    else
+      detach();
+    return *box->slot( n );
+  }
+
   void VS_ARRAY_CLASS::ins( int n, const VS_CHAR* s )
   {
     new_pos( n );
-    box->_data[n]->set( s );
+    box->slot( n )->set( s );
   }
 
   void VS_ARRAY_CLASS::del( int n )
@@ -1290,7 +1606,8 @@
   void VS_ARRAY_CLASS::set( int n, const VS_CHAR* s )
   {
     if( n >= box->_count ) new_pos( n );
-    box->_data[n]->set( s );
+    else detach();
+    box->slot( n )->set( s );
   }
 
   const VS_CHAR* VS_ARRAY_CLASS::get( int n )
@@ -1298,7 +1615,7 @@
     if ( n < 0 || n >= box->_count )
       return NULL;
     else
-      return box->_data[n]->data();
+      return box->at( n )->data();
   }
 
   int VS_ARRAY_CLASS::push( const VS_CHAR* s )
@@ -1307,8 +1624,16 @@
     return box->_count;
   }
 
+  int VS_ARRAY_CLASS::push( const VS_CHAR* s, int len )
+  {
+    detach();
+    push_n( s, len );
+    return box->_count;
+  }
+
   int VS_ARRAY_CLASS::push( VS_TRIE_CLASS *tr )
   {
+    reserve( box->_count + 2 * tr->count() );
     tr->keys_and_values( this, this );
     return box->_count;
   }
@@ -1317,8 +1642,11 @@
   {
     ASSERT( arr != this );
     int cnt = arr->count();
-    for( int z = 0; z < cnt; z++ )
-      push( arr->get( z ) );
+    if ( cnt < 1 ) return box->_count;
+    detach();
+    // elements are copied as shared (copy-on-write) strings, no data copy,
+    // whole chunks are shared if both arrays have the same alignment
+    box->append( arr->box, 0, cnt );
     return box->_count;
   }
 
@@ -1347,10 +1675,10 @@
   int VS_ARRAY_CLASS::unshift( VS_ARRAY_CLASS *arr )
   {
     ASSERT( arr != this );
-    // TODO: this is not efficient, data storage must be moved by input count and filled in place!
     int cnt = arr->count();
-    for( int z = cnt - 1; z >= 0; z-- )
-      unshift( arr->get( z ) );
+    if ( cnt < 1 ) return box->_count;
+    detach();
+    box->prepend( arr->box, 0, cnt );
     return box->_count;
   }
 
@@ -1362,16 +1690,62 @@
     return _ret_str.data();
   }
 
+  VS_ARRAY_CLASS VS_ARRAY_CLASS::slice( int n, int cnt )
+  {
+    VS_ARRAY_CLASS arr;
+    if ( n < 0 ) n += box->_count;
+    if ( n < 0 ) n = 0;
+    if ( cnt < 0 || n + cnt > box->_count ) cnt = box->_count - n;
+    if ( cnt > 0 ) arr.box->append( box, n, cnt );
+    return arr;
+  }
+
+  void VS_ARRAY_CLASS::splice( int n, int cnt, VS_ARRAY_CLASS *arr )
+  {
+    ASSERT( arr != this );
+    if ( n < 0 ) n += box->_count;
+    if ( n < 0 ) n = 0;
+    if ( n > box->_count ) n = box->_count;
+    if ( cnt < 0 || n + cnt > box->_count ) cnt = box->_count - n;
+    int acnt = arr ? arr->count() : 0;
+    if ( cnt < 1 && acnt < 1 ) return;
+    detach();
+
+    // overwrite in place as much as possible, then close or open the rest
+    int k = cnt < acnt ? cnt : acnt;
+    int z;
+    for( z = 0; z < k; z++ )
+      *box->slot( n + z ) = *arr->box->at( z );
+    if ( cnt > k )
+      box->close_gap( n + k, cnt - k );
+    else if ( acnt > k )
+      {
+      int m = n + k;
+      if ( m == box->_count )
+        box->append( arr->box, k, acnt - k );
+      else if ( m == 0 )
+        box->prepend( arr->box, k, acnt - k );
+      else
+        {
+        box->open_gap( m, acnt - k );
+        for( z = k; z < acnt; z++ )
+          box->slot( n + z ) = new VS_STRING_CLASS( *arr->box->at( z ) );
+        }
+      }
+    box->shrink();
+  }
+
   void VS_ARRAY_CLASS::ins( int n, const VS_STRING_CLASS& vs )
   {
     new_pos( n );
-    *box->_data[n] = vs;
+    *box->slot( n ) = vs;
   }
   
   void VS_ARRAY_CLASS::set( int n, const VS_STRING_CLASS& vs )
   {
     if( n >= box->_count ) new_pos( n );
-    *box->_data[n] = vs;
+    else detach();
+    *box->slot( n ) = vs;
   }
 
   int VS_ARRAY_CLASS::push( const VS_STRING_CLASS& vs )
@@ -1386,9 +1760,119 @@
     return box->_count;
   }
 
+  #ifdef _VSTRING_WIDE_
+  // bulk multi-byte to wide conversion, as in set_failsafe()
+  size_t str_mbs_decode( wchar_t* dst, const char* src, size_t len )
+  {
+    mbstate_t st;
+    memset( &st, 0, sizeof( st ) );
+    wchar_t* d = dst;
+    const char* e = src + len;
+    while( src < e )
+      {
+      if ( (unsigned char)*src < 0x80 && mbsinit( &st ) )
+        {
+        *d++ = (unsigned char)*src++;
+        continue;
+        }
+      size_t r = mbrtowc( d, src, e - src, &st );
+      if ( r == (size_t)-1 || r == (size_t)-2 )
+        {
+        *d++ = 0xFFFD;
+        src++;
+        memset( &st, 0, sizeof( st ) );
+        }
+      else
+        {
+        d++;
+        src += r ? r : 1;
+        }
+      }
+    return d - dst;
+  }
+  #endif
+
+  void VS_ARRAY_CLASS::push_n( const VS_CHAR* s, int len )
+  {
+    // element is built in place, no temporary string
+    VS_STRING_CLASS* vs = new VS_STRING_CLASS;
+    if( compact ) vs->compact( compact );
+    vs->setn( s, len );
+    box->reserve( box->_count + 1 );
+    box->slot( box->_count ) = vs;
+    box->_count++;
+  }
+
+  size_t VS_ARRAY_CLASS::load_lines( const char* buf, size_t len, int eof )
+  {
+    size_t used = len;
+    if ( ! eof )
+      { // keep the last partial line for the next call
+      while( used > 0 && buf[used - 1] != '\n' ) used--;
+      if ( used == 0 ) return 0;
+      }
+
+    #ifdef _VSTRING_WIDE_
+    wchar_t* wbuf = (wchar_t*)malloc( ( used + 1 ) * sizeof( wchar_t ) );
+    if ( ! wbuf ) return 0;
+    const VS_CHAR* p = wbuf;
+    const VS_CHAR* e = wbuf + str_mbs_decode( wbuf, buf, used );
+    #else
+    const VS_CHAR* p = buf;
+    const VS_CHAR* e = buf + used;
+    #endif
+
+    detach();
+    while( p < e )
+      {
+      const VS_CHAR* nl = VS_FN_MEMCHR( p, '\n', e - p );
+      const VS_CHAR* le = nl ? nl : e;
+      while( le > p && le[-1] == '\r' ) le--;
+
+      push_n( p, le - p );
+
+      p = nl ? nl + 1 : e;
+      }
+
+    #ifdef _VSTRING_WIDE_
+    free( wbuf );
+    #endif
+    return used;
+  }
+
   int VS_ARRAY_CLASS::fload( const char* fname )
   {
     undef();
+    // regular files are mapped and scanned in place, no read buffers
+    int fd = open( fname, O_RDONLY );
+    if ( fd < 0 ) return 1;
+    struct stat st;
+    if ( fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 && (off_t)(size_t)st.st_size == st.st_size )
+      {
+      size_t size = st.st_size;
+      void* m = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if ( m != MAP_FAILED )
+        {
+        madvise( m, size, MADV_SEQUENTIAL );
+        const char* p = (const char*)m;
+        size_t left = size;
+        while( left > 0 )
+          {
+          // windows keep wide conversion buffers small, grow for long lines
+          size_t w = VARRAY_FLOAD_WINDOW;
+          size_t used;
+          while( ( used = load_lines( p, w < left ? w : left, w >= left ) ) == 0 && w < left ) w *= 2;
+          if ( used == 0 ) break; // out of memory
+          p    += used;
+          left -= used;
+          }
+        munmap( m, size );
+        close( fd );
+        return left > 0;
+        }
+      }
+    close( fd );
+
     FILE* f = fopen( fname, "rt" );
     if (!f) return 1;
     int r = fload( f );
@@ -1408,123 +1892,965 @@
   int VS_ARRAY_CLASS::fload( FILE* f )
   {
     undef();
-    char buf[1024*1024];
-    VString vstr;
-    while( fgets( buf, sizeof(buf)-1, f ) )
+    size_t size = VARRAY_FLOAD_WINDOW;
+    size_t len  = 0;
+    char*  buf  = (char*)malloc( size );
+    if ( ! buf ) return 1;
+    while(4)
       {
-      vstr += buf;
-      if ( str_get_ch( vstr, -1 ) != '\n' && !feof(f) ) continue;
-      while ( str_get_ch( vstr, -1 ) == '\r' || str_get_ch( vstr, -1 ) == '\n' ) str_trim_right( vstr, 1 );
-      #ifdef _VSTRING_WIDE_
-      push( WString( vstr ) );
-      #else
-      push( vstr );
-      #endif
-      vstr.undef();
+      if ( len == size )
+        { // line longer than the buffer
+        char* new_buf = (char*)realloc( buf, size * 2 );
+        if ( ! new_buf ) break;
+        buf   = new_buf;
+        size *= 2;
+        }
+      size_t r = fread( buf + len, 1, size - len, f );
+      len += r;
+      size_t used = load_lines( buf, len, r == 0 );
+      memmove( buf, buf + used, len - used );
+      len -= used;
+      if ( r == 0 ) break;
       }
+    free( buf );
     return 0;
   }
 
-  int VS_ARRAY_CLASS::fsave( FILE* f )
+namespace {
+
+  // buffered line writer for fsave(), data goes out in large fwrite()
+  // blocks. wide strings are converted straight into the buffer.
+  struct __vs_fsave_buf
   {
-    for( int z = 0; z < box->_count; z++ )
-      {
-      size_t len;
-      const char* ps;
+    FILE*  f;
+    char*  buf;
+    size_t used;
+    int    err;
+
+    int open( FILE* a_f )
+    {
+      f    = a_f;
+      buf  = (char*)malloc( VARRAY_FSAVE_BUFFER );
+      used = 0;
+      err  = buf ? 0 : 2;
+      return err;
+    }
+
+    int close()
+    {
+      flush();
+      free( buf );
+      return err;
+    }
+
+    void flush()
+    {
+      if ( used && ! err && fwrite( buf, 1, used, f ) != used ) err = 2;
+      used = 0;
+    }
+
+    void put( const VS_CHAR* s, size_t len )
+    {
       #ifdef _VSTRING_WIDE_
-      VString vstr = get(z);
-      ps  = vstr.data();
-      len = str_len( vstr );
+      mbstate_t st;
+      memset( &st, 0, sizeof( st ) );
+      for( size_t i = 0; i < len; i++ )
+        {
+        if ( VARRAY_FSAVE_BUFFER - used < MB_LEN_MAX ) flush();
+        if ( s[i] >= 0 && s[i] < 0x80 )
+          {
+          buf[used++] = (char)s[i];
+          continue;
+          }
+        size_t r = wcrtomb( buf + used, s[i], &st );
+        if ( r == (size_t)-1 )
+          { // not representable in current locale
+          memset( &st, 0, sizeof( st ) );
+          buf[used++] = '?';
+          }
+        else
+          used += r;
+        }
       #else
-      ps  = get(z);
-      len = str_len( ps );
+      put_raw( s, len );
       #endif
-      if ( fwrite( ps, 1, len, f ) != len ) return 2;
-      if ( fwrite( "\n", 1, 1, f ) != 1 ) return 2;
-      }
-    return 0;
-  }
+    }
 
-  void VS_ARRAY_CLASS::sort( int rev, int (*q_strcmp)(const VS_CHAR *, const VS_CHAR *) )
+    void put_raw( const void* data, size_t len )
+    {
+      if ( VARRAY_FSAVE_BUFFER - used < len ) flush();
+      if ( len >= VARRAY_FSAVE_BUFFER )
+        {
+        if ( ! err && fwrite( data, 1, len, f ) != len ) err = 2;
+        return;
+        }
+      memcpy( buf + used, data, len );
+      used += len;
+    }
+
+    void nl()
+    {
+      if ( used == VARRAY_FSAVE_BUFFER ) flush();
+      buf[used++] = '\n';
+    }
+
+    void put_line( const VS_STRING_CLASS& str )
+    {
+      put( str.data(), str_len( str ) );
+      nl();
+    }
+  };
+
+} // namespace
+
+  int VS_ARRAY_CLASS::fsave( FILE* f )
   {
-    if ( count() > 1 )
-      q_sort( 0, count() - 1, q_strcmp ? q_strcmp : VS_FN_STRCMP );
-    if ( rev ) // FIXME: not optimal...
-      reverse();
+    __vs_fsave_buf out;
+    if ( out.open( f ) ) return 2;
+    for( int z = 0; z < box->_count && ! out.err; z++ )
+      out.put_line( *box->at( z ) );
+    return out.close();
   }
 
-  void VS_ARRAY_CLASS::q_sort( int lo, int hi, int (*q_strcmp)(const VS_CHAR *, const VS_CHAR *) )
+namespace {
+
+  #define VS_BIN_MAGIC    "VSARRAY"
+  #define VS_BIN_VERSION  1
+  #define VS_BIN_ORDER    0x01020304
+
+  struct __vs_bin_header
   {
-    int m, l, r;
-    const VS_CHAR* v;
+    char               magic[8];
+    unsigned int       version;
+    unsigned int       order;     // VS_BIN_ORDER in writer's byte order
+    unsigned int       char_size; // sizeof( VS_CHAR )
+    unsigned int       reserved;
+    unsigned long long count;
+  };
 
-    m = ( hi + lo ) / 2;
-    v = box->_data[m]->data();
-    l = lo;
-    r = hi;
+} // namespace
 
-    do
+  int VS_ARRAY_CLASS::bsave( const char* fname )
+  {
+    FILE* f = fopen( fname, "wb" );
+    if (!f) return 1;
+
+    int n = box->_count;
+    __vs_bin_header h;
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.magic, VS_BIN_MAGIC, sizeof( VS_BIN_MAGIC ) );
+    h.version   = VS_BIN_VERSION;
+    h.order     = VS_BIN_ORDER;
+    h.char_size = sizeof( VS_CHAR );
+    h.count     = n;
+
+    __vs_fsave_buf out;
+    if ( out.open( f ) ) { fclose( f ); return 2; }
+    out.put_raw( &h, sizeof( h ) );
+    unsigned long long off = 0;
+    int z;
+    for( z = 0; z <= n; z++ )
       {
-      while( (l <= hi) && (q_strcmp(box->_data[l]->data(),v) < 0) ) l++;
-      while( (r >= lo) && (q_strcmp(v,box->_data[r]->data()) < 0) ) r--;
-      if ( l <= r )
-        {
-        VS_STRING_CLASS *t;
-        t = box->_data[l];
-        box->_data[l] = box->_data[r];
-        box->_data[r] = t;
-        l++;
-        r--;
-        }
+      out.put_raw( &off, sizeof( off ) );
+      if ( z < n ) off += str_len( *box->at( z ) ) + 1;
       }
-    while( l <= r );
-
-    if ( lo < r ) q_sort( lo, r, q_strcmp );
-    if ( l < hi ) q_sort( l, hi, q_strcmp );
+    for( z = 0; z < n; z++ )
+      {
+      const VS_STRING_CLASS& str = *box->at( z );
+      out.put_raw( str.data(), ( str_len( str ) + 1 ) * sizeof( VS_CHAR ) );
+      }
+    int r = out.close();
+    if ( fclose( f ) && ! r ) r = 2;
+    return r;
   }
 
-  void VS_ARRAY_CLASS::reverse()
+  int VS_ARRAY_CLASS::bload( const char* fname )
   {
-    int m = box->_count / 2;
-    for( int z = 0; z < m; z++ )
+    undef();
+    VS_ARRAY_MAP_CLASS map;
+    int r = map.open( fname );
+    if ( r ) return r;
+    int n = map.count();
+    box->reserve( n );
+    for( int z = 0; z < n; z++ )
       {
-      VS_STRING_CLASS *t;
-      t = box->_data[z];
-      box->_data[z] = box->_data[box->_count-1-z];
-      box->_data[box->_count-1-z] = t;
+      const VS_CHAR* ps = map.get( z );
+      if ( ! ps ) return 3;
+      push_n( ps, map.len( z ) );
       }
+    return 0;
   }
 
-  void VS_ARRAY_CLASS::shuffle() /* Fisher-Yates shuffle */
+/***************************************************************************
+**
+** VARRAYMAP
+**
+****************************************************************************/
+
+  VS_ARRAY_MAP_CLASS::VS_ARRAY_MAP_CLASS()
   {
-    int i = box->_count - 1;
-    while( i >= 0 )
-      {
-      int j = rand() % ( i + 1 );
-      VS_STRING_CLASS *t;
-      t = box->_data[i];
-      box->_data[i] = box->_data[j];
-      box->_data[j] = t;
-      i--;
-      }
+    _map      = NULL;
+    _map_size = 0;
+    _count    = 0;
+    _offs     = NULL;
+    _blob     = NULL;
+    _blob_len = 0;
   }
 
-  void VS_ARRAY_CLASS::print()
+  VS_ARRAY_MAP_CLASS::~VS_ARRAY_MAP_CLASS()
   {
-    int z;
-    for( z = 0; z < count(); z++ )
-      VS_FN_PRINTF( VS_CHAR_L( "%d=" VS_SFMT "\n" ), z, get(z) );
+    close();
   }
 
-  int VS_ARRAY_CLASS::max_len()
+  int VS_ARRAY_MAP_CLASS::open( const char* fname )
   {
-    if ( count() == 0 ) return 0;
-    int l = 0;
-    int z;
-    for( z = 0; z < count(); z++ )
+    close();
+    int fd = ::open( fname, O_RDONLY );
+    if ( fd < 0 ) return 1;
+    struct stat st;
+    if ( fstat( fd, &st ) || (size_t)st.st_size < sizeof( __vs_bin_header ) + sizeof( unsigned long long ) ||
+         (off_t)(size_t)st.st_size != st.st_size )
       {
-      int sl = str_len(get(z));
-      if ( sl > l )
+      ::close( fd );
+      return 3;
+      }
+    size_t size = st.st_size;
+    void* m = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( m == MAP_FAILED ) return 1;
+
+    // header and table bounds only, elements are checked on access
+    const __vs_bin_header* h = (const __vs_bin_header*)m;
+    unsigned long long cnt = h->count;
+    unsigned long long table = sizeof( __vs_bin_header ) + ( cnt + 1 ) * sizeof( unsigned long long );
+    if ( memcmp( h->magic, VS_BIN_MAGIC, sizeof( VS_BIN_MAGIC ) ) || h->version != VS_BIN_VERSION ||
+         h->order != VS_BIN_ORDER || h->char_size != sizeof( VS_CHAR ) ||
+         cnt > 0x7fffffff || table > size )
+      {
+      munmap( m, size );
+      return 3;
+      }
+    _map      = m;
+    _map_size = size;
+    _count    = (int)cnt;
+    _offs     = (const unsigned long long*)( (const char*)m + sizeof( __vs_bin_header ) );
+    _blob     = (const VS_CHAR*)( (const char*)m + table );
+    _blob_len = ( size - table ) / sizeof( VS_CHAR );
+    if ( _offs[_count] > _blob_len )
+      {
+      close();
+      return 3;
+      }
+    return 0;
+  }
+
+  void VS_ARRAY_MAP_CLASS::close()
+  {
+    if ( _map ) munmap( _map, _map_size );
+    _map      = NULL;
+    _map_size = 0;
+    _count    = 0;
+    _offs     = NULL;
+    _blob     = NULL;
+    _blob_len = 0;
+  }
+
+  const VS_CHAR* VS_ARRAY_MAP_CLASS::get( int n ) const
+  {
+    if ( n < 0 || n >= _count ) return NULL;
+    unsigned long long b = _offs[n];
+    unsigned long long e = _offs[n + 1];
+    if ( b >= e || e > _blob_len || _blob[e - 1] != 0 ) return NULL; // damaged file
+    return _blob + b;
+  }
+
+  int VS_ARRAY_MAP_CLASS::len( int n ) const
+  {
+    if ( ! get( n ) ) return -1;
+    return (int)( _offs[n + 1] - _offs[n] - 1 );
+  }
+
+/***************************************************************************
+**
+** VARRAY SORT
+**
+** default (strcmp) order uses multikey quicksort over cached key prefixes:
+** every element carries the next VS_SORT_KEY_CHARS chars packed into one
+** 64-bit integer so most comparisons are single integer compares without
+** touching string data. custom comparators go through pdqsort.
+**
+****************************************************************************/
+
+#define VS_SORT_KEY_BITS     ( 8 * (int)sizeof( VS_CHAR ) )
+#define VS_SORT_KEY_CHARS    ( 64 / VS_SORT_KEY_BITS )
+#define VS_SORT_KEY_LAST     ( ( 1ULL << VS_SORT_KEY_BITS ) - 1 )
+#define VS_SORT_MKQS_SMALL   12
+
+#ifdef _VSTRING_WIDE_
+  // wcscmp() follows wchar_t signedness (even against the terminating 0),
+  // flip the sign bit to keep the same order for the packed keys
+  #define VS_SORT_KEY_CHAR(c) ( (unsigned long long)(unsigned int)(c) ^ ( (wchar_t)-1 < 0 ? 0x80000000ULL : 0 ) )
+#else
+  #define VS_SORT_KEY_CHAR(c) ( (unsigned long long)(unsigned char)(c) )
+#endif
+#define VS_SORT_KEY_END      VS_SORT_KEY_CHAR( 0 )
+
+namespace {
+
+  struct __vs_sort_item
+  {
+    unsigned long long key; // VS_SORT_KEY_CHARS chars at current depth
+    const VS_CHAR*     s;
+    int                len;
+    int                idx; // original position, used by key sorts
+    VS_STRING_CLASS*   e;
+  };
+
+  // pack chars [pos, pos+VS_SORT_KEY_CHARS) as unsigned big-endian number,
+  // chars past the end are packed as terminating 0, just as strcmp sees them
+  inline unsigned long long __vs_sort_key( const VS_CHAR* s, int len, int pos )
+  {
+    unsigned long long k = 0;
+    #if !defined(_VSTRING_WIDE_) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if ( pos + VS_SORT_KEY_CHARS <= len )
+      {
+      memcpy( &k, s + pos, sizeof( k ) );
+      return __builtin_bswap64( k );
+      }
+    #endif
+    for( int z = 0; z < VS_SORT_KEY_CHARS; z++ )
+      {
+      k <<= VS_SORT_KEY_BITS - 1; // two steps, shift by 64 is undefined
+      k <<= 1;
+      k |= VS_SORT_KEY_CHAR( pos + z < len ? s[pos + z] : 0 );
+      }
+    return k;
+  }
+
+  struct __vs_sort_item_less // used only as mkqs fallback on bad pivots
+  {
+    int depth;
+    int operator()( const __vs_sort_item& a, const __vs_sort_item& b ) const
+    {
+      if ( a.key != b.key ) return a.key < b.key;
+      if ( ( a.key & VS_SORT_KEY_LAST ) == VS_SORT_KEY_END ) return 0;
+      int pos = ( depth + 1 ) * VS_SORT_KEY_CHARS;
+      return VS_FN_STRCMP( a.s + pos, b.s + pos ) < 0;
+    }
+  };
+
+  struct __vs_sort_cmp_less
+  {
+    int (*cmp)(const VS_CHAR *, const VS_CHAR *);
+    int rev;
+    int operator()( VS_STRING_CLASS* a, VS_STRING_CLASS* b ) const
+    {
+      return rev ? cmp( b->data(), a->data() ) < 0 : cmp( a->data(), b->data() ) < 0;
+    }
+  };
+
+  int __vs_sort_budget( int n )
+  {
+    int b = 2;
+    while( n > 1 ) { n >>= 1; b += 2; }
+    return b;
+  }
+
+  void __vs_sort_mkqs( __vs_sort_item* a, int n, int depth, int keys_ok, int budget )
+  {
+    while( n > 1 )
+      {
+      int pos = depth * VS_SORT_KEY_CHARS;
+      if ( n < VS_SORT_MKQS_SMALL )
+        {
+        for( int i = 1; i < n; i++ )
+          {
+          __vs_sort_item t = a[i];
+          int j = i;
+          while( j > 0 && VS_FN_STRCMP( t.s + pos, a[j-1].s + pos ) < 0 )
+            {
+            a[j] = a[j-1];
+            j--;
+            }
+          a[j] = t;
+          }
+        return;
+        }
+
+      int z;
+      if ( ! keys_ok )
+        for( z = 0; z < n; z++ )
+          a[z].key = __vs_sort_key( a[z].s, a[z].len, pos );
+
+      if ( budget-- <= 0 )
+        { // too many bad pivots at this depth, avoid quadratic behaviour
+        __vs_sort_item_less less;
+        less.depth = depth;
+        vs_pdq_sort( a, n, less );
+        return;
+        }
+
+      unsigned long long k1 = a[0].key;
+      unsigned long long k2 = a[n / 2].key;
+      unsigned long long k3 = a[n - 1].key;
+      unsigned long long pv = k1 < k2 ? ( k2 < k3 ? k2 : ( k1 < k3 ? k3 : k1 ) )
+                                      : ( k1 < k3 ? k1 : ( k2 < k3 ? k3 : k2 ) );
+
+      // 3-way partition: [0,lt) < pv, [lt,gt] == pv, (gt,n) > pv
+      int lt = 0;
+      int gt = n - 1;
+      z = 0;
+      while( z <= gt )
+        {
+        unsigned long long k = a[z].key;
+        if ( k < pv )
+          vs_sort_swap( a[lt++], a[z++] );
+        else if ( k > pv )
+          vs_sort_swap( a[z], a[gt--] );
+        else
+          z++;
+        }
+
+      if ( lt > 1 )         __vs_sort_mkqs( a, lt, depth, 1, budget );
+      if ( n - gt - 1 > 1 ) __vs_sort_mkqs( a + gt + 1, n - gt - 1, depth, 1, budget );
+
+      if ( ( pv & VS_SORT_KEY_LAST ) == VS_SORT_KEY_END ) return; // all equal
+
+      a      += lt;
+      n       = gt - lt + 1;
+      depth  += 1;
+      keys_ok = 0;
+      budget  = __vs_sort_budget( n );
+      }
+  }
+
+  // serial sort of one range, `items' (mkqs key cache) and `tmp' (merge
+  // buffer) are caller provided scratch areas of n elements, may be NULL
+  void __vs_sort_range( VS_STRING_CLASS** data, int n, int rev, int (*cmp)(const VS_CHAR *, const VS_CHAR *),
+                        int stable, __vs_sort_item* items, VS_STRING_CLASS** tmp )
+  {
+    if ( n < 2 ) return;
+
+    __vs_sort_cmp_less less;
+    less.cmp = cmp;
+    less.rev = rev;
+
+    if ( stable )
+      {
+      if ( tmp )
+        vs_merge_sort( data, n, less, tmp );
+      else // slow but still stable
+        vs_insertion_sort( data, n, less );
+      return;
+      }
+
+    if ( cmp != VS_FN_STRCMP || ! items )
+      {
+      vs_pdq_sort( data, n, less );
+      return;
+      }
+
+    int z;
+    for( z = 0; z < n; z++ )
+      {
+      items[z].e   = data[z];
+      items[z].s   = data[z]->data();
+      items[z].len = str_len( *data[z] );
+      }
+
+    __vs_sort_mkqs( items, n, 0, 0, __vs_sort_budget( n ) );
+
+    if ( rev )
+      for( z = 0; z < n; z++ ) data[n - 1 - z] = items[z].e;
+    else
+      for( z = 0; z < n; z++ ) data[z] = items[z].e;
+  }
+
+  /*
+  ** parallel sort: the array is split in `threads' runs which are sorted
+  ** independently, then runs are merged pairwise. each merge is split on
+  ** "merge path" diagonals, so every round keeps all threads busy. merge
+  ** takes from the left run on ties, so stable sort stays stable.
+  */
+
+  struct __vs_sort_merge_task
+  {
+    int a0, a1; // left  run [a0,a1)
+    int b0, b1; // right run [b0,b1)
+    int d;      // destination position
+  };
+
+  struct __vs_sort_parallel_job
+  {
+    VS_STRING_CLASS** data;
+    VS_STRING_CLASS** src;
+    VS_STRING_CLASS** dst;
+    __vs_sort_item*   items;
+    int               n;
+    int               runs;
+    __vs_sort_cmp_less less;
+    int               stable;
+    __vs_sort_merge_task* tasks;
+  };
+
+  void __vs_sort_parallel_run( int k, void* arg )
+  {
+    __vs_sort_parallel_job* job = (__vs_sort_parallel_job*)arg;
+    int r0 = (int)( (long long)job->n *   k       / job->runs );
+    int r1 = (int)( (long long)job->n * ( k + 1 ) / job->runs );
+    __vs_sort_range( job->data + r0, r1 - r0, job->less.rev, job->less.cmp, job->stable,
+                     job->items ? job->items + r0 : NULL, job->dst + r0 );
+  }
+
+  void __vs_sort_parallel_merge( int k, void* arg )
+  {
+    __vs_sort_parallel_job* job = (__vs_sort_parallel_job*)arg;
+    __vs_sort_merge_task* t = job->tasks + k;
+    VS_STRING_CLASS** src = job->src;
+    VS_STRING_CLASS** dst = job->dst + t->d;
+    int a = t->a0;
+    int b = t->b0;
+    while( a < t->a1 && b < t->b1 )
+      *dst++ = job->less( src[b], src[a] ) ? src[b++] : src[a++];
+    while( a < t->a1 ) *dst++ = src[a++];
+    while( b < t->b1 ) *dst++ = src[b++];
+  }
+
+  // count of A elements among first `d' merged elements of A and B
+  int __vs_sort_merge_split( VS_STRING_CLASS** a, int na, VS_STRING_CLASS** b, int nb, int d,
+                             __vs_sort_cmp_less& less )
+  {
+    int lo = d > nb ? d - nb : 0;
+    int hi = d < na ? d : na;
+    while( lo < hi )
+      {
+      int i = ( lo + hi ) / 2;
+      int j = d - i;
+      if ( j > 0 && ! less( b[j-1], a[i] ) ) // a[i] goes before b[j-1]
+        lo = i + 1;
+      else
+        hi = i;
+      }
+    return lo;
+  }
+
+  int __vs_sort_parallel( VS_STRING_CLASS** data, int n, int rev, int (*cmp)(const VS_CHAR *, const VS_CHAR *),
+                          int stable, int threads )
+  {
+    VS_STRING_CLASS** tmp   = (VS_STRING_CLASS**)malloc( n * sizeof( VS_STRING_CLASS* ) );
+    __vs_sort_merge_task* tasks = (__vs_sort_merge_task*)malloc( 2 * threads * sizeof( __vs_sort_merge_task ) );
+    __vs_sort_item* items = NULL;
+    if ( ! stable && cmp == VS_FN_STRCMP )
+      items = (__vs_sort_item*)malloc( n * sizeof( __vs_sort_item ) );
+    if ( ! tmp || ! tasks || ( ! stable && cmp == VS_FN_STRCMP && ! items ) )
+      {
+      free( tmp );
+      free( tasks );
+      free( items );
+      return 0; // caller will do it serially
+      }
+
+    __vs_sort_parallel_job job;
+    job.data   = data;
+    job.dst    = tmp;
+    job.items  = items;
+    job.n      = n;
+    job.runs   = threads;
+    job.less.cmp = cmp;
+    job.less.rev = rev;
+    job.stable = stable;
+    job.tasks  = tasks;
+
+    vs_parallel_run( threads, __vs_sort_parallel_run, &job );
+    free( items );
+
+    VS_STRING_CLASS** src = data;
+    VS_STRING_CLASS** dst = tmp;
+    for( int w = 1; w < threads; w *= 2 )
+      {
+      int pairs = ( threads + 2 * w - 1 ) / ( 2 * w );
+      int per   = threads / pairs > 1 ? threads / pairs : 1; // tasks per pair
+      int nt    = 0;
+      for( int p = 0; p < pairs; p++ )
+        {
+        int r  = p * 2 * w;
+        int a0 = (int)( (long long)n * r / threads );
+        int a1 = (int)( (long long)n * ( r + w     < threads ? r + w     : threads ) / threads );
+        int b1 = (int)( (long long)n * ( r + 2 * w < threads ? r + 2 * w : threads ) / threads );
+        int na = a1 - a0;
+        int nb = b1 - a1;
+        int pi = 0; // previous split
+        int pd = 0;
+        for( int z = 1; z <= per; z++ )
+          {
+          int d = z == per ? na + nb : (int)( (long long)( na + nb ) * z / per );
+          int i = z == per ? na : __vs_sort_merge_split( src + a0, na, src + a1, nb, d, job.less );
+          __vs_sort_merge_task* t = tasks + nt++;
+          t->a0 = a0 + pi;
+          t->a1 = a0 + i;
+          t->b0 = a1 + pd - pi;
+          t->b1 = a1 + d - i;
+          t->d  = a0 + pd;
+          pi = i;
+          pd = d;
+          }
+        }
+      job.src = src;
+      job.dst = dst;
+      vs_parallel_run( nt, __vs_sort_parallel_merge, &job );
+      VS_STRING_CLASS** t = src;
+      src = dst;
+      dst = t;
+      }
+    if ( src != data )
+      memcpy( data, src, n * sizeof( VS_STRING_CLASS* ) );
+
+    free( tmp );
+    free( tasks );
+    return 1;
+  }
+
+  int __vs_sort_threads( int n )
+  {
+    if ( n < vs_parallel_threshold() ) return 1;
+    int threads = vs_parallel_threads();
+    int max = n / 4096; // keep runs reasonably large
+    if ( threads > max ) threads = max;
+    return threads > 1 ? threads : 1;
+  }
+
+  /*
+  ** key extraction for sort_key()
+  */
+
+  inline int __vs_sort_blank( VS_CHAR c )
+  {
+    return c == ' ' || c == '\t';
+  }
+
+  // locate 0-based `field' of `s', returns field start, `len' gets its length
+  const VS_CHAR* __vs_sort_field( const VS_CHAR* s, int field, const VS_CHAR* delims, int* len )
+  {
+    const VS_CHAR* e;
+    int f = 0;
+    while(4)
+      {
+      if ( ! delims )
+        { // blank separated, leading blanks ignored
+        while( __vs_sort_blank( *s ) ) s++;
+        e = s;
+        while( *e && ! __vs_sort_blank( *e ) ) e++;
+        }
+      else
+        {
+        e = s;
+        while( *e && ! VS_FN_STRCHR( delims, *e ) ) e++;
+        }
+      if ( f++ == field ) break;
+      if ( ! *e ) { s = e; break; } // missing field, empty key
+      s = delims ? e + 1 : e;
+      }
+    *len = e - s;
+    return s;
+  }
+
+  struct __vs_sort_keybuf
+  {
+    VS_CHAR* buf;
+    long     used;
+    long     size;
+
+    int room( long n )
+    {
+      if ( used + n <= size ) return 1;
+      long ns = size ? size : 4096;
+      while( ns < used + n ) ns *= 2;
+      VS_CHAR* nb = (VS_CHAR*)realloc( buf, ns * sizeof( VS_CHAR ) );
+      if ( ! nb ) return 0;
+      buf  = nb;
+      size = ns;
+      return 1;
+    }
+  };
+
+  /* natural order key: every digit run becomes <length-of-length><length>
+     <digits> with leading zeros removed, so plain strcmp() of the keys
+     compares numbers by value, zero is single '0'. `d' must have room for
+     3*len+1 chars, returns key length. */
+  int __vs_sort_key_natural( VS_CHAR* d, const VS_CHAR* s, int len )
+  {
+    VS_CHAR* d0 = d;
+    const VS_CHAR* e = s + len;
+    while( s < e )
+      {
+      if ( *s < '0' || *s > '9' )
+        {
+        *d++ = *s++;
+        continue;
+        }
+      while( s < e && *s == '0' ) s++;
+      const VS_CHAR* r = s;
+      while( r < e && *r >= '0' && *r <= '9' ) r++;
+      if ( r == s )
+        {
+        *d++ = '0';
+        continue;
+        }
+      char lb[16];
+      int ll = snprintf( lb, sizeof( lb ), "%d", (int)( r - s ) );
+      *d++ = '0' + ll;
+      for( int z = 0; z < ll; z++ ) *d++ = lb[z];
+      while( s < r ) *d++ = *s++;
+      }
+    *d = 0;
+    return d - d0;
+  }
+
+  struct __vs_sort_num_item
+  {
+    double           v;
+    int              idx;
+    VS_STRING_CLASS* e;
+  };
+
+  struct __vs_sort_num_less
+  {
+    int rev;
+    int operator()( const __vs_sort_num_item& a, const __vs_sort_num_item& b ) const
+    {
+      if ( a.v != b.v ) return rev ? b.v < a.v : a.v < b.v;
+      return a.idx < b.idx;
+    }
+  };
+
+  struct __vs_sort_idx_less
+  {
+    int operator()( const __vs_sort_item& a, const __vs_sort_item& b ) const
+    {
+      return a.idx < b.idx;
+    }
+  };
+
+} // namespace
+
+  void VS_ARRAY_CLASS::sort( int rev, int (*q_strcmp)(const VS_CHAR *, const VS_CHAR *) )
+  {
+    int n = box->_count;
+    if ( n < 2 ) return;
+
+    if ( ! q_strcmp ) q_strcmp = VS_FN_STRCMP;
+
+    if ( q_strcmp == VS_FN_STRCMP )
+      {
+      int z;
+      for( z = 1; z < n; z++ ) // already in order, nothing to do (and no detach)
+        {
+        int r = VS_FN_STRCMP( box->at( z - 1 )->data(), box->at( z )->data() );
+        if ( rev ? r < 0 : r > 0 ) break;
+        }
+      if ( z == n ) return;
+      }
+
+    detach();
+    VS_STRING_CLASS** data = (VS_STRING_CLASS**)malloc( n * sizeof( VS_STRING_CLASS* ) );
+    if ( ! data ) return;
+    box->gather( data );
+
+    int threads = __vs_sort_threads( n );
+    if ( threads < 2 || ! __vs_sort_parallel( data, n, rev, q_strcmp, 0, threads ) )
+      {
+      __vs_sort_item* items = NULL;
+      if ( q_strcmp == VS_FN_STRCMP )
+        items = (__vs_sort_item*)malloc( n * sizeof( __vs_sort_item ) );
+      __vs_sort_range( data, n, rev, q_strcmp, 0, items, NULL );
+      free( items );
+      }
+
+    box->scatter( data );
+    free( data );
+  }
+
+  void VS_ARRAY_CLASS::sort_stable( int rev, int (*q_strcmp)(const VS_CHAR *, const VS_CHAR *) )
+  {
+    int n = box->_count;
+    if ( n < 2 ) return;
+    detach();
+
+    if ( ! q_strcmp ) q_strcmp = VS_FN_STRCMP;
+
+    VS_STRING_CLASS** data = (VS_STRING_CLASS**)malloc( 2 * n * sizeof( VS_STRING_CLASS* ) );
+    if ( ! data ) return;
+    box->gather( data );
+
+    int threads = __vs_sort_threads( n );
+    if ( threads < 2 || ! __vs_sort_parallel( data, n, rev, q_strcmp, 1, threads ) )
+      __vs_sort_range( data, n, rev, q_strcmp, 1, NULL, data + n );
+
+    box->scatter( data );
+    free( data );
+  }
+
+  void VS_ARRAY_CLASS::sort_key( int mode, int rev, int field, const VS_CHAR* delims )
+  {
+    int n = box->_count;
+    if ( n < 2 ) return;
+    detach();
+
+    VS_STRING_CLASS** data = (VS_STRING_CLASS**)malloc( n * sizeof( VS_STRING_CLASS* ) );
+    if ( ! data ) return;
+    box->gather( data );
+    int z;
+
+    if ( mode == VS_SORT_NUMERIC )
+      {
+      __vs_sort_num_item* items = (__vs_sort_num_item*)malloc( n * sizeof( __vs_sort_num_item ) );
+      if ( ! items ) { free( data ); return; }
+      for( z = 0; z < n; z++ )
+        {
+        const VS_CHAR* s = data[z]->data();
+        int len;
+        if ( field >= 0 ) s = __vs_sort_field( s, field, delims, &len );
+        double v = VS_FN_STRTOD( s );
+        items[z].v   = v == v ? v : -HUGE_VAL; // NaN first
+        items[z].idx = z;
+        items[z].e   = data[z];
+        }
+      __vs_sort_num_less less;
+      less.rev = rev;
+      vs_pdq_sort( items, n, less );
+      for( z = 0; z < n; z++ ) data[z] = items[z].e;
+      free( items );
+      box->scatter( data );
+      free( data );
+      return;
+      }
+
+    // text keys are stored back to back in one buffer, items keep offsets
+    // until the buffer stops moving
+    __vs_sort_item* items = (__vs_sort_item*)malloc( n * sizeof( __vs_sort_item ) );
+    __vs_sort_keybuf kb;
+    kb.buf  = NULL;
+    kb.used = 0;
+    kb.size = 0;
+    VS_STRING_CLASS fs;
+    if ( ! items ) { free( data ); return; }
+    for( z = 0; z < n; z++ )
+      {
+      const VS_CHAR* s = data[z]->data();
+      int len = str_len( *data[z] );
+      if ( field >= 0 ) s = __vs_sort_field( s, field, delims, &len );
+
+      int kl = 0;
+      if ( mode == VS_SORT_NATURAL )
+        {
+        if ( ! kb.room( 3 * len + 1 ) ) break;
+        kl = __vs_sort_key_natural( kb.buf + kb.used, s, len );
+        }
+      else if ( mode == VS_SORT_COLLATE )
+        {
+        if ( field >= 0 )
+          {
+          fs.setn( s, len );
+          s = fs.data();
+          }
+        kl = VS_FN_STRXFRM( NULL, s, 0 );
+        if ( ! kb.room( kl + 1 ) ) break;
+        VS_FN_STRXFRM( kb.buf + kb.used, s, kl + 1 );
+        }
+      else
+        {
+        if ( ! kb.room( len + 1 ) ) break;
+        memcpy( kb.buf + kb.used, s, len * sizeof( VS_CHAR ) );
+        kb.buf[kb.used + len] = 0;
+        kl = len;
+        }
+      items[z].key = kb.used;
+      items[z].len = kl;
+      items[z].idx = z;
+      items[z].e   = data[z];
+      kb.used += kl + 1;
+      }
+    if ( z < n )
+      { // out of memory
+      free( items );
+      free( kb.buf );
+      free( data );
+      return;
+      }
+    for( z = 0; z < n; z++ )
+      items[z].s = kb.buf + items[z].key;
+
+    __vs_sort_mkqs( items, n, 0, 0, __vs_sort_budget( n ) );
+
+    // mkqs is not stable, restore original order inside runs of equal keys
+    // (reversed for `rev', the whole array is flipped below)
+    __vs_sort_idx_less less;
+    for( z = 0; z < n; )
+      {
+      int e = z + 1;
+      while( e < n && items[e].len == items[z].len
+                   && memcmp( items[e].s, items[z].s, items[z].len * sizeof( VS_CHAR ) ) == 0 ) e++;
+      if ( e - z > 1 )
+        {
+        vs_pdq_sort( items + z, e - z, less );
+        if ( rev )
+          for( int i = z, j = e - 1; i < j; i++, j-- )
+            vs_sort_swap( items[i], items[j] );
+        }
+      z = e;
+      }
+
+    if ( rev )
+      for( z = 0; z < n; z++ ) data[n - 1 - z] = items[z].e;
+    else
+      for( z = 0; z < n; z++ ) data[z] = items[z].e;
+
+    box->scatter( data );
+    free( data );
+    free( items );
+    free( kb.buf );
+  }
+
+  void VS_ARRAY_CLASS::reverse()
+  {
+    int n = box->_count;
+    if ( n < 2 ) return;
+    detach();
+    box->own( 0, n );
+    for( int z = 0; z < n / 2; z++ )
+      vs_sort_swap( box->slot( z ), box->slot( n - 1 - z ) );
+  }
+
+  void VS_ARRAY_CLASS::shuffle() /* Fisher-Yates shuffle */
+  {
+    int i = box->_count - 1;
+    if ( i < 1 ) return;
+    detach();
+    box->own( 0, box->_count );
+    while( i >= 0 )
+      {
+      int j = rand() % ( i + 1 );
+      vs_sort_swap( box->slot( i ), box->slot( j ) );
+      i--;
+      }
+  }
+
+  void VS_ARRAY_CLASS::print()
+  {
+    int z;
+    for( z = 0; z < count(); z++ )
+      VS_FN_PRINTF( VS_CHAR_L( "%d=" VS_SFMT "\n" ), z, get(z) );
+  }
+
+  int VS_ARRAY_CLASS::max_len()
+  {
+    if ( count() == 0 ) return 0;
+    int l = 0;
+    int z;
+    for( z = 0; z < count(); z++ )
+      {
+      int sl = str_len(get(z));
+      if ( sl > l )
         l = sl;
       }
     return l;
@@ -1541,342 +2867,2165 @@
       if ( sl < l )
         l = sl;
       }
-    return l;
+    return l;
+  }
+
+/***************************************************************************
+**
+** VARRAY BULK
+**
+****************************************************************************/
+
+namespace {
+
+  struct __vs_bulk_job
+  {
+    VS_ARRAY_BOX*     box;
+    int               runs;
+    int  (*pred)( const VS_CHAR* s, int k, void* arg );
+    void (*fn)( VS_STRING_CLASS& s, int k, void* arg );
+    void*             arg;
+    int               compact; // map: compact flag of the destination array
+    char*             hit;  // grep: 1 for matching elements
+    VS_STRING_CLASS** data; // map: new elements
+  };
+
+  // workers only read the source box (no refcounts touched), so shared
+  // arrays are safe to use without detaching
+  void __vs_bulk_grep_run( int k, void* p )
+  {
+    __vs_bulk_job* job = (__vs_bulk_job*)p;
+    int n  = job->box->_count;
+    int r0 = (int)( (long long)n *   k       / job->runs );
+    int r1 = (int)( (long long)n * ( k + 1 ) / job->runs );
+    for( int i = r0; i < r1; i++ )
+      job->hit[i] = job->pred( job->box->at( i )->data(), k, job->arg ) != 0;
+  }
+
+  void __vs_bulk_map_run( int k, void* p )
+  {
+    __vs_bulk_job* job = (__vs_bulk_job*)p;
+    int n  = job->box->_count;
+    int r0 = (int)( (long long)n *   k       / job->runs );
+    int r1 = (int)( (long long)n * ( k + 1 ) / job->runs );
+    for( int i = r0; i < r1; i++ )
+      {
+      const VS_STRING_CLASS* e = job->box->at( i );
+      VS_STRING_CLASS* s = new VS_STRING_CLASS;
+      if( job->compact ) s->compact( job->compact );
+      s->setn( e->data(), str_len( *e ) ); // private copy, sharing is not thread safe
+      job->fn( *s, k, job->arg );
+      job->data[i] = s;
+      }
+  }
+
+  int __vs_bulk_runs( int n )
+  {
+    if ( n < vs_parallel_threshold() ) return 1;
+    int threads = vs_parallel_threads();
+    return threads < n ? threads : n;
+  }
+
+} // namespace
+
+  VS_ARRAY_CLASS VS_ARRAY_CLASS::grep( int (*pred)( const VS_CHAR* s, int k, void* arg ), void* arg )
+  {
+    VS_ARRAY_CLASS arr;
+    grep( arr, pred, arg );
+    return arr;
+  }
+
+  int VS_ARRAY_CLASS::grep( VS_ARRAY_CLASS& dest, int (*pred)( const VS_CHAR* s, int k, void* arg ), void* arg )
+  {
+    int n = box->_count;
+    if ( n < 1 || ! pred ) return 0;
+
+    __vs_bulk_job job;
+    job.box  = box;
+    job.runs = __vs_bulk_runs( n );
+    job.pred = pred;
+    job.fn   = NULL;
+    job.arg  = arg;
+    job.compact = 0;
+    job.hit  = (char*)malloc( n );
+    job.data = NULL;
+    if ( ! job.hit )
+      { // no memory for the marks, do it plainly
+      int found = 0;
+      for( int i = 0; i < n; i++ )
+        if ( pred( box->at( i )->data(), 0, arg ) )
+          {
+          dest.push( *box->at( i ) );
+          found++;
+          }
+      return found;
+      }
+
+    vs_parallel_run( job.runs, __vs_bulk_grep_run, &job );
+
+    int found = 0;
+    int i;
+    for( i = 0; i < n; i++ ) found += job.hit[i];
+    if ( found > 0 )
+      {
+      // result is appended at once, elements are shared (copy-on-write)
+      // strings. `dest' may be this array, source elements are not moved.
+      dest.detach();
+      int z = dest.box->_count;
+      dest.box->open_gap( z, found );
+      for( i = 0; i < n; i++ )
+        if ( job.hit[i] )
+          dest.box->slot( z++ ) = new VS_STRING_CLASS( *box->at( i ) );
+      }
+    free( job.hit );
+    return found;
+  }
+
+  VS_ARRAY_CLASS VS_ARRAY_CLASS::map( void (*fn)( VS_STRING_CLASS& s, int k, void* arg ), void* arg )
+  {
+    VS_ARRAY_CLASS arr;
+    map( arr, fn, arg );
+    return arr;
+  }
+
+  int VS_ARRAY_CLASS::map( VS_ARRAY_CLASS& dest, void (*fn)( VS_STRING_CLASS& s, int k, void* arg ), void* arg )
+  {
+    int n = box->_count;
+    if ( n < 1 || ! fn ) return 0;
+
+    __vs_bulk_job job;
+    job.box  = box;
+    job.runs = __vs_bulk_runs( n );
+    job.pred = NULL;
+    job.fn   = fn;
+    job.arg  = arg;
+    job.hit  = NULL;
+    job.compact = dest.compact;
+    job.data = (VS_STRING_CLASS**)malloc( n * sizeof( VS_STRING_CLASS* ) );
+    if ( ! job.data )
+      { // no memory for the pointers, do it plainly
+      dest.reserve( dest.count() + n );
+      for( int i = 0; i < n; i++ )
+        {
+        VS_STRING_CLASS s = *box->at( i );
+        fn( s, 0, arg );
+        dest.push( s );
+        }
+      return n;
+      }
+
+    vs_parallel_run( job.runs, __vs_bulk_map_run, &job );
+
+    dest.detach();
+    int z = dest.box->_count;
+    dest.box->open_gap( z, n );
+    for( int i = 0; i < n; i++ )
+      dest.box->slot( z + i ) = job.data[i];
+    free( job.data );
+    return n;
+  }
+
+/***************************************************************************
+**
+** VARRAY SET
+**
+****************************************************************************/
+
+namespace {
+
+  // open addressing (linear probing) set of strings. slots keep hash,
+  // length and data pointer, so probes touch string data only on real
+  // match. table starts small and doubles at load factor 1/2, so arrays
+  // with many repeats keep it cache friendly. elements are hashed in
+  // blocks and their slots are prefetched before probing.
+  #define VS_SET_BLOCK  16
+
+  struct __vs_set_slot
+  {
+    unsigned int   hash;
+    unsigned int   mark : 1;
+    unsigned int   len  : 31;
+    const VS_CHAR* s; // NULL for empty slot
+  };
+
+  struct __vs_set
+  {
+    __vs_set_slot* slots;
+    unsigned int   mask;
+    unsigned int   used;
+
+    __vs_set_slot  keys[VS_SET_BLOCK]; // current block
+
+    void init( int count )
+      {
+      unsigned int size = 64;
+      while( size < 2 * (unsigned int)count && size < 4096 ) size *= 2;
+      mask  = size - 1;
+      used  = 0;
+      slots = (__vs_set_slot*)calloc( size, sizeof( __vs_set_slot ) );
+      ASSERT( slots );
+      };
+    void done() { free( slots ); };
+
+    int grow();
+    // hash elements n.. of `box' into keys[], returns block size
+    int block( VS_ARRAY_BOX* box, int n );
+    // find keys[k] or add it if missing, returns its slot, `added' is set for new.
+    // asserts if out of memory, set ops never return partial results
+    __vs_set_slot* get( int k, int* added );
+  };
+
+  unsigned int __vs_set_hash( const VS_CHAR* s, int len )
+  {
+    const unsigned char* p = (const unsigned char*)s;
+    size_t n = len * sizeof( VS_CHAR );
+    unsigned long long h = 0x9E3779B97F4A7C15ULL ^ n;
+    unsigned long long w;
+    while( n >= 8 )
+      {
+      memcpy( &w, p, 8 );
+      h = ( h ^ w ) * 0xFF51AFD7ED558CCDULL;
+      h ^= h >> 32;
+      p += 8;
+      n -= 8;
+      }
+    w = 0;
+    memcpy( &w, p, n );
+    h = ( h ^ w ) * 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 29;
+    return (unsigned int)h;
+  }
+
+  int __vs_set::grow()
+  {
+    unsigned int size = ( mask + 1 ) * 2;
+    __vs_set_slot* ns = (__vs_set_slot*)calloc( size, sizeof( __vs_set_slot ) );
+    if ( ! ns ) return 0;
+    for( unsigned int z = 0; z <= mask; z++ )
+      {
+      if ( ! slots[z].s ) continue;
+      unsigned int i = slots[z].hash & ( size - 1 );
+      while( ns[i].s ) i = ( i + 1 ) & ( size - 1 );
+      ns[i] = slots[z];
+      }
+    free( slots );
+    slots = ns;
+    mask  = size - 1;
+    return 1;
+  }
+
+  int __vs_set::block( VS_ARRAY_BOX* box, int n )
+  {
+    int cnt = box->_count - n < VS_SET_BLOCK ? box->_count - n : VS_SET_BLOCK;
+    for( int k = 0; k < cnt; k++ )
+      {
+      const VS_STRING_CLASS* e = box->at( n + k );
+      keys[k].s    = e->data();
+      keys[k].len  = str_len( *e );
+      keys[k].hash = __vs_set_hash( keys[k].s, keys[k].len );
+      __builtin_prefetch( slots + ( keys[k].hash & mask ) );
+      }
+    return cnt;
+  }
+
+  __vs_set_slot* __vs_set::get( int k, int* added )
+  {
+    const __vs_set_slot* key = keys + k;
+    unsigned int i = key->hash & mask;
+    while( slots[i].s )
+      {
+      __vs_set_slot* p = slots + i;
+      if ( p->hash == key->hash && p->len == key->len &&
+           memcmp( p->s, key->s, key->len * sizeof( VS_CHAR ) ) == 0 )
+        {
+        *added = 0;
+        return p;
+        }
+      i = ( i + 1 ) & mask;
+      }
+    if ( 2 * ( used + 1 ) > mask + 1 && grow() ) return get( k, added );
+    // out of memory keeps filling the table, there must be a free slot left
+    ASSERT( used + 2 <= mask + 1 );
+    used++;
+    slots[i] = *key;
+    slots[i].mark = 0;
+    *added = 1;
+    return slots + i;
+  }
+
+  // add all elements of `box' to the set
+  void __vs_set_add( __vs_set* set, VS_ARRAY_BOX* box )
+  {
+    int added;
+    for( int i = 0; i < box->_count; i += VS_SET_BLOCK )
+      {
+      int cnt = set->block( box, i );
+      for( int k = 0; k < cnt; k++ )
+        set->get( k, &added );
+      }
+  }
+
+  // result array of shared (copy-on-write) strings, sized once
+  void __vs_set_result( VS_ARRAY_BOX* box, const VS_STRING_CLASS** res, int cnt )
+  {
+    if ( cnt < 1 ) return;
+    box->open_gap( 0, cnt );
+    for( int z = 0; z < cnt; z++ )
+      box->slot( z ) = new VS_STRING_CLASS( *res[z] );
+  }
+
+} // namespace
+
+  void VS_ARRAY_CLASS::uniq()
+  {
+    int n = box->_count;
+    if ( n < 2 ) return;
+    __vs_set set;
+    set.init( n );
+
+    // shared array is left alone if there is nothing to remove
+    int added = 1;
+    int i = 0;
+    int k = 0;
+    int cnt = 0;
+    while( i < n && added )
+      {
+      cnt = set.block( box, i );
+      for( k = 0; k < cnt && added; k++ )
+        set.get( k, &added );
+      if ( added ) i += cnt;
+      }
+    if ( added )
+      {
+      set.done();
+      return;
+      }
+    i += k - 1; // first repeated element
+
+    VS_STRING_CLASS** data = (VS_STRING_CLASS**)malloc( n * sizeof( VS_STRING_CLASS* ) );
+    ASSERT( data );
+    detach();
+    box->gather( data );
+    // set entries point to the data of the first `i' elements, which are
+    // kept (and shared with the originals if the array was shared)
+    int z = i;
+    delete data[i++];
+    while( i < n )
+      {
+      cnt = set.block( box, i );
+      for( k = 0; k < cnt; k++ )
+        {
+        set.get( k, &added );
+        if ( added )
+          data[z++] = data[i + k];
+        else
+          delete data[i + k];
+        }
+      i += cnt;
+      }
+    for( i = z; i < n; i++ ) data[i] = NULL;
+    box->scatter( data );
+    box->close_gap( z, n - z );
+    box->shrink();
+    free( data );
+    set.done();
+  }
+
+  VS_ARRAY_CLASS VS_ARRAY_CLASS::intersect( VS_ARRAY_CLASS *arr )
+  {
+    VS_ARRAY_CLASS res;
+    int n = box->_count;
+    int m = arr->box->_count;
+    if ( n < 1 || m < 1 ) return res;
+    __vs_set set;
+    const VS_STRING_CLASS** out = (const VS_STRING_CLASS**)malloc( n * sizeof( VS_STRING_CLASS* ) );
+    ASSERT( out );
+    set.init( m );
+    __vs_set_add( &set, arr->box );
+    int cnt = 0;
+    for( int i = 0; i < n; i += VS_SET_BLOCK )
+      {
+      int bc = set.block( box, i );
+      for( int k = 0; k < bc; k++ )
+        {
+        int added;
+        __vs_set_slot* p = set.get( k, &added );
+        if ( ! added && ! p->mark ) out[cnt++] = box->at( i + k );
+        p->mark = 1; // emitted or not in `arr', skip it from now on
+        }
+      }
+    __vs_set_result( res.box, out, cnt );
+    free( out );
+    set.done();
+    return res;
+  }
+
+  VS_ARRAY_CLASS VS_ARRAY_CLASS::difference( VS_ARRAY_CLASS *arr )
+  {
+    VS_ARRAY_CLASS res;
+    int n = box->_count;
+    if ( n < 1 ) return res;
+    __vs_set set;
+    const VS_STRING_CLASS** out = (const VS_STRING_CLASS**)malloc( n * sizeof( VS_STRING_CLASS* ) );
+    ASSERT( out );
+    set.init( n + arr->box->_count );
+    __vs_set_add( &set, arr->box );
+    int cnt = 0;
+    for( int i = 0; i < n; i += VS_SET_BLOCK )
+      {
+      int bc = set.block( box, i );
+      for( int k = 0; k < bc; k++ )
+        {
+        int added;
+        set.get( k, &added );
+        if ( added ) out[cnt++] = box->at( i + k );
+        }
+      }
+    __vs_set_result( res.box, out, cnt );
+    free( out );
+    set.done();
+    return res;
+  }
+
+  VS_ARRAY_CLASS VS_ARRAY_CLASS::unite( VS_ARRAY_CLASS *arr )
+  {
+    VS_ARRAY_CLASS res;
+    int n = box->_count + arr->box->_count;
+    if ( n < 1 ) return res;
+    __vs_set set;
+    const VS_STRING_CLASS** out = (const VS_STRING_CLASS**)malloc( n * sizeof( VS_STRING_CLASS* ) );
+    ASSERT( out );
+    set.init( n );
+    int cnt = 0;
+    VS_ARRAY_BOX* src[2] = { box, arr->box };
+    for( int b = 0; b < 2; b++ )
+      for( int i = 0; i < src[b]->_count; i += VS_SET_BLOCK )
+        {
+        int bc = set.block( src[b], i );
+        for( int k = 0; k < bc; k++ )
+          {
+          int added;
+          set.get( k, &added );
+          if ( added ) out[cnt++] = src[b]->at( i + k );
+          }
+        }
+    __vs_set_result( res.box, out, cnt );
+    free( out );
+    set.done();
+    return res;
+  }
+
+/***************************************************************************
+**
+** VTRIENODE
+**
+****************************************************************************/
+
+namespace {
+
+  // trie keys are bytes with the terminating 0, so no key is prefix of
+  // another one. narrow keys are used as they are, wide ones are encoded
+  // as UTF-8, extended to 7 bytes (0xFE lead) for chars above 0x7FFFFFFF
+  struct __vs_trie_key
+  {
+    const unsigned char* b;
+    int                  kl;
+    #ifdef _VSTRING_WIDE_
+    unsigned char        sbuf[256];
+    unsigned char*       hbuf;
+    #endif
+
+    __vs_trie_key( const VS_CHAR* key, int with_zero = 1 )
+    {
+      #ifdef _VSTRING_WIDE_
+      hbuf = NULL;
+      size_t sl = str_len( key );
+      unsigned char* d = sbuf;
+      if ( sl * 7 + 1 > sizeof( sbuf ) )
+        {
+        d = hbuf = (unsigned char*)malloc( sl * 7 + 1 );
+        if ( ! d ) { b = sbuf; kl = 0; return; }
+        }
+      b = d;
+      for( ; *key; key++ )
+        {
+        unsigned int c = (unsigned int)*key;
+        int n;
+        if ( c < 0x80 )
+          {
+          *d++ = c;
+          continue;
+          }
+        else if ( c < 0x800      ) { n = 1; *d++ = 0xC0 | ( c >>  6 ); }
+        else if ( c < 0x10000    ) { n = 2; *d++ = 0xE0 | ( c >> 12 ); }
+        else if ( c < 0x200000   ) { n = 3; *d++ = 0xF0 | ( c >> 18 ); }
+        else if ( c < 0x4000000  ) { n = 4; *d++ = 0xF8 | ( c >> 24 ); }
+        else if ( c < 0x80000000 ) { n = 5; *d++ = 0xFC | ( c >> 30 ); }
+        else                       { n = 6; *d++ = 0xFE;                }
+        while( n-- )
+          *d++ = 0x80 | ( ( c >> ( n * 6 ) ) & 0x3F );
+        }
+      *d = 0;
+      kl = d - b + ( with_zero ? 1 : 0 );
+      #else
+      b  = (const unsigned char*)key;
+      kl = strlen( key ) + ( with_zero ? 1 : 0 );
+      #endif
+    }
+
+    #ifdef _VSTRING_WIDE_
+    ~__vs_trie_key() { free( hbuf ); };
+    #endif
+  };
+
+  // key bytes (`kl' with the terminating 0) as VS_CHAR string, `buf' is
+  // used (and grown) for wide keys
+  const VS_CHAR* __vs_trie_key_str( const unsigned char* kb, int kl, VS_CHAR** buf, int* size, int* len )
+  {
+    #ifdef _VSTRING_WIDE_
+    if ( kl > *size )
+      {
+      VS_CHAR* new_buf = (VS_CHAR*)realloc( *buf, kl * sizeof( VS_CHAR ) );
+      if ( ! new_buf ) { *len = 0; return VS_CHAR_L(""); }
+      *buf  = new_buf;
+      *size = kl;
+      }
+    const unsigned char* s = kb;
+    VS_CHAR* d = *buf;
+    while( *s )
+      {
+      unsigned int c = *s++;
+      int n = 0;
+      if      ( c < 0x80 ) n = 0;
+      else if ( c < 0xE0 ) { n = 1; c &= 0x1F; }
+      else if ( c < 0xF0 ) { n = 2; c &= 0x0F; }
+      else if ( c < 0xF8 ) { n = 3; c &= 0x07; }
+      else if ( c < 0xFC ) { n = 4; c &= 0x03; }
+      else if ( c < 0xFE ) { n = 5; c &= 0x01; }
+      else                 { n = 6; c  = 0;    }
+      while( n-- && *s )
+        c = ( c << 6 ) | ( *s++ & 0x3F );
+      *d++ = (VS_CHAR)c;
+      }
+    *d = 0;
+    *len = d - *buf;
+    return *buf;
+    #else
+    (void)buf;
+    (void)size;
+    *len = kl - 1;
+    return (const VS_CHAR*)kb;
+    #endif
+  }
+
+  const VS_CHAR* __vs_trie_node_key( const VS_TRIE_NODE* node, VS_CHAR** buf, int* size, int* len )
+  {
+    return __vs_trie_key_str( node->kb, node->kl, buf, size, len );
+  }
+
+  // node and its key are single block in the trie slabs
+  VS_TRIE_NODE* __vs_trie_new_node( vs_art_slab* slab, const unsigned char* kb, int kl )
+  {
+    void* p = vs_art_alloc( slab, sizeof( VS_TRIE_NODE ) + kl );
+    if ( ! p ) return NULL;
+    VS_TRIE_NODE* node = new( p ) VS_TRIE_NODE();
+    unsigned char* k = (unsigned char*)( node + 1 );
+    memcpy( k, kb, kl );
+    node->refs = 1;
+    node->kl = kl;
+    node->kb = k;
+    return node;
+  }
+
+  struct __vs_trie_free_node
+  {
+    vs_art_slab* slab;
+
+    void operator () ( VS_TRIE_NODE* node )
+    {
+      size_t size = sizeof( VS_TRIE_NODE ) + node->kl;
+      node->~VS_TRIE_NODE();
+      vs_art_free( slab, node, size );
+    }
+  };
+
+  struct __vs_trie_clone_node
+  {
+    vs_art_slab* slab; // of the new trie
+
+    VS_TRIE_NODE* operator () ( const VS_TRIE_NODE* node )
+    {
+      VS_TRIE_NODE* new_node = __vs_trie_new_node( slab, node->kb, node->kl );
+      if ( new_node ) new_node->data = node->data; // shared, copy-on-write
+      return new_node;
+    }
+  };
+
+  // call `fn' for the nodes from `it' on, up to key `to' (excluding) if given
+  int __vs_trie_walk( vs_art_iter<VS_TRIE_NODE>& it, const __vs_trie_key* to, VS_TRIE_CLASS::walk_func fn, void* arg )
+  {
+    VS_CHAR* buf = NULL;
+    int size = 0;
+    int cnt  = 0;
+    for( ; it.leaf; it.next() )
+      {
+      const VS_TRIE_NODE* node = it.leaf;
+      if ( to )
+        {
+        int r = memcmp( node->kb, to->b, (int)node->kl < to->kl ? node->kl : to->kl );
+        if ( r > 0 || ( r == 0 && (int)node->kl >= to->kl ) ) break;
+        }
+      int len;
+      const VS_CHAR* key = __vs_trie_node_key( node, &buf, &size, &len );
+      cnt++;
+      if ( fn( key, node->data.data(), arg ) ) break;
+      }
+    free( buf );
+    return cnt;
+  }
+
+  int __vs_trie_push_key( const VS_CHAR* key, const VS_CHAR*, void* arg )
+  {
+    ((VS_ARRAY_CLASS*)arg)->push( key );
+    return 0;
+  }
+
+} // namespace
+
+/***************************************************************************
+**
+** VTRIEBOX
+**
+****************************************************************************/
+
+  VS_TRIE_BOX* VS_TRIE_BOX::clone()
+  {
+    VS_TRIE_BOX *new_box = new VS_TRIE_BOX();
+    new_box->art.share( art );
+    return new_box;
+  }
+
+  VS_TRIE_BOX* VS_TRIE_BOX::copy()
+  {
+    VS_TRIE_BOX *new_box = new VS_TRIE_BOX();
+    __vs_trie_clone_node cl = { new_box->art.slab };
+    new_box->art.root  = new_box->art.clone( art.root, cl );
+    new_box->art.count = art.count;
+    return new_box;
+  }
+
+  void VS_TRIE_BOX::undef()
+  {
+    __vs_trie_free_node fr = { art.slab };
+    art.clear( fr );
+  }
+
+  VS_TRIE_NODE* VS_TRIE_BOX::find_node( const VS_CHAR* key ) const
+  {
+    if ( ! key || ! key[0] || ! art.root ) return NULL;
+    __vs_trie_key k( key );
+    return art.find( k.b, k.kl );
+  }
+
+  VS_TRIE_NODE* VS_TRIE_BOX::add_node( const VS_CHAR* key )
+  {
+    if ( ! key || ! key[0] ) return NULL;
+    __vs_trie_key k( key );
+    if ( k.kl == 0 ) return NULL;
+    __vs_trie_clone_node cl = { art.slab };
+    VS_TRIE_NODE* node = art.own( k.b, k.kl, cl );
+    if ( node ) return node;
+    node = __vs_trie_new_node( art.slab, k.b, k.kl );
+    if ( ! node ) return NULL;
+    if ( ! art.insert( node ) )
+      {
+      __vs_trie_free_node fr = { art.slab };
+      fr( node );
+      return NULL;
+      }
+    return node;
+  }
+
+  void VS_TRIE_BOX::del_node( const VS_CHAR* key, int branch )
+  {
+    if ( ! key || ! key[0] || ! art.root ) return;
+    __vs_trie_key k( key );
+    __vs_trie_free_node fr = { art.slab };
+    if ( ! branch )
+      {
+      VS_TRIE_NODE* node = art.remove( k.b, k.kl );
+      if ( node && --node->refs == 0 ) fr( node );
+      return;
+      }
+    // collect the branch first, removing changes the nodes below
+    const void* sub = art.seek( k.b, k.kl - 1 );
+    if ( ! sub ) return;
+    VS_TRIE_NODE** nodes = NULL;
+    int cnt = 0;
+    int size = 0;
+    vs_art_iter<VS_TRIE_NODE> it;
+    for( it.start( sub ); it.leaf; it.next() )
+      {
+      if ( cnt == size )
+        {
+        size = size * 2 + 64;
+        VS_TRIE_NODE** new_nodes = (VS_TRIE_NODE**)realloc( nodes, size * sizeof( VS_TRIE_NODE* ) );
+        if ( ! new_nodes ) break;
+        nodes = new_nodes;
+        }
+      nodes[cnt++] = it.leaf;
+      }
+    for( int i = 0; i < cnt; i++ )
+      {
+      VS_TRIE_NODE* node = art.remove( nodes[i]->kb, nodes[i]->kl );
+      if ( node && --node->refs == 0 ) fr( node );
+      }
+    free( nodes );
+  }
+
+  int VS_TRIE_BOX::count_nodes( const VS_CHAR* prefix, int max ) const
+  {
+    if ( ! prefix || ! prefix[0] ) return max > 0 && max < art.count ? max : art.count;
+    __vs_trie_key k( prefix, 0 );
+    int cnt = 0;
+    vs_art_iter<VS_TRIE_NODE> it;
+    for( it.start( art.seek( k.b, k.kl ) ); it.leaf; it.next() )
+      if ( ++cnt == max ) break;
+    return cnt;
+  }
+
+/***************************************************************************
+**
+** VTRIE
+**
+****************************************************************************/
+
+  VS_TRIE_CLASS::VS_TRIE_CLASS()
+  {
+    box = new VS_TRIE_BOX();
+    compact = 1;
+  }
+
+  VS_TRIE_CLASS::VS_TRIE_CLASS( const VS_ARRAY_CLASS& arr )
+  {
+    box = new VS_TRIE_BOX();
+    compact = 1;
+    merge( (VS_ARRAY_CLASS*)&arr );
+  }
+
+  VS_TRIE_CLASS::VS_TRIE_CLASS( const VS_TRIE_CLASS& tr )
+  {
+    box = tr.box;
+    box->ref();
+    compact = 1;
+  }
+
+
+  VS_TRIE_CLASS::~VS_TRIE_CLASS()
+  {
+    box->unref();
+  }
+
+  int VS_TRIE_CLASS::count( const VS_CHAR* key, int max )
+  {
+    return box->count_nodes( key, max );
+  }
+
+  void VS_TRIE_CLASS::detach()
+  {
+    if ( box->refs() == 1 ) return;
+    VS_TRIE_BOX *new_box = box->clone();
+    box->unref();
+    box = new_box;
+  }
+
+  int VS_TRIE_CLASS::vacuum()
+  {
+    // nodes are merged and shrunk on del() already, but their blocks stay
+    // in the slabs for reuse, copy takes only live ones. nodes shared with
+    // other tries are copied too and slabs are released with the last one
+    size_t total = box->refs() == 1 && box->art.slab->refs == 1 ? box->art.slab->total : 0;
+    VS_TRIE_BOX *new_box = box->copy();
+    box->unref();
+    box = new_box;
+    return total > box->art.slab->total ? total - box->art.slab->total : 0;
+  }
+
+  void VS_TRIE_CLASS::print_trace_node( const void *node, int level )
+  {
+    for( int i = 0; i < level*8; i++ ) printf( " " );
+    if ( vs_art_is_leaf( node ) )
+      {
+      VS_TRIE_NODE* leaf = vs_art<VS_TRIE_NODE>::leaf( node );
+      printf( "%p --> leaf key: %d bytes [%.*s] data: %p\n", (void*)leaf, leaf->kl, leaf->kl - 1, leaf->kb, (void*)leaf->data.data() );
+      return;
+      }
+    const vs_art_node* n = (const vs_art_node*)node;
+    static const int types[] = { 0, 4, 16, 48, 256 };
+    printf( "%p --> node%d children: %d prefix: %d [%.*s]\n", (void*)n, types[n->type], n->n, n->pl,
+            n->pl < VS_ART_MAX_PREFIX ? n->pl : VS_ART_MAX_PREFIX, n->prefix );
+    int i = 0;
+    const void* c;
+    while( ( c = vs_art_child_at( n, &i ) ) )
+      {
+      print_trace_node( c, level + 1 );
+      i++;
+      }
+  }
+
+  void VS_TRIE_CLASS::set( const VS_CHAR* key, const VS_CHAR* value )
+  {
+    if ( !value || !key || !key[0] ) return;
+    detach();
+    VS_TRIE_NODE *node = box->add_node( key );
+    ASSERT( node );
+    if ( ! node ) return;
+    if ( compact ) node->data.compact( compact );
+    node->data.set( value );
+  }
+
+  VS_STRING_CLASS& VS_TRIE_CLASS::ref( const VS_CHAR* key )
+  {
+    detach();
+    VS_TRIE_NODE *node = box->add_node( key );
+    ASSERT( node );
+    if ( compact ) node->data.compact( compact );
+    return node->data;
+  }
+
+  const VS_CHAR* VS_TRIE_CLASS::get( const VS_CHAR* key )
+  {
+    VS_TRIE_NODE *node = box->find_node( key );
+    return node ? node->data.data() : NULL;
+  }
+
+  void VS_TRIE_CLASS::del( const VS_CHAR* key, int branch )
+  {
+    if ( !key || !key[0] ) return;
+    detach();
+    box->del_node( key, branch );
+  }
+
+  int VS_TRIE_CLASS::exists( const VS_CHAR* key ) // return != 0 if key exist (with data)
+  {
+    return box->find_node( key ) ? 1 : 0;
+  }
+
+  void VS_TRIE_CLASS::keys_and_values( VS_ARRAY_CLASS *keys, VS_ARRAY_CLASS *values )
+  {
+    VS_CHAR* buf = NULL;
+    int size = 0;
+    int len = 0;
+    vs_art_iter<VS_TRIE_NODE> it;
+    for( it.start( box->art.root ); it.leaf; it.next() )
+      {
+      if ( keys )
+        {
+        const VS_CHAR* key = __vs_trie_node_key( it.leaf, &buf, &size, &len );
+        keys->push( key, len );
+        }
+      if ( values ) values->push( it.leaf->data );
+      }
+    free( buf );
+  }
+
+  VS_ARRAY_CLASS VS_TRIE_CLASS::keys()
+  {
+    VS_ARRAY_CLASS arr;
+    keys_and_values( &arr, NULL );
+    return arr;
+  }
+
+  VS_ARRAY_CLASS VS_TRIE_CLASS::values()
+  {
+    VS_ARRAY_CLASS arr;
+    keys_and_values( NULL, &arr );
+    return arr;
+  }
+
+  void VS_TRIE_CLASS::reverse()
+  {
+    VS_ARRAY_CLASS ka = keys();
+    VS_ARRAY_CLASS va = values();
+    ASSERT( ka.count() == va.count() );
+    undef();
+    int z = ka.count();
+    while( z-- )
+      {
+      set( va.get( z ), ka.get( z ) );
+      }
+  }
+
+  void VS_TRIE_CLASS::merge( VS_TRIE_CLASS *tr )
+  {
+    ASSERT( tr != this );
+    VS_ARRAY_CLASS ka = tr->keys();
+    VS_ARRAY_CLASS va = tr->values();
+    ASSERT( ka.count() == va.count() );
+    int z = ka.count();
+    while( z-- )
+      {
+      set( ka.get( z ), va.get( z ) );
+      }
+  }
+
+  void VS_TRIE_CLASS::merge( VS_ARRAY_CLASS *arr )
+  {
+    int z = 0;
+    while( z < arr->count() )
+      {
+      set( arr->get( z ), arr->get( z + 1 ) );
+      z += 2;
+      }
+  }
+
+  int VS_TRIE_CLASS::fload( const char* fname )
+  {
+    FILE* f = fopen( fname, "rt" );
+    if (!f) return 1;
+    int r = fload( f );
+    fclose(f);
+    return r;
+  }
+
+  int VS_TRIE_CLASS::fsave( const char* fname )
+  {
+    FILE* f = fopen( fname, "wt" );
+    if (!f) return 1;
+    int r = fsave( f );
+    fclose(f);
+    return r;
+  }
+
+  int VS_TRIE_CLASS::fload( FILE* f )
+  {
+    VS_ARRAY_CLASS arr;
+    int r = arr.fload( f );
+    if ( r == 0 )
+      merge( &arr );
+    return r;
+  }
+
+  int VS_TRIE_CLASS::fsave( FILE* f )
+  {
+    // walk leaves directly, same key/value order as keys_and_values()
+    __vs_fsave_buf out;
+    if ( out.open( f ) ) return 2;
+    VS_CHAR* buf = NULL;
+    int size = 0;
+    int len = 0;
+    vs_art_iter<VS_TRIE_NODE> it;
+    for( it.start( box->art.root ); it.leaf && ! out.err; it.next() )
+      {
+      const VS_CHAR* key = __vs_trie_node_key( it.leaf, &buf, &size, &len );
+      out.put( key, len );
+      out.nl();
+      out.put_line( it.leaf->data );
+      }
+    free( buf );
+    return out.close();
+  }
+
+namespace {
+
+  #define VS_TRIE_BIN_MAGIC  "VSTRIE"
+  #define VS_TRIE_MAX_PL     ( 1 << 23 ) // node prefix length limit
+
+  struct __vs_trie_bin_header
+  {
+    __vs_bin_header    h;     // VS_TRIE_BIN_MAGIC, count is keys count
+    unsigned long long blob;  // values size in VS_CHARs
+    unsigned long long nodes; // nodes size in bytes
+  };
+
+  // pre-order image of the radix tree, see VS_TRIE_MAP_CLASS layout
+  struct __vs_trie_image
+  {
+    unsigned char*       buf;
+    size_t               len;
+    size_t               size;
+    int                  err;
+    unsigned int         keys;   // key end nodes written
+    const VS_TRIE_NODE** leaves; // values in keys order
+
+    __vs_trie_image( int count )
+    {
+      buf    = NULL;
+      len    = size = 0;
+      keys   = 0;
+      leaves = (const VS_TRIE_NODE**)malloc( ( count + 1 ) * sizeof( VS_TRIE_NODE* ) );
+      err    = leaves ? 0 : 1;
+    }
+
+    ~__vs_trie_image() { free( buf ); free( leaves ); };
+
+    // offset of `n' new zeroed bytes, next block starts 4-aligned
+    size_t reserve( size_t n )
+    {
+      size_t off  = len;
+      size_t need = ( len + n + 3 ) & ~(size_t)3;
+      if ( need > size )
+        {
+        size_t new_size = need * 2 + 4096;
+        unsigned char* new_buf = (unsigned char*)realloc( buf, new_size );
+        if ( ! new_buf ) { err = 1; return 0; }
+        buf  = new_buf;
+        size = new_size;
+        }
+      memset( buf + len, 0, need - len );
+      len = need;
+      if ( len / 4 > 0xFFFFFFFFULL ) err = 1; // child offsets are 32-bit words
+      return off;
+    }
+
+    void put32( size_t at, unsigned int v ) { memcpy( buf + at, &v, 4 ); };
+
+    // write `n' found at key byte `depth', returns its offset
+    size_t emit( const void* n, unsigned int depth )
+    {
+      if ( vs_art_is_leaf( n ) )
+        {
+        const VS_TRIE_NODE* l = vs_art<VS_TRIE_NODE>::leaf( n );
+        unsigned int sl = l->kl - depth;
+        if ( sl >= VS_TRIE_MAX_PL ) err = 1;
+        size_t off = reserve( 8 + sl );
+        if ( err ) return 0;
+        put32( off,     keys );
+        put32( off + 4, sl << 9 );
+        memcpy( buf + off + 8, l->kb + depth, sl );
+        leaves[keys++] = l;
+        return off;
+        }
+      const vs_art_node* p = (const vs_art_node*)n;
+      const unsigned char* pb = p->prefix;
+      if ( p->pl > VS_ART_MAX_PREFIX ) pb = vs_art<VS_TRIE_NODE>::minimum( p )->kb + depth;
+      if ( p->pl >= VS_TRIE_MAX_PL ) err = 1;
+      size_t off = reserve( 12 + p->pl + p->n );
+      if ( err ) return 0;
+      unsigned int first = keys;
+      put32( off,     first );
+      put32( off + 4, p->pl << 9 | p->n );
+      memcpy( buf + off + 12, pb, p->pl );
+      unsigned char* kp = buf + off + 12 + p->pl;
+      int i = 0;
+      while( vs_art_child_at( p, &i ) )
+        {
+        *kp++ = vs_art_key_at( p, i );
+        i++;
+        }
+      size_t tab = reserve( 4 * p->n );
+      const void* c;
+      int k = 0;
+      i = 0;
+      while( ! err && ( c = vs_art_child_at( p, &i ) ) )
+        {
+        size_t co = emit( c, depth + p->pl + 1 );
+        put32( tab + 4 * k++, co / 4 );
+        i++;
+        }
+      put32( off + 8, keys - first );
+      return off;
+    }
+  };
+
+  int __vs_trie_set_key( const VS_CHAR* key, const VS_CHAR* value, void* arg )
+  {
+    ((VS_TRIE_CLASS*)arg)->set( key, value );
+    return 0;
+  }
+
+} // namespace
+
+  int VS_TRIE_CLASS::bsave( const char* fname )
+  {
+    __vs_trie_image img( box->art.count );
+    if ( box->art.root && ! img.err ) img.emit( box->art.root, 0 );
+    if ( img.err ) return 2;
+
+    FILE* f = fopen( fname, "wb" );
+    if (!f) return 1;
+
+    unsigned int n = img.keys;
+    unsigned int z;
+    __vs_trie_bin_header h;
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.h.magic, VS_TRIE_BIN_MAGIC, sizeof( VS_TRIE_BIN_MAGIC ) );
+    h.h.version   = VS_BIN_VERSION;
+    h.h.order     = VS_BIN_ORDER;
+    h.h.char_size = sizeof( VS_CHAR );
+    h.h.count     = n;
+    for( z = 0; z < n; z++ )
+      h.blob += str_len( img.leaves[z]->data ) + 1;
+    h.nodes = img.len;
+
+    __vs_fsave_buf out;
+    if ( out.open( f ) ) { fclose( f ); return 2; }
+    out.put_raw( &h, sizeof( h ) );
+    unsigned long long off = 0;
+    for( z = 0; z <= n; z++ )
+      {
+      out.put_raw( &off, sizeof( off ) );
+      if ( z < n ) off += str_len( img.leaves[z]->data ) + 1;
+      }
+    for( z = 0; z < n; z++ )
+      {
+      const VS_STRING_CLASS& str = img.leaves[z]->data;
+      out.put_raw( str.data(), ( str_len( str ) + 1 ) * sizeof( VS_CHAR ) );
+      }
+    unsigned long long pad = 0;
+    out.put_raw( &pad, ( 8 - h.blob * sizeof( VS_CHAR ) % 8 ) % 8 ); // nodes are 8-aligned
+    if ( img.len ) out.put_raw( img.buf, img.len );
+    int r = out.close();
+    if ( fclose( f ) && ! r ) r = 2;
+    return r;
+  }
+
+  int VS_TRIE_CLASS::bload( const char* fname )
+  {
+    undef();
+    VS_TRIE_MAP_CLASS map;
+    int r = map.open( fname );
+    if ( r ) return r;
+    map.walk( NULL, __vs_trie_set_key, this );
+    return count() == map.count() ? 0 : 3;
+  }
+
+  int VS_TRIE_CLASS::walk( const VS_CHAR* prefix, walk_func fn, void* arg )
+  {
+    vs_art_iter<VS_TRIE_NODE> it;
+    if ( prefix && prefix[0] )
+      {
+      __vs_trie_key k( prefix, 0 );
+      it.start( box->art.seek( k.b, k.kl ) );
+      }
+    else
+      it.start( box->art.root );
+    return __vs_trie_walk( it, NULL, fn, arg );
+  }
+
+  int VS_TRIE_CLASS::walk_range( const VS_CHAR* from, const VS_CHAR* to, walk_func fn, void* arg )
+  {
+    vs_art_iter<VS_TRIE_NODE> it;
+    if ( from )
+      {
+      __vs_trie_key k( from );
+      it.lower_bound( box->art.root, k.b, k.kl );
+      }
+    else
+      it.start( box->art.root );
+    if ( ! to ) return __vs_trie_walk( it, NULL, fn, arg );
+    __vs_trie_key k( to );
+    return __vs_trie_walk( it, &k, fn, arg );
+  }
+
+  VS_ARRAY_CLASS VS_TRIE_CLASS::keys_with_prefix( const VS_CHAR* prefix )
+  {
+    VS_ARRAY_CLASS arr;
+    walk( prefix, __vs_trie_push_key, &arr );
+    return arr;
+  }
+
+  const VS_CHAR* VS_TRIE_CLASS::longest_prefix( const VS_CHAR* key, int* len )
+  {
+    if ( len ) *len = 0;
+    if ( ! key || ! box->art.root ) return NULL;
+    __vs_trie_key k( key, 0 );
+    VS_TRIE_NODE* node = box->art.longest_prefix( k.b, k.kl );
+    if ( ! node ) return NULL;
+    if ( len )
+      {
+      #ifdef _VSTRING_WIDE_
+      // chars are counted by their lead bytes
+      for( unsigned int i = 0; i + 1 < node->kl; i++ )
+        if ( ( node->kb[i] & 0xC0 ) != 0x80 ) (*len)++;
+      #else
+      *len = node->kl - 1;
+      #endif
+      }
+    return node->data.data();
+  }
+
+  VS_TRIE_CLASS::const_iterator VS_TRIE_CLASS::begin( const VS_CHAR* prefix ) const
+  {
+    if ( ! prefix || ! prefix[0] ) return begin();
+    __vs_trie_key k( prefix, 0 );
+    return const_iterator( box->art.seek( k.b, k.kl ) );
+  }
+
+  void VS_TRIE_CLASS::print()
+  {
+    for( const_iterator it = begin(); it != end(); ++it )
+      VS_FN_PRINTF( VS_CHAR_L( "" VS_SFMT "=" VS_SFMT "\n"), it->key, it->value );
+  }
+
+  void VS_TRIE_CLASS::print_trace()
+  {
+    if ( box->art.root ) print_trace_node( box->art.root, 0 );
+  }
+
+  void VS_TRIE_CLASS::print_stats()
+  {
+    vs_art_stats st;
+    box->art.stats( &st );
+    printf( "keys: %d nodes: %d/%d/%d/%d (4/16/48/256) depth: %.2f avg %d max memory: %lu used %lu total\n",
+            st.nodes[0], st.nodes[VS_ART_NODE4], st.nodes[VS_ART_NODE16], st.nodes[VS_ART_NODE48], st.nodes[VS_ART_NODE256],
+            st.nodes[0] ? (double)st.depth / st.nodes[0] : 0.0, st.max_depth,
+            (unsigned long)st.used, (unsigned long)st.total );
+  }
+
+  VS_TRIE_CLASS::const_iterator::const_iterator()
+  {
+    #ifdef _VSTRING_WIDE_
+    key  = NULL;
+    size = 0;
+    #endif
+    e.key = e.value = NULL;
+  }
+
+  VS_TRIE_CLASS::const_iterator::const_iterator( const void* root )
+  {
+    #ifdef _VSTRING_WIDE_
+    key  = NULL;
+    size = 0;
+    #endif
+    it.start( root );
+    set();
+  }
+
+  VS_TRIE_CLASS::const_iterator::const_iterator( const void* root, const VS_CHAR* key )
+  {
+    #ifdef _VSTRING_WIDE_
+    this->key  = NULL;
+    size = 0;
+    #endif
+    __vs_trie_key k( key ? key : VS_CHAR_L("") );
+    it.lower_bound( root, k.b, k.kl );
+    set();
+  }
+
+  VS_TRIE_CLASS::const_iterator::const_iterator( const const_iterator& a_it )
+  {
+    #ifdef _VSTRING_WIDE_
+    key  = NULL;
+    size = 0;
+    #endif
+    copy( a_it );
+  }
+
+  VS_TRIE_CLASS::const_iterator::~const_iterator()
+  {
+    #ifdef _VSTRING_WIDE_
+    free( key );
+    #endif
+  }
+
+  void VS_TRIE_CLASS::const_iterator::copy( const const_iterator& a_it )
+  {
+    it.copy( a_it.it );
+    set();
+  }
+
+  void VS_TRIE_CLASS::const_iterator::set()
+  {
+    if ( ! it.leaf )
+      {
+      e.key = e.value = NULL;
+      return;
+      }
+    int len;
+    #ifdef _VSTRING_WIDE_
+    e.key = __vs_trie_node_key( it.leaf, &key, &size, &len );
+    #else
+    e.key = __vs_trie_node_key( it.leaf, NULL, NULL, &len );
+    #endif
+    e.value = it.leaf->data.data();
   }
 
 /***************************************************************************
 **
-** VTRIENODE
+** VTRIEMAP
 **
 ****************************************************************************/
 
-  VS_TRIE_NODE::VS_TRIE_NODE()
+namespace {
+
+  // node at `off' in the nodes area, load() returns 0 if it does not fit
+  struct __vs_trie_map_node
+  {
+    unsigned int         first;
+    unsigned int         count;
+    unsigned int         pl;
+    unsigned int         n;
+    const unsigned char* prefix; // keys follow
+    const unsigned int*  child;
+
+    int load( const unsigned char* nodes, unsigned long long size, unsigned long long off )
+    {
+      if ( off + 8 > size ) return 0;
+      const unsigned int* h = (const unsigned int*)( nodes + off );
+      first = h[0];
+      pl    = h[1] >> 9;
+      n     = h[1] & 511;
+      if ( n > 256 ) return 0;
+      unsigned long long hs = n ? 12 : 8;
+      unsigned long long ce = ( off + hs + pl + n + 3 ) & ~3ULL;
+      if ( ce + 4ULL * n > size ) return 0;
+      count  = n ? h[2] : 1;
+      prefix = nodes + off + hs;
+      child  = (const unsigned int*)( nodes + ce );
+      return 1;
+    }
+
+    // offset of child for byte `c', 0 if none (root is never a child)
+    unsigned long long find_child( unsigned char c ) const
+    {
+      const unsigned char* keys = prefix + pl;
+      if ( n <= 16 )
+        {
+        for( unsigned int i = 0; i < n && keys[i] <= c; i++ )
+          if ( keys[i] == c ) return (unsigned long long)child[i] * 4;
+        return 0;
+        }
+      int l = 0;
+      int r = n - 1;
+      while( l <= r )
+        {
+        int m = ( l + r ) / 2;
+        if ( keys[m] == c ) return (unsigned long long)child[m] * 4;
+        if ( keys[m] < c ) l = m + 1; else r = m - 1;
+        }
+      return 0;
+    }
+  };
+
+} // namespace
+
+  VS_TRIE_MAP_CLASS::VS_TRIE_MAP_CLASS()
   {
-    next = NULL;
-    down = NULL;
-    c = 0;
-    data = NULL;
+    _map        = NULL;
+    _map_size   = 0;
+    _count      = 0;
+    _offs       = NULL;
+    _blob       = NULL;
+    _blob_len   = 0;
+    _nodes      = NULL;
+    _nodes_size = 0;
   }
 
-  VS_TRIE_NODE::~VS_TRIE_NODE()
+  VS_TRIE_MAP_CLASS::~VS_TRIE_MAP_CLASS()
   {
-    //printf( "             ~DELETE: %p [%c]  ---> next: %p    down %p    data %p\n", this, c, next, down, data );
-    if ( next ) delete next;
-    if ( down ) delete down;
-    if ( data ) delete data;
+    close();
   }
 
-  VS_TRIE_NODE *VS_TRIE_NODE::clone()
+  int VS_TRIE_MAP_CLASS::open( const char* fname )
   {
-    VS_TRIE_NODE *tmp = new VS_TRIE_NODE();
-    tmp->c = c;
-    if ( next ) tmp->next = next->clone();
-    if ( down ) tmp->down = down->clone();
-    if ( data ) tmp->data = new VS_STRING_CLASS( *data );
-    return tmp;
+    close();
+    int fd = ::open( fname, O_RDONLY );
+    if ( fd < 0 ) return 1;
+    struct stat st;
+    if ( fstat( fd, &st ) || (size_t)st.st_size < sizeof( __vs_trie_bin_header ) + sizeof( unsigned long long ) ||
+         (off_t)(size_t)st.st_size != st.st_size )
+      {
+      ::close( fd );
+      return 3;
+      }
+    size_t size = st.st_size;
+    void* m = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( m == MAP_FAILED ) return 1;
+
+    // header and tables bounds only, nodes and values are checked on access
+    const __vs_trie_bin_header* h = (const __vs_trie_bin_header*)m;
+    unsigned long long cnt   = h->h.count;
+    unsigned long long table = sizeof( __vs_trie_bin_header ) + ( cnt + 1 ) * sizeof( unsigned long long );
+    unsigned long long nodes = ( table + h->blob * sizeof( VS_CHAR ) + 7 ) & ~7ULL;
+    if ( memcmp( h->h.magic, VS_TRIE_BIN_MAGIC, sizeof( VS_TRIE_BIN_MAGIC ) ) || h->h.version != VS_BIN_VERSION ||
+         h->h.order != VS_BIN_ORDER || h->h.char_size != sizeof( VS_CHAR ) ||
+         cnt > 0x7fffffff || h->blob > size || table > size || nodes > size || h->nodes > size - nodes )
+      {
+      munmap( m, size );
+      return 3;
+      }
+    _map        = m;
+    _map_size   = size;
+    _count      = (int)cnt;
+    _offs       = (const unsigned long long*)( (const char*)m + sizeof( __vs_trie_bin_header ) );
+    _blob       = (const VS_CHAR*)( (const char*)m + table );
+    _blob_len   = h->blob;
+    _nodes      = (const unsigned char*)m + nodes;
+    _nodes_size = h->nodes;
+    if ( _offs[_count] > _blob_len )
+      {
+      close();
+      return 3;
+      }
+    return 0;
   }
 
-  void VS_TRIE_NODE::print()
+  void VS_TRIE_MAP_CLASS::close()
   {
-    VS_FN_PRINTF( VS_CHAR_L("---------------------------------\n") );
-    VS_FN_PRINTF( VS_CHAR_L("this = %p\n"), (void*)this );
-    VS_FN_PRINTF( VS_CHAR_L("key  = %c\n"), c );
-    VS_FN_PRINTF( VS_CHAR_L("next = %p\n"), (void*)next );
-    VS_FN_PRINTF( VS_CHAR_L("down = %p\n"), (void*)down );
-    VS_FN_PRINTF( VS_CHAR_L("data = " VS_SFMT "\n"), data ? data->data() : VS_CHAR_L("(null)") );
-    if (next) next->print();
-    if (down) down->print();
+    if ( _map ) munmap( _map, _map_size );
+    _map        = NULL;
+    _map_size   = 0;
+    _count      = 0;
+    _offs       = NULL;
+    _blob       = NULL;
+    _blob_len   = 0;
+    _nodes      = NULL;
+    _nodes_size = 0;
   }
 
-/***************************************************************************
-**
-** VTRIEBOX
-**
-****************************************************************************/
+  const VS_CHAR* VS_TRIE_MAP_CLASS::value( unsigned int n ) const
+  {
+    if ( n >= (unsigned int)_count ) return NULL;
+    unsigned long long b = _offs[n];
+    unsigned long long e = _offs[n + 1];
+    if ( b >= e || e > _blob_len || _blob[e - 1] != 0 ) return NULL; // damaged file
+    return _blob + b;
+  }
 
-  VS_TRIE_BOX* VS_TRIE_BOX::clone()
+  long long VS_TRIE_MAP_CLASS::find( const VS_CHAR* key, int prefix, int* depth ) const
   {
-    VS_TRIE_BOX *new_box = new VS_TRIE_BOX();
-    delete new_box->root;
-    new_box->root   = root->clone();
-    return new_box;
+    if ( ! key || ! _count ) return -1;
+    __vs_trie_key k( key, ! prefix );
+    unsigned long long off = 0;
+    int pos = 0;
+    __vs_trie_map_node nd;
+    while( nd.load( _nodes, _nodes_size, off ) )
+      {
+      if ( depth ) *depth = pos;
+      int m = nd.pl;
+      if ( m > k.kl - pos )
+        {
+        if ( ! prefix ) return -1;
+        m = k.kl - pos;
+        }
+      if ( memcmp( nd.prefix, k.b + pos, m ) ) return -1;
+      pos += m;
+      if ( pos == k.kl ) return prefix || nd.n == 0 ? (long long)off : -1;
+      if ( nd.n == 0 ) return -1;
+      unsigned long long next = nd.find_child( k.b[pos] );
+      if ( next <= off ) return -1; // not found or damaged, children follow parents
+      off = next;
+      pos++;
+      }
+    return -1;
+  }
+
+  int VS_TRIE_MAP_CLASS::count( const VS_CHAR* prefix ) const
+  {
+    if ( ! prefix || ! prefix[0] ) return _count;
+    long long off = find( prefix, 1, NULL );
+    __vs_trie_map_node nd;
+    if ( off < 0 || ! nd.load( _nodes, _nodes_size, off ) ) return 0;
+    return nd.count;
   }
 
-  VS_TRIE_NODE* VS_TRIE_BOX::find_node( VS_TRIE_NODE* node, const VS_CHAR* key, int create )
+  const VS_CHAR* VS_TRIE_MAP_CLASS::get( const VS_CHAR* key ) const
   {
-    if( ! key || ! key[0] ) return NULL;
-    if( key[0] == node->c )
-      { // VS_CHAR in the current key
-      if ( key[1] == 0 )
-        { // last VS_CHAR and is in the key--found!
-        return node;
+    if ( ! key || ! key[0] ) return NULL;
+    long long off = find( key, 0, NULL );
+    __vs_trie_map_node nd;
+    if ( off < 0 || ! nd.load( _nodes, _nodes_size, off ) ) return NULL;
+    return value( nd.first );
+  }
+
+  int VS_TRIE_MAP_CLASS::walk( const VS_CHAR* prefix, VS_TRIE_CLASS::walk_func fn, void* arg ) const
+  {
+    if ( ! prefix ) prefix = VS_CHAR_L("");
+    int depth = 0;
+    long long start = prefix[0] ? find( prefix, 1, &depth ) : _count ? 0 : -1;
+    if ( start < 0 ) return 0;
+
+    // explicit stack of nodes with children left, path holds the key bytes
+    struct frame
+      {
+      unsigned long long off;
+      unsigned int       j;   // next child
+      unsigned int       len; // path length below the node
+      };
+    frame*         stack = NULL;
+    int            sp    = 0;
+    int            ss    = 0;
+    unsigned char* path  = NULL;
+    unsigned int   ps    = 0;
+    VS_CHAR*       buf   = NULL;
+    int            size  = 0;
+    int            cnt   = 0;
+    int            stop  = 0;
+
+    __vs_trie_key k( prefix, 0 );
+    unsigned long long off = start;
+    unsigned int len = depth;
+    __vs_trie_map_node nd;
+    while( ! stop )
+      {
+      if ( ! nd.load( _nodes, _nodes_size, off ) ) break; // damaged
+      if ( len + nd.pl + 2 > ps )
+        {
+        unsigned int new_ps = ( len + nd.pl + 2 ) * 2 + 64;
+        unsigned char* new_path = (unsigned char*)realloc( path, new_ps );
+        if ( ! new_path ) break;
+        if ( ! path ) memcpy( new_path, k.b, depth );
+        path = new_path;
+        ps   = new_ps;
+        }
+      memcpy( path + len, nd.prefix, nd.pl );
+      len += nd.pl;
+      if ( nd.n == 0 )
+        { // key end, the last byte is the terminating 0
+        path[len] = 0;
+        const VS_CHAR* v = value( nd.first );
+        int kl;
+        const VS_CHAR* key = __vs_trie_key_str( path, len, &buf, &size, &kl );
+        if ( ! v ) break;
+        cnt++;
+        if ( fn( key, v, arg ) ) break;
         }
       else
-        { // not last VS_CHAR...
-        if ( ! node->down && create )
-          { // nothing below but should create
-          node->down = new VS_TRIE_NODE();
-          node->down->c = key[1];
+        {
+        if ( sp == ss )
+          {
+          int new_ss = ss * 2 + 32;
+          frame* new_stack = (frame*)realloc( stack, new_ss * sizeof( frame ) );
+          if ( ! new_stack ) break;
+          stack = new_stack;
+          ss    = new_ss;
           }
-        if ( node->down )
-          return find_node( node->down, key + 1, create ); // search below
-        else
-          return NULL; // not found
+        stack[sp].off = off;
+        stack[sp].j   = 0;
+        stack[sp].len = len;
+        sp++;
         }
-      }
-    else
-      { // VS_CHAR not in the current key--try next
-      if ( ! node->next && create )
-        { // no next but should create
-        node->next = new VS_TRIE_NODE();
-        node->next->c = key[0];
+      // next child of the deepest node with children left
+      off = 0;
+      while( sp > 0 )
+        {
+        frame* t = stack + sp - 1;
+        if ( ! nd.load( _nodes, _nodes_size, t->off ) || t->j >= nd.n )
+          {
+          sp--;
+          continue;
+          }
+        path[t->len] = nd.prefix[nd.pl + t->j];
+        off = (unsigned long long)nd.child[t->j] * 4;
+        len = t->len + 1;
+        t->j++;
+        if ( off <= t->off ) stop = 1; // damaged, children follow parents
+        break;
         }
-      if ( node->next )
-        return find_node( node->next, key, create ); // search next
-      else
-        return NULL; // not found
+      if ( ! off ) break;
       }
+    free( stack );
+    free( path );
+    free( buf );
+    return cnt;
   }
 
-  int VS_TRIE_BOX::count_data_nodes( VS_TRIE_NODE* node )
+  VS_ARRAY_CLASS VS_TRIE_MAP_CLASS::keys_with_prefix( const VS_CHAR* prefix ) const
   {
-    if( ! node ) return 0;
-    return ( node->data ? 1 : 0 ) + count_data_nodes( node->next ) + count_data_nodes( node->down );
+    VS_ARRAY_CLASS arr;
+    walk( prefix, __vs_trie_push_key, &arr );
+    return arr;
   }
-/*
-  void VS_TRIE_BOX::del_node( VS_TRIE_NODE* node, const VS_CHAR *key, int branch )
+
+/***************************************************************************
+**
+** VDATRIE
+**
+****************************************************************************/
+
+namespace {
+
+  // grows `*p' to hold at least `need' elements of `esize' bytes
+  int __vs_datrie_reserve( void** p, int* size, long long need, int esize )
   {
-    VS_TRIE_NODE* del_node = find_node( node, key );
-    if( ! del_node ) return;
-    if( del_node->data )
-      {
-      delete del_node->data;
-      del_node->data = NULL;
-      }
-    if( branch && del_node->down )
+    if ( need <= *size ) return 0;
+    long long ns = *size ? *size : 1024;
+    while( ns < need ) ns *= 2;
+    if ( ns > INT_MAX ) ns = INT_MAX;
+    if ( ns < need ) return 1;
+    void* np = realloc( *p, ns * esize );
+    if ( ! np ) return 1;
+    *p    = np;
+    *size = ns;
+    return 0;
+  }
+
+} // namespace
+
+  VS_DATRIE_CLASS::VS_DATRIE_CLASS()
+  {
+    _cells    = NULL;
+    _size     = 0;
+    _cap      = 0;
+    _count    = 0;
+    _tail     = NULL;
+    _tail_len = 0;
+    _blob     = NULL;
+    _blob_len = 0;
+  }
+
+  VS_DATRIE_CLASS::~VS_DATRIE_CLASS()
+  {
+    undef();
+  }
+
+  void VS_DATRIE_CLASS::undef()
+  {
+    free( _cells );
+    free( _tail );
+    free( _blob );
+    _cells    = NULL;
+    _size     = 0;
+    _cap      = 0;
+    _count    = 0;
+    _tail     = NULL;
+    _tail_len = 0;
+    _blob     = NULL;
+    _blob_len = 0;
+  }
+
+  int VS_DATRIE_CLASS::grow( int need )
+  {
+    int cap = _cap;
+    if ( __vs_datrie_reserve( (void**)&_cells, &cap, need, sizeof( cell ) ) ) return 1;
+    for( int i = _cap; i < cap; i++ )
       {
-      delete del_node->down;
-      del_node->down = NULL;
+      _cells[i].base  = 0;
+      _cells[i].check = -1;
       }
+    _cap = cap;
+    return 0;
   }
-*/
-  void VS_TRIE_BOX::del_node( VS_TRIE_NODE* node, const VS_CHAR *key, int branch )
+
+  int VS_DATRIE_CLASS::make( const unsigned char* kb, const int* ko, const int* vo, int n )
   {
-    //printf( "%p --> [%c] data: %p    next: %p    down: %p    <-- key: %s\n", node, node->c, node->data, node->next, node->down, key );
-    if( ! key || ! key[0] ) return;
-    if( key[0] == node->c )
-      { // VS_CHAR in the current key
-      if ( key[1] == 0 )
-        { // last VS_CHAR and is in the key--found!
-        //printf( "FOUND: %p --> [%c] data: %p    next: %p    down: %p    <-- key: %s\n", node, node->c, node->data, node->next, node->down, key );
-        if( node->data )
-          {
-          delete node->data;
-          node->data = NULL;
-          }
-        if( branch && node->down )
-          {
-          //printf( "       DELETE: DOWN: %p [%c] -> %p\n", node, node->c, node->down );
-          delete node->down;
-          node->down = NULL;
-          }
+    struct work { int s; int lo; int hi; int depth; }; // keys lo..hi-1 below cell s
+    work* stack = NULL;
+    int   sp    = 0;
+    int   ss    = 0;
+    int   ts    = 0; // tail allocated
+    int   codes[256];
+    int   starts[257];
+
+    if ( grow( 257 ) ) return 1;
+    _cells[0].check = 0; // root, never free
+    _size = 1;
+    int next = 1; // first free cell
+    if ( __vs_datrie_reserve( (void**)&stack, &ss, 1, sizeof( work ) ) ) return 1;
+    stack[sp].s  = 0;
+    stack[sp].lo = 0;
+    stack[sp].hi = n;
+    stack[sp++].depth = 0;
+
+    while( sp > 0 )
+      {
+      work w = stack[--sp];
+
+      if ( w.hi - w.lo == 1 )
+        {
+        // single key left, value offset and rest of the key go to the tail
+        const unsigned char* k = kb + ko[w.lo] + w.depth;
+        int kl = strlen( (const char*)k ) + 1;
+        if ( __vs_datrie_reserve( (void**)&_tail, &ts, (long long)_tail_len + sizeof( int ) + kl, 1 ) ) { free( stack ); return 1; }
+        memcpy( _tail + _tail_len, vo + w.lo, sizeof( int ) );
+        memcpy( _tail + _tail_len + sizeof( int ), k, kl );
+        _cells[w.s].base = -1 - _tail_len;
+        _tail_len += sizeof( int ) + kl;
+        continue;
         }
-      else
-        { // not last VS_CHAR...
-        if ( node->down )
+
+      // next bytes, equal ones are consecutive as keys are sorted, 0 (key end) is first
+      int cn = 0;
+      for( int i = w.lo; i < w.hi; i++ )
+        {
+        int c = kb[ ko[i] + w.depth ];
+        if ( cn > 0 && codes[cn-1] == c ) continue;
+        codes[cn]    = c;
+        starts[cn++] = i;
+        }
+      starts[cn] = w.hi;
+
+      // first base where all children cells are free, begin >= 1 keeps root out
+      int pos   = next > codes[0] ? next : codes[0] + 1;
+      int from  = pos;
+      int busy  = 0;
+      int begin;
+      while(4)
+        {
+        if ( pos > INT_MAX - 257 || grow( pos + 257 ) ) { free( stack ); return 1; }
+        if ( _cells[pos].check != -1 ) { pos++; busy++; continue; }
+        begin = pos - codes[0];
+        int j = 1;
+        while( j < cn && _cells[ begin + codes[j] ].check == -1 ) j++;
+        if ( j == cn ) break;
+        pos++;
+        }
+      // free cells left behind are too few to fit anything, skip them next time
+      if ( pos - from > 64 && busy * 20 >= ( pos - from ) * 19 ) next = pos;
+
+      if ( __vs_datrie_reserve( (void**)&stack, &ss, (long long)sp + cn, sizeof( work ) ) ) { free( stack ); return 1; }
+      _cells[w.s].base = begin;
+      for( int j = 0; j < cn; j++ )
+        {
+        int t = begin + codes[j];
+        _cells[t].check = w.s;
+        if ( t >= _size ) _size = t + 1;
+        if ( codes[j] == 0 )
           {
-          del_node( node->down, key + 1, branch ); // search below
-          if( ! node->down->data && ! node->down->down )
-            {
-            //printf( "       DELETE: AFTER DOWN: %p [%c] -> %p\n", node, node->c, node->down );
-            VS_TRIE_NODE* tmp = node->down;
-            node->down = node->down->next;
-            tmp->next = NULL;
-            delete tmp;
-            }
+          _cells[t].base = -1 - vo[ starts[j] ];
+          continue;
           }
+        stack[sp].s  = t;
+        stack[sp].lo = starts[j];
+        stack[sp].hi = starts[j+1];
+        stack[sp++].depth = w.depth + 1;
         }
+      while( _cells[next].check != -1 ) next++;
       }
-    else
-      { // VS_CHAR not in the current key--try next
-      if ( node->next )
+    free( stack );
+
+    // cells past the last used one are needed only for base + 255 of the lookups
+    cell* c = (cell*)realloc( _cells, ( _size + 256 ) * sizeof( cell ) );
+    if ( c )
+      {
+      _cells = c;
+      _cap   = _size + 256;
+      }
+    unsigned char* tl = (unsigned char*)realloc( _tail, _tail_len ? _tail_len : 1 );
+    if ( tl ) _tail = tl;
+    return 0;
+  }
+
+  int VS_DATRIE_CLASS::build( const VS_TRIE_CLASS& tr )
+  {
+    undef();
+
+    unsigned char* kb      = NULL; // keys bytes, 0-terminated
+    int            kb_len  = 0;
+    int            kb_size = 0;
+    int*           ko      = NULL; // key offsets in `kb'
+    int*           vo      = NULL; // value offsets in `_blob'
+    int            n       = 0;
+    int            ko_size = 0;
+    int            vo_size = 0;
+    int            bs      = 0;
+    int            err     = 0;
+
+    for( VS_TRIE_CLASS::const_iterator it = tr.begin(); it != tr.end(); ++it )
+      {
+      __vs_trie_key k( it->key );
+      long long vl = str_len( it->value ) + 1;
+      if ( k.kl < 1
+           || __vs_datrie_reserve( (void**)&kb,    &kb_size, (long long)kb_len + k.kl, 1 )
+           || __vs_datrie_reserve( (void**)&ko,    &ko_size, (long long)n + 1, sizeof( int ) )
+           || __vs_datrie_reserve( (void**)&vo,    &vo_size, (long long)n + 1, sizeof( int ) )
+           || __vs_datrie_reserve( (void**)&_blob, &bs,      _blob_len + vl, sizeof( VS_CHAR ) ) )
         {
-        del_node( node->next, key, branch ); // search next
-        if( ! node->next->data && ! node->next->down )
-          {
-          //printf( "       DELETE: NEXT: %p [%c] -> %p\n", node, node->c, node->next );
-          VS_TRIE_NODE* tmp = node->next;
-          node->next = node->next->next;
-          tmp->next = NULL;
-          delete tmp;
-          }
+        err = 1;
+        break;
         }
+      memcpy( kb + kb_len, k.b, k.kl );
+      memcpy( _blob + _blob_len, it->value, vl * sizeof( VS_CHAR ) );
+      ko[n] = kb_len;
+      vo[n] = _blob_len;
+      kb_len    += k.kl;
+      _blob_len += vl;
+      n++;
+      }
+
+    if ( ! err && n > 0 ) err = make( kb, ko, vo, n );
+    free( kb );
+    free( ko );
+    free( vo );
+    if ( err )
+      {
+      undef();
+      return 1;
       }
+    _count = n;
+    return 0;
   }
 
-  int VS_TRIE_BOX::vacuum_node( VS_TRIE_NODE* node )
+  int VS_DATRIE_CLASS::build( const VS_ARRAY_CLASS& arr )
   {
-    int vc = 0; // vacuum count
-    if( node->down ) 
+    VS_TRIE_CLASS tr( arr ); // sorts and drops repeated keys
+    return build( tr );
+  }
+
+  const VS_CHAR* VS_DATRIE_CLASS::get( const VS_CHAR* key ) const
+  {
+    if ( ! _cells || ! key ) return NULL;
+    #ifdef _VSTRING_WIDE_
+    __vs_trie_key k( key );
+    if ( k.kl < 1 ) return NULL;
+    const unsigned char* p = k.b;
+    #else
+    const unsigned char* p = (const unsigned char*)key;
+    #endif
+    int s = 0;
+    while(4)
       {
-      vc += vacuum_node( node->down );
-      if( ! node->down->data && ! node->down->down )
+      int b = _cells[s].base;
+      if ( b < 0 )
         {
-        VS_TRIE_NODE* tmp = node->down;
-        node->down = node->down->next;
-        delete tmp;
-        vc++;
+        const unsigned char* q = _tail + ( -1 - b );
+        int vo;
+        memcpy( &vo, q, sizeof( int ) );
+        for( q += sizeof( int ); *q == *p; q++, p++ )
+          if ( ! *p ) return _blob + vo;
+        return NULL;
         }
+      int c = *p++;
+      int t = b + c;
+      if ( _cells[t].check != s ) return NULL;
+      if ( ! c ) return _blob + ( -1 - _cells[t].base );
+      s = t;
       }
-    
-    if( node->next ) 
+  }
+
+  void VS_DATRIE_CLASS::print_stats() const
+  {
+    int used = 0;
+    for( int i = 0; i < _size; i++ )
+      used += _cells[i].check != -1;
+    printf( "keys: %d cells: %d used %d total (%.1f%%) memory: %lu cells %lu tail %lu values\n",
+            _count, used, _size, _size ? used * 100.0 / _size : 0.0,
+            (unsigned long)_cap * sizeof( cell ), (unsigned long)_tail_len, (unsigned long)_blob_len * sizeof( VS_CHAR ) );
+  }
+
+/***************************************************************************
+**
+** VHASHBOX
+**
+****************************************************************************/
+
+namespace {
+
+  // node and its key are single allocation
+  VS_HASH_NODE* __vs_hash_new_node( const VS_CHAR* key, int kl, unsigned int hash )
+  {
+    void* p = malloc( sizeof( VS_HASH_NODE ) + ( kl + 1 ) * sizeof( VS_CHAR ) );
+    if ( ! p ) return NULL;
+    VS_HASH_NODE* node = new( p ) VS_HASH_NODE();
+    VS_CHAR* k = (VS_CHAR*)( node + 1 );
+    memcpy( k, key, ( kl + 1 ) * sizeof( VS_CHAR ) );
+    node->hash = hash;
+    node->kl   = kl;
+    node->key  = k;
+    return node;
+  }
+
+  void __vs_hash_free_node( VS_HASH_NODE* node )
+  {
+    node->~VS_HASH_NODE();
+    free( node );
+  }
+
+  // bit mask of the group slots which control byte is `c'
+  inline unsigned int __vs_hash_match( const signed char* g, signed char c )
+  {
+    #if defined( __SSE2__ )
+    __m128i v = _mm_loadu_si128( (const __m128i*)g );
+    return _mm_movemask_epi8( _mm_cmpeq_epi8( v, _mm_set1_epi8( c ) ) );
+    #else
+    unsigned int m = 0;
+    for( int i = 0; i < VHASH_GROUP; i++ )
+      if ( g[i] == c ) m |= 1 << i;
+    return m;
+    #endif
+  }
+
+  // bit mask of the group slots which are empty or deleted
+  inline unsigned int __vs_hash_match_free( const signed char* g )
+  {
+    #if defined( __SSE2__ )
+    return _mm_movemask_epi8( _mm_loadu_si128( (const __m128i*)g ) );
+    #else
+    unsigned int m = 0;
+    for( int i = 0; i < VHASH_GROUP; i++ )
+      if ( g[i] < 0 ) m |= 1 << i;
+    return m;
+    #endif
+  }
+
+  inline void __vs_hash_set_ctrl( VS_HASH_BOX* box, int i, signed char c )
+  {
+    box->ctrl[i] = c;
+    if ( i < VHASH_GROUP ) box->ctrl[box->size + i] = c;
+  }
+
+  // groups are probed at triangular steps, which visit all of them since
+  // table size is power of 2. there is always empty slot, so probes stop.
+  int __vs_hash_find( const VS_HASH_BOX* box, const VS_CHAR* key, int kl, unsigned int hash )
+  {
+    if ( ! box->used ) return -1;
+    unsigned int mask = box->size - 1;
+    unsigned int pos  = ( hash >> 7 ) & mask;
+    signed char  h2   = hash & 0x7F;
+    unsigned int step = 0;
+    while(4)
       {
-      vc += vacuum_node( node->next );
-      if( ! node->next->data && ! node->next->down )
+      const signed char* g = box->ctrl + pos;
+      unsigned int m = __vs_hash_match( g, h2 );
+      while( m )
         {
-        VS_TRIE_NODE* tmp = node->next;
-        node->next = node->next->next;
-        delete tmp;
-        vc++;
+        int i = ( pos + __builtin_ctz( m ) ) & mask;
+        const VS_HASH_NODE* node = box->slots[i];
+        if ( node->hash == hash && node->kl == kl && memcmp( node->key, key, kl * sizeof( VS_CHAR ) ) == 0 )
+          return i;
+        m &= m - 1;
         }
+      if ( __vs_hash_match( g, VHASH_CTRL_EMPTY ) ) return -1;
+      step += VHASH_GROUP;
+      pos = ( pos + step ) & mask;
+      }
+  }
+
+  int __vs_hash_free_slot( const VS_HASH_BOX* box, unsigned int hash )
+  {
+    unsigned int mask = box->size - 1;
+    unsigned int pos  = ( hash >> 7 ) & mask;
+    unsigned int step = 0;
+    while(4)
+      {
+      unsigned int m = __vs_hash_match_free( box->ctrl + pos );
+      if ( m ) return ( pos + __builtin_ctz( m ) ) & mask;
+      step += VHASH_GROUP;
+      pos = ( pos + step ) & mask;
       }
-  
-    return vc;
   }
 
-  int VS_TRIE_BOX::vacuum()
+} // namespace
+
+  VS_HASH_BOX* VS_HASH_BOX::clone()
+  {
+    VS_HASH_BOX *new_box = new VS_HASH_BOX();
+    if ( ! size ) return new_box;
+    // out of memory asserts, as set() and ref() do, clone is never partial
+    new_box->resize( size );
+    ASSERT( new_box->slots );
+    // same slots, deleted ones are kept as well since probes pass over them
+    memcpy( new_box->ctrl, ctrl, size + VHASH_GROUP );
+    new_box->left = left;
+    for( int z = 0; z < size; z++ )
+      {
+      if ( ctrl[z] < 0 ) continue;
+      VS_HASH_NODE* node = slots[z];
+      VS_HASH_NODE* new_node = __vs_hash_new_node( node->key, node->kl, node->hash );
+      ASSERT( new_node );
+      new_node->data = node->data; // shared, copy-on-write
+      new_box->slots[z] = new_node;
+      new_box->used++;
+      }
+    return new_box;
+  }
+
+  void VS_HASH_BOX::undef()
   {
-    return vacuum_node( root );
+    for( int z = 0; z < size; z++ )
+      if ( ctrl[z] >= 0 ) __vs_hash_free_node( slots[z] );
+    free( slots );
+    slots = NULL;
+    ctrl  = NULL;
+    size  = used = left = 0;
   }
 
+  int VS_HASH_BOX::resize( int new_size )
+  {
+    if ( new_size < VHASH_GROUP ) new_size = VHASH_GROUP;
+    // slots and control bytes are single allocation
+    VS_HASH_NODE** new_slots = (VS_HASH_NODE**)malloc( new_size * ( sizeof( VS_HASH_NODE* ) + 1 ) + VHASH_GROUP );
+    if ( ! new_slots ) return 0;
+
+    VS_HASH_NODE** old_slots = slots;
+    signed char*   old_ctrl  = ctrl;
+    int            old_size  = size;
 
+    slots = new_slots;
+    ctrl  = (signed char*)( slots + new_size );
+    size  = new_size;
+    memset( ctrl, VHASH_CTRL_EMPTY, new_size + VHASH_GROUP );
+    for( int z = 0; z < old_size; z++ )
+      {
+      if ( old_ctrl[z] < 0 ) continue;
+      int i = __vs_hash_free_slot( this, old_slots[z]->hash );
+      slots[i] = old_slots[z];
+      __vs_hash_set_ctrl( this, i, old_ctrl[z] );
+      }
+    left = new_size - new_size / 8 - used;
+    free( old_slots );
+    return 1;
+  }
+
+  VS_HASH_NODE* VS_HASH_BOX::find_node( const VS_CHAR* key ) const
+  {
+    if ( ! key || ! key[0] || ! used ) return NULL;
+    int kl = str_len( key );
+    int i = __vs_hash_find( this, key, kl, __vs_set_hash( key, kl ) );
+    return i < 0 ? NULL : slots[i];
+  }
+
+  VS_HASH_NODE* VS_HASH_BOX::add_node( const VS_CHAR* key )
+  {
+    if ( ! key || ! key[0] ) return NULL;
+    int kl = str_len( key );
+    unsigned int hash = __vs_set_hash( key, kl );
+    int i = __vs_hash_find( this, key, kl, hash );
+    if ( i >= 0 ) return slots[i];
+    // no free slots left: drop deleted ones if there are many, grow otherwise
+    if ( left <= 0 && ! resize( used < size * 7 / 16 ? size : size * 2 ) ) return NULL;
+    VS_HASH_NODE* node = __vs_hash_new_node( key, kl, hash );
+    if ( ! node ) return NULL;
+    i = __vs_hash_free_slot( this, hash );
+    if ( ctrl[i] == VHASH_CTRL_EMPTY ) left--;
+    slots[i] = node;
+    __vs_hash_set_ctrl( this, i, hash & 0x7F );
+    used++;
+    return node;
+  }
+
+  void VS_HASH_BOX::del_node( const VS_CHAR* key )
+  {
+    if ( ! key || ! key[0] || ! used ) return;
+    int kl = str_len( key );
+    int i = __vs_hash_find( this, key, kl, __vs_set_hash( key, kl ) );
+    if ( i < 0 ) return;
+    __vs_hash_free_node( slots[i] );
+    used--;
+    // slot may be empty again if no probe has ever passed over it, i.e.
+    // there is no full group window around it
+    unsigned int mask = size - 1;
+    unsigned int ea = __vs_hash_match( ctrl + i, VHASH_CTRL_EMPTY );
+    unsigned int eb = __vs_hash_match( ctrl + ( ( i - VHASH_GROUP ) & mask ), VHASH_CTRL_EMPTY );
+    if ( ea && eb && __builtin_ctz( ea ) + __builtin_clz( eb ) - ( 32 - VHASH_GROUP ) < VHASH_GROUP )
+      {
+      __vs_hash_set_ctrl( this, i, VHASH_CTRL_EMPTY );
+      left++;
+      }
+    else
+      __vs_hash_set_ctrl( this, i, VHASH_CTRL_DELETED );
+  }
 
 /***************************************************************************
 **
-** VTRIE
+** VHASH
 **
 ****************************************************************************/
 
-  VS_TRIE_CLASS::VS_TRIE_CLASS()
+  VS_HASH_CLASS::VS_HASH_CLASS()
   {
-    box = new VS_TRIE_BOX();
+    box = new VS_HASH_BOX();
+    compact = 1;
   }
 
-  VS_TRIE_CLASS::VS_TRIE_CLASS( const VS_ARRAY_CLASS& arr )
+  VS_HASH_CLASS::VS_HASH_CLASS( const VS_ARRAY_CLASS& arr )
   {
-    box = new VS_TRIE_BOX();
+    box = new VS_HASH_BOX();
+    compact = 1;
     merge( (VS_ARRAY_CLASS*)&arr );
   }
 
-  VS_TRIE_CLASS::VS_TRIE_CLASS( const VS_TRIE_CLASS& tr )
+  VS_HASH_CLASS::VS_HASH_CLASS( const VS_HASH_CLASS& hs )
   {
-    box = tr.box;
+    box = hs.box;
     box->ref();
+    compact = 1;
   }
 
-
-  VS_TRIE_CLASS::~VS_TRIE_CLASS()
+  VS_HASH_CLASS::~VS_HASH_CLASS()
   {
     box->unref();
   }
 
-  int VS_TRIE_CLASS::count( const VS_CHAR* key ) 
-  { 
-    return box->count_data_nodes( key ? box->find_node( box->root, key ) : box->root ); 
-  }
-
-  void VS_TRIE_CLASS::detach()
+  void VS_HASH_CLASS::detach()
   {
     if ( box->refs() == 1 ) return;
-    VS_TRIE_BOX *new_box = box->clone();
+    VS_HASH_BOX *new_box = box->clone();
     box->unref();
     box = new_box;
   }
 
-  void VS_TRIE_CLASS::trace_node( VS_TRIE_NODE *node, VS_ARRAY_CLASS* keys, VS_ARRAY_CLASS *vals )
+  void VS_HASH_CLASS::reserve( int n )
   {
-    int kl = str_len( temp_key );
-    if ( node->c ) str_add_ch( temp_key, node->c );
-    if ( node->data )
-      {
-      if ( keys ) keys->push( temp_key );
-      if ( vals ) vals->push( node->data->data() );
-      }
-    if ( node->down ) trace_node( node->down, keys, vals );
-    str_sleft( temp_key, kl );
-    if ( node->next ) trace_node( node->next, keys, vals );
+    int size = VHASH_GROUP;
+    while( size - size / 8 < n ) size *= 2;
+    if ( size <= box->size ) return;
+    detach();
+    box->resize( size );
   }
 
-  void VS_TRIE_CLASS::print_trace_node( VS_TRIE_NODE *node, int level )
+  void VS_HASH_CLASS::set( const VS_CHAR* key, const VS_CHAR* value )
   {
-    for( int i = 0; i < level*8; i++ ) printf( " " );
-    printf( "%p --> [%c] data: %p    next: %p    down: %p\n", (void*)node, node->c, (void*)(node->data), (void*)(node->next), (void*)(node->down) );
-    if ( node->down ) print_trace_node( node->down, level + 1 );
-    if ( node->next ) print_trace_node( node->next, level );
+    if ( !value || !key || !key[0] ) return;
+    detach();
+    VS_HASH_NODE *node = box->add_node( key );
+    ASSERT( node );
+    if ( ! node ) return;
+    if ( compact ) node->data.compact( compact );
+    node->data.set( value );
   }
 
-  void VS_TRIE_CLASS::set( const VS_CHAR* key, const VS_CHAR* value )
+  VS_STRING_CLASS& VS_HASH_CLASS::ref( const VS_CHAR* key )
   {
-    if ( !value || !key || !key[0] ) return;
     detach();
-    VS_TRIE_NODE *node = box->find_node( box->root, key, 1 );
+    VS_HASH_NODE *node = box->add_node( key );
     ASSERT( node );
-    if ( ! node->data )
-      node->data = new VS_STRING_CLASS();
-    node->data->set( value );
+    if ( compact ) node->data.compact( compact );
+    return node->data;
   }
 
-  const VS_CHAR* VS_TRIE_CLASS::get( const VS_CHAR* key )
+  const VS_CHAR* VS_HASH_CLASS::get( const VS_CHAR* key )
   {
-    if ( !key || !key[0] ) return NULL;
-    VS_TRIE_NODE *node = box->find_node( box->root, key );
-    if ( node && node->data )
-      return node->data->data();
-    else
-      return NULL;
+    VS_HASH_NODE *node = box->find_node( key );
+    return node ? node->data.data() : NULL;
   }
 
-  void VS_TRIE_CLASS::del( const VS_CHAR* key, int branch )
+  void VS_HASH_CLASS::del( const VS_CHAR* key )
   {
-    if ( !key || !key[0] ) return;
+    if ( ! box->find_node( key ) ) return; // no detach for missing keys
     detach();
-    box->del_node( box->root, key, branch );
+    box->del_node( key );
   }
 
-  int VS_TRIE_CLASS::exists( const VS_CHAR* key ) // return != 0 if key exist (with data)
+  int VS_HASH_CLASS::exists( const VS_CHAR* key ) // return != 0 if key exist (with data)
   {
-    VS_TRIE_NODE *node = box->find_node( box->root, key );
-    if ( node && node->data )
-      return 1;
-    else
-      return 0;
+    return box->find_node( key ) ? 1 : 0;
   }
 
-  void VS_TRIE_CLASS::keys_and_values( VS_ARRAY_CLASS *keys, VS_ARRAY_CLASS *values )
+  void VS_HASH_CLASS::keys_and_values( VS_ARRAY_CLASS *keys, VS_ARRAY_CLASS *values )
   {
-    trace_node( box->root, keys, values );
+    for( int z = 0; z < box->size; z++ )
+      {
+      if ( box->ctrl[z] < 0 ) continue;
+      VS_HASH_NODE* node = box->slots[z];
+      if ( keys   ) keys->push( node->key, node->kl );
+      if ( values ) values->push( node->data );
+      }
   }
 
-  VS_ARRAY_CLASS VS_TRIE_CLASS::keys()
+  VS_ARRAY_CLASS VS_HASH_CLASS::keys()
   {
     VS_ARRAY_CLASS arr;
     keys_and_values( &arr, NULL );
     return arr;
   }
 
-  VS_ARRAY_CLASS VS_TRIE_CLASS::values()
+  VS_ARRAY_CLASS VS_HASH_CLASS::values()
   {
     VS_ARRAY_CLASS arr;
     keys_and_values( NULL, &arr );
     return arr;
   }
 
-  void VS_TRIE_CLASS::reverse()
+  void VS_HASH_CLASS::reverse()
   {
     VS_ARRAY_CLASS ka = keys();
     VS_ARRAY_CLASS va = values();
     ASSERT( ka.count() == va.count() );
     undef();
+    reserve( ka.count() );
     int z = ka.count();
     while( z-- )
       {
@@ -1884,21 +5033,17 @@
       }
   }
 
-  void VS_TRIE_CLASS::merge( VS_TRIE_CLASS *tr )
+  void VS_HASH_CLASS::merge( VS_HASH_CLASS *hs )
   {
-    ASSERT( tr != this );
-    VS_ARRAY_CLASS ka = tr->keys();
-    VS_ARRAY_CLASS va = tr->values();
-    ASSERT( ka.count() == va.count() );
-    int z = ka.count();
-    while( z-- )
-      {
-      set( ka.get( z ), va.get( z ) );
-      }
+    ASSERT( hs != this );
+    reserve( count() + hs->count() );
+    for( const_iterator it = hs->begin(); it != hs->end(); ++it )
+      set( it->key, it->value );
   }
 
-  void VS_TRIE_CLASS::merge( VS_ARRAY_CLASS *arr )
+  void VS_HASH_CLASS::merge( VS_ARRAY_CLASS *arr )
   {
+    reserve( count() + arr->count() / 2 );
     int z = 0;
     while( z < arr->count() )
       {
@@ -1907,7 +5052,7 @@
       }
   }
 
-  int VS_TRIE_CLASS::fload( const char* fname )
+  int VS_HASH_CLASS::fload( const char* fname )
   {
     FILE* f = fopen( fname, "rt" );
     if (!f) return 1;
@@ -1916,7 +5061,7 @@
     return r;
   }
 
-  int VS_TRIE_CLASS::fsave( const char* fname )
+  int VS_HASH_CLASS::fsave( const char* fname )
   {
     FILE* f = fopen( fname, "wt" );
     if (!f) return 1;
@@ -1925,7 +5070,7 @@
     return r;
   }
 
-  int VS_TRIE_CLASS::fload( FILE* f )
+  int VS_HASH_CLASS::fload( FILE* f )
   {
     VS_ARRAY_CLASS arr;
     int r = arr.fload( f );
@@ -1934,27 +5079,25 @@
     return r;
   }
 
-  int VS_TRIE_CLASS::fsave( FILE* f )
-  {
-    VS_ARRAY_CLASS arr;
-    arr.push( this );
-    return arr.fsave( f );
-  }
-
-  void VS_TRIE_CLASS::print()
+  int VS_HASH_CLASS::fsave( FILE* f )
   {
-    VS_ARRAY_CLASS ka = keys();
-    VS_ARRAY_CLASS va = values();
-    ASSERT( ka.count() == va.count() );
-    while( ka.count() && va.count() )
+    __vs_fsave_buf out;
+    if ( out.open( f ) ) return 2;
+    for( int z = 0; z < box->size && ! out.err; z++ )
       {
-      VS_FN_PRINTF( VS_CHAR_L( "" VS_SFMT "=" VS_SFMT "\n"), ka.pop(), va.pop() );
+      if ( box->ctrl[z] < 0 ) continue;
+      VS_HASH_NODE* node = box->slots[z];
+      out.put( node->key, node->kl );
+      out.nl();
+      out.put_line( node->data );
       }
+    return out.close();
   }
 
-  void VS_TRIE_CLASS::print_trace()
+  void VS_HASH_CLASS::print()
   {
-    print_trace_node( box->root, 0 );
+    for( const_iterator it = begin(); it != end(); ++it )
+      VS_FN_PRINTF( VS_CHAR_L( "" VS_SFMT "=" VS_SFMT "\n"), it->key, it->value );
   }
 
 /****************************************************************************
@@ -17,6 +17,8 @@
  # 
  ***************************************************************************/
 
+#include "vart.h"
+
 /***************************************************************************
 **
 ** GLOBALS
@@ -24,6 +26,11 @@
 ****************************************************************************/
 
 #define VARRAY_DEFAULT_BLOCK_SIZE   1024
+#define VARRAY_CHUNK_BITS              7
+#define VARRAY_CHUNK_SIZE           ( 1 << VARRAY_CHUNK_BITS )
+#define VARRAY_CHUNK_MASK           ( VARRAY_CHUNK_SIZE - 1 )
+#define VARRAY_FLOAD_WINDOW         ( 1024*1024 )
+#define VARRAY_FSAVE_BUFFER         ( 256*1024 )
 #define VSTRING_DEFAULT_BLOCK_SIZE   256
 
 /* forward */
@@ -31,9 +38,7 @@ class VS_STRING_CLASS;
 class VS_STRING_CLASS_R;
 class VS_ARRAY_CLASS;
 class VS_TRIE_CLASS;
-
-/* using casual names... */
-#define VHash   VS_TRIE_CLASS
+class VS_HASH_CLASS;
 
 /****************************************************************************
 **
@@ -81,15 +86,47 @@ VS_STRING_CLASS& str_copy ( VS_STRING_CLASS& target, const VS_CHAR* source, int
 VS_STRING_CLASS& str_pad  ( VS_STRING_CLASS& target, int len, VS_CHAR ch = VS_CHAR_L(' ') );
 VS_STRING_CLASS& str_comma( VS_STRING_CLASS& target, VS_CHAR delim = VS_CHAR_L('\'') );
 
+/* returned by non-const VS_STRING_CLASS::operator[], reading does not
+   detach shared string, writing does. off-range reads return 0 and
+   off-range writes are ignored. it cannot bind to VS_CHAR&, use ref() for
+   that: `VS_CHAR& c = str[0].ref()' */
+class VS_CHAR_REF
+{
+  VS_STRING_CLASS* str;
+  int              n;
+
+public:
+
+  VS_CHAR_REF( VS_STRING_CLASS* a_str, int a_n ) { str = a_str; n = a_n; };
+
+  operator VS_CHAR () const;
+  VS_CHAR& ref() const; // writable char, detaches, off-range gives scratch char
+  VS_CHAR* operator & () const { return &ref(); };
+
+  const VS_CHAR_REF& operator = ( VS_CHAR ch );
+  const VS_CHAR_REF& operator = ( const VS_CHAR_REF& r ) { return *this = (VS_CHAR)r; };
+
+  const VS_CHAR_REF& operator += ( int d ) { return *this = (VS_CHAR)( (VS_CHAR)*this + d ); };
+  const VS_CHAR_REF& operator -= ( int d ) { return *this = (VS_CHAR)( (VS_CHAR)*this - d ); };
+  const VS_CHAR_REF& operator ++ ()        { return *this += 1; };
+  const VS_CHAR_REF& operator -- ()        { return *this -= 1; };
+  VS_CHAR operator ++ ( int ) { VS_CHAR ch = *this; *this += 1; return ch; };
+  VS_CHAR operator -- ( int ) { VS_CHAR ch = *this; *this -= 1; return ch; };
+};
+
 class VS_STRING_CLASS
 {
   VS_STRING_BOX* box;
-  VS_CHAR retch; // used to return VS_CHAR& for off-range VS_CHAR index
+  VS_CHAR        retch; // off-range VS_CHAR_REF::ref() target
 
   void detach();
 
+  friend class VS_CHAR_REF;
+
 public:
 
+  class Ref; // VS_STRING_REF, defined below containers
+
   VS_STRING_CLASS( const VS_STRING_CLASS& str )
     {
     box = str.box;
@@ -104,6 +141,9 @@ public:
   VS_STRING_CLASS( const long long n  )  {  box = new VS_STRING_BOX(); ll(n);    };
   VS_STRING_CLASS( const double    n  )  {  box = new VS_STRING_BOX(); f(n);     };
   VS_STRING_CLASS( VS_STRING_CLASS_R  rs  );
+  VS_STRING_CLASS( const Ref& r );
+  template< class R, class C = typename R::Char > // other width VS_STRING_REF
+  VS_STRING_CLASS( const R& r ) { box = new VS_STRING_BOX(); *this = VS_STRING_CLASS( r.str() ); };
   ~VS_STRING_CLASS() { box->unref(); };
 
   void compact( int a_compact ) // set this != 0 for compact (memory preserving) behaviour
@@ -115,6 +155,9 @@ public:
   void resize( int new_size )
         { detach(); box->resize_buf( new_size ); };
 
+  void reserve( int len ) // ensure room for `len' chars, never shrinks
+        { detach(); if ( len >= box->size ) box->resize_buf( len ); };
+
   void undef()
         { box->unref(); box = new VS_STRING_BOX(); };
 
@@ -128,6 +171,9 @@ public:
 
   const VS_STRING_CLASS& operator  = ( const void*     nu  ) { nu = nu; undef(); return *this; };
   const VS_STRING_CLASS& operator  = ( const VS_CHAR*  ps  ) { set(ps); return *this; };
+  const VS_STRING_CLASS& operator  = ( const Ref& r );
+  template< class R, class C = typename R::Char >
+  const VS_STRING_CLASS& operator  = ( const R& r ) { return *this = VS_STRING_CLASS( r.str() ); };
   const VS_STRING_CLASS& operator  = ( const int       n   ) { i(n);    return *this; };
   const VS_STRING_CLASS& operator  = ( const long      n   ) { l(n);    return *this; };
   const VS_STRING_CLASS& operator  = ( const long long n   ) { ll(n);   return *this; };
@@ -135,6 +181,7 @@ public:
 
   const VS_STRING_CLASS& operator += ( const VS_STRING_CLASS& str )  { cat( str.box->s ); return *this; };
   const VS_STRING_CLASS& operator += ( const VS_CHAR*  ps )          { cat( ps ); return *this; };
+  const VS_STRING_CLASS& operator += ( const Ref& r );
   const VS_STRING_CLASS& operator += ( const int       n  )          { VS_STRING_CLASS tmp = n; cat(tmp); return *this; };
   const VS_STRING_CLASS& operator += ( const long      n  )          { VS_STRING_CLASS tmp = n; cat(tmp); return *this; };
   const VS_STRING_CLASS& operator += ( const long long n  )          { VS_STRING_CLASS tmp = n; cat(tmp); return *this; };
@@ -180,16 +227,15 @@ public:
   operator const VS_CHAR* ( ) const { return (const VS_CHAR*)box->s; }
   const VS_CHAR* data() const       { return (const VS_CHAR*)box->s; }
 
-  VS_CHAR& operator [] ( int n )
+  VS_CHAR_REF operator [] ( int n ) // negative `n' counts from the end
       {
       if ( n < 0 ) n = box->sl + n;
-      if ( n < 0 || n >= box->sl )
-        {
-        retch = 0;
-        return retch;
-        }
-      detach();
-      return box->s[n];
+      return VS_CHAR_REF( this, n );
+      }
+  VS_CHAR operator [] ( int n ) const
+      {
+      if ( n < 0 ) n = box->sl + n;
+      return n >= 0 && n < box->sl ? box->s[n] : 0;
       }
 
   void fixlen()
@@ -209,11 +255,11 @@ public:
   void   f( const double d );
   void   fi( const double d ); // sets double as int (w/o frac)
 
-  int    i()  { return VS_FN_STRTOL( box->s ); }
-  long   l()  { return VS_FN_STRTOL( box->s ); }
-  long long ll()  { return VS_FN_STRTOLL( box->s ); }
-  double f()  { return VS_FN_STRTOD( box->s ); }
-  double fi() { return VS_FN_STRTOD( box->s ); }
+  int    i()  const { return VS_FN_STRTOL( box->s ); }
+  long   l()  const { return VS_FN_STRTOL( box->s ); }
+  long long ll()  const { return VS_FN_STRTOLL( box->s ); }
+  double f()  const { return VS_FN_STRTOD( box->s ); }
+  double fi() const { return VS_FN_STRTOD( box->s ); }
 
   void   set(  const VS_CHAR* ps );
   void   cat(  const VS_CHAR* ps );
@@ -231,7 +277,7 @@ public:
   ** VS_STRING_CLASS Friend Functions (for class VS_STRING_CLASS)
   ****************************************************************************/
 
-  inline friend ssize_t str_len( VS_STRING_CLASS& target ) { return target.box->sl; };
+  inline friend ssize_t str_len( const VS_STRING_CLASS& target ) { return target.box->sl; };
   inline friend VS_STRING_CLASS& str_set( VS_STRING_CLASS& target, const VS_CHAR* ps ) { target.set( ps ); return target; };
 
   friend VS_STRING_CLASS& str_mul    ( VS_STRING_CLASS& target, int n                  ); // multiplies the VS_STRING_CLASS n times, i.e. "1"*5 = "11111"
@@ -287,7 +333,7 @@ public:
 
   /* utilities */
 
-  void print(); // print string data to stdout (console)
+  void print() const; // print string data to stdout (console)
 
   /* conversions/reversed char type functions */
   
@@ -304,6 +350,8 @@ public:
 
 }; /* end of VS_STRING_CLASS class */
 
+typedef VS_STRING_CLASS::Ref VS_STRING_REF;
+
 /****************************************************************************
 **
 ** VS_STRING_CLASS Functions (for class VS_STRING_CLASS)
@@ -375,6 +423,12 @@ public:
 
   VS_CHAR* str_squeeze( VS_CHAR* target, const VS_CHAR* sq_VS_CHARs ); // squeeze repeating VS_CHARs to one only
 
+  #ifdef _VSTRING_WIDE_
+  // convert `len' bytes of multi-byte `src' to `dst', which needs room for
+  // `len' chars. invalid sequences become 0xFFFD, returns wide chars count
+  size_t str_mbs_decode( wchar_t* dst, const char* src, size_t len );
+  #endif
+
 /****************************************************************************
 **
 ** VS_STRING_CLASS Functions (for const VS_CHAR*)
@@ -408,12 +462,32 @@ public:
 **
 ****************************************************************************/
 
+class VS_ARRAY_CHUNK : public VRef
+{
+public:
+
+  VS_STRING_CLASS* e[VARRAY_CHUNK_SIZE]; // NULL outside owner's elements range
+
+  VS_ARRAY_CHUNK() { memset( e, 0, sizeof( e ) ); };
+  ~VS_ARRAY_CHUNK();
+
+  VS_ARRAY_CHUNK* clone(); // elements are copied as shared strings
+};
+
+/*
+  elements live in fixed size chunks, which are shared (refcounted)
+  between boxes: cloning a box copies only the chunk directory and a
+  write copies only the chunk it touches. element `n' is at position
+  _head + n, counted from the start of _dir[0], chunk directory has
+  free entries at both ends so push() and unshift() stay O(1).
+*/
 class VS_ARRAY_BOX : public VRef
 {
 public:
 
-  VS_STRING_CLASS** _data;
-  int       _size;
+  VS_ARRAY_CHUNK** _dir;    // chunk directory, unused entries are NULL
+  int       _dir_size;      // allocated directory entries
+  int       _head;          // position of the first element
   int       _count;
 
   int   block_size; // current block size
@@ -421,9 +495,34 @@ public:
   VS_ARRAY_BOX();
   ~VS_ARRAY_BOX();
 
-  VS_ARRAY_BOX* clone();
+  VS_ARRAY_BOX* clone(); // shares all chunks, O(count/VARRAY_CHUNK_SIZE)
+
+  VS_STRING_CLASS* at( int n ) const // read only element, may be shared
+    {
+    int p = _head + n;
+    return _dir[ p >> VARRAY_CHUNK_BITS ]->e[ p & VARRAY_CHUNK_MASK ];
+    };
+  VS_STRING_CLASS*& slot( int n ) // writable element slot, copies shared chunk first
+    {
+    int p = _head + n;
+    VS_ARRAY_CHUNK* c = _dir[ p >> VARRAY_CHUNK_BITS ];
+    if ( ! c || c->refs() > 1 ) c = own_chunk( p >> VARRAY_CHUNK_BITS );
+    return c->e[ p & VARRAY_CHUNK_MASK ];
+    };
 
-  void resize( int new_size );
+  VS_ARRAY_CHUNK* own_chunk( int c ); // make directory entry `c' private
+  void own( int n, int cnt ); // make chunks of elements n..n+cnt-1 private
+
+  void reserve( int min_size ); // ensure capacity, grows geometrically
+  void make_room( int front, int back ); // ensure free directory room before/after elements
+  void open_gap( int n, int cnt ); // insert `cnt' NULL slots at `n', moves the shorter side
+  void close_gap( int n, int cnt ); // delete `cnt' elements at `n', moves the shorter side
+  void append( VS_ARRAY_BOX* src, int from, int cnt ); // copy elements, share whole chunks if aligned
+  void prepend( VS_ARRAY_BOX* src, int from, int cnt );
+  void gather( VS_STRING_CLASS** data ); // own all chunks and copy out element pointers
+  void scatter( VS_STRING_CLASS** data ); // put back (reordered) gathered pointers
+  void release(); // drop chunks left outside elements range
+  void shrink(); // release slack when usage drops well below capacity
   void undef();
   void set_block_size( int new_block_size );
 };
@@ -434,6 +533,14 @@ public:
 **
 ****************************************************************************/
 
+#ifndef VS_SORT_TEXT
+/* key modes for VArray::sort_key(), keys are extracted once per element */
+#define VS_SORT_TEXT     0 // plain strcmp() order of the key
+#define VS_SORT_NUMERIC  1 // leading number value, non-numbers are 0
+#define VS_SORT_NATURAL  2 // digit runs compare by value: "file2" < "file10"
+#define VS_SORT_COLLATE  3 // current LC_COLLATE locale order (strxfrm)
+#endif
+
 class VS_ARRAY_CLASS
 {
   VS_ARRAY_BOX *box;
@@ -444,11 +551,19 @@ class VS_ARRAY_CLASS
         VS_STRING_CLASS   _ret_str;   // return-container
 
   void detach();
-  void q_sort( int lo, int hi, int (*q_strcmp)(const VS_CHAR *, const VS_CHAR *) );
 
   void new_pos( int n );
   void del_pos( int n );
 
+  VS_STRING_CLASS& ref( int n ); // writable element, detaches, extends the array if needed
+  void own_all() { detach(); box->own( 0, box->_count ); }; // all elements writable in place
+  VS_STRING_CLASS* own_at( int n ) // element writable in place, detaches if shared meanwhile
+    { if ( box->refs() > 1 ) detach(); return box->slot( n ); };
+  void push_n( const VS_CHAR* s, int len ); // push `len' chars of `s', array must be detached
+  size_t load_lines( const char* buf, size_t len, int eof ); // push text lines, returns bytes used
+
+  friend class VS_STRING_CLASS::Ref;
+
   public:
 
   int compact;
@@ -458,8 +573,10 @@ class VS_ARRAY_CLASS
   VS_ARRAY_CLASS( const VS_TRIE_CLASS& tr );
   ~VS_ARRAY_CLASS();
 
-  int count() { return box->_count; } // return element count
+  int count() const { return box->_count; } // return element count
   void set_block_size( int new_block_size ) { if ( box ) box->set_block_size( new_block_size ); };
+  void reserve( int new_count ) // preallocate room for `new_count' elements
+    { detach(); box->reserve( new_count ); };
 
   void ins( int n, const VS_CHAR* s ); // insert at position `n'
   void set( int n, const VS_CHAR* s ); // set/replace at position `n'
@@ -470,6 +587,7 @@ class VS_ARRAY_CLASS
       { box->unref(); box = new VS_ARRAY_BOX(); _ret_str = VS_CHAR_L(""); }
 
   int push( const VS_CHAR* s ); // add to the end of the array
+  int push( const VS_CHAR* s, int len ); // add `len' chars of `s' to the end of the array
   int push( VS_TRIE_CLASS *tr     ); // add to the end of the array
   int push( VS_ARRAY_CLASS *arr   ); // add to the end of the array
   const VS_CHAR* pop(); // get and remove the last element
@@ -479,30 +597,59 @@ class VS_ARRAY_CLASS
   int unshift( VS_ARRAY_CLASS *arr   ); // add to the beginning of the array
   const VS_CHAR* shift(); // get and remove the first element
 
+  // chunks are shared with the source arrays where possible, so slices and
+  // concatenations of large arrays copy only O(n/VARRAY_CHUNK_SIZE) entries
+  VS_ARRAY_CLASS slice( int n, int cnt = -1 ); // `cnt' elements at `n', -1 for all to the end
+  void splice( int n, int cnt, VS_ARRAY_CLASS *arr = NULL ); // replace `cnt' elements at `n' with `arr'
+
   void ins( int n, const VS_STRING_CLASS& vs ); // insert at position `n'
   void set( int n, const VS_STRING_CLASS& vs ); // set/replace at position `n'
   int push( const VS_STRING_CLASS& vs ); // add to the end of the array
   int unshift( const VS_STRING_CLASS& vs ); // add to the beginning of the array
 
+  void ins( int n, const VS_STRING_REF& r );
+  void set( int n, const VS_STRING_REF& r );
+  int push( const VS_STRING_REF& r );
+  int unshift( const VS_STRING_REF& r );
+
   void sort( int rev = 0, int (*q_strcmp)(const VS_CHAR *, const VS_CHAR *) = NULL ); // sort (optional reverse order)
+  void sort_stable( int rev = 0, int (*q_strcmp)(const VS_CHAR *, const VS_CHAR *) = NULL ); // sort, keeps order of equal elements
+  void sort_key( int mode, int rev = 0, int field = -1, const VS_CHAR* delims = NULL ); // stable sort on VS_SORT_* keys of whole elements or fields
+  void sort_numeric( int rev = 0 ) { sort_key( VS_SORT_NUMERIC, rev ); };
+  void sort_natural( int rev = 0 ) { sort_key( VS_SORT_NATURAL, rev ); };
+  void sort_collate( int rev = 0 ) { sort_key( VS_SORT_COLLATE, rev ); };
+  void sort_field( int field, const VS_CHAR* delims = NULL, int mode = VS_SORT_TEXT, int rev = 0 ) // 0-based `field', NULL `delims' means blank separated
+    { sort_key( mode, rev, field, delims ); };
   void reverse(); // reverse elements order
   void shuffle(); // randomize element order with Fisher-Yates shuffle
 
-  VS_STRING_CLASS& operator []( int n )
-    {
-      if ( n < 0 ) { _ret_str = VS_CHAR_L(""); return _ret_str; }
-      if ( n >= box->_count )
-        set( n, VS_CHAR_L("") );
-      else
-        detach(); // I don't know if user will change returned VS_STRING_CLASS?!
-      return *box->_data[n];
-    }
+  // bulk operations, order is kept. large arrays (see vs_parallel_threshold())
+  // are split between vs_parallel_threads() workers, so callbacks must be
+  // thread safe. `k' is the worker number (0..threads-1) for per-worker state.
+  // grep() returns elements for which `pred' returns non-zero, map() returns
+  // copies of all elements passed through `fn'. `dest' versions append to
+  // `dest' (which may be reserve()'d up front) and return the appended count.
+  VS_ARRAY_CLASS grep( int (*pred)( const VS_CHAR* s, int k, void* arg ), void* arg = NULL );
+  VS_ARRAY_CLASS map( void (*fn)( VS_STRING_CLASS& s, int k, void* arg ), void* arg = NULL );
+  int grep( VS_ARRAY_CLASS& dest, int (*pred)( const VS_CHAR* s, int k, void* arg ), void* arg = NULL );
+  int map( VS_ARRAY_CLASS& dest, void (*fn)( VS_STRING_CLASS& s, int k, void* arg ), void* arg = NULL );
+
+  // hash based, O(n) expected. results keep the order of first appearance
+  // and hold every distinct element once
+  void uniq(); // remove repeated elements, keeps the first ones
+  VS_ARRAY_CLASS intersect ( VS_ARRAY_CLASS *arr ); // elements found also in `arr'
+  VS_ARRAY_CLASS difference( VS_ARRAY_CLASS *arr ); // elements not found in `arr'
+  VS_ARRAY_CLASS unite     ( VS_ARRAY_CLASS *arr ); // elements of both arrays (set union)
+
+  // reading through the returned reference does not detach shared array,
+  // writes (or taking VS_STRING_CLASS&) detach and extend it if needed
+  VS_STRING_REF operator []( int n );
 
   // FIXME: TODO: verify behaviour!
   const VS_STRING_CLASS& operator []( int n ) const 
     {
       if ( n < 0 || n >= box->_count ) { return _ret_empty; }
-      return *box->_data[n];
+      return *box->at( n );
     }
 
   const VS_ARRAY_CLASS& operator = ( const VS_ARRAY_CLASS& arr )
@@ -533,42 +680,149 @@ class VS_ARRAY_CLASS
   int fload( FILE* f ); // return 0 for ok
   int fsave( FILE* f ); // return 0 for ok
 
+  // binary format: values may hold newlines, VS_ARRAY_MAP_CLASS opens it
+  // without parsing. files are tied to char width and byte order.
+  int bload( const char* fname ); // return 0 for ok, 3 for bad format
+  int bsave( const char* fname ); // return 0 for ok
+
   /* implement `foreach'-like interface */
   void reset() // reset position to beginning
     { _fe = -1; };
   const VS_CHAR* next() // get next item or NULL for the end
-    { _fe++; return _fe < box->_count ? box->_data[_fe]->data() : NULL; };
+    { _fe++; return _fe < box->_count ? box->at( _fe )->data() : NULL; };
   const VS_CHAR* current() // get latest item got from next() -- current one
-    { return _fe < box->_count ? box->_data[_fe]->data() : NULL; };
+    { return _fe < box->_count ? box->at( _fe )->data() : NULL; };
   int current_index() // current index
     { return _fe < box->_count ? _fe : -1; };
 
+  /* random access iterators, for range-for and <algorithm> */
+  template< class T > class iter
+    {
+    const VS_ARRAY_CLASS* arr;
+    int                   n;
+
+    // read only elements never detach, writable ones own their chunk
+    const VS_STRING_CLASS* at( const VS_STRING_CLASS* ) const { return arr->box->at( n ); };
+    VS_STRING_CLASS*       at( VS_STRING_CLASS* ) const       { return ((VS_ARRAY_CLASS*)arr)->own_at( n ); };
+    T* at( ptrdiff_t d ) const { iter it = *this; it.n += d; return it.at( (T*)NULL ); };
+
+    public:
+
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef VS_STRING_CLASS value_type;
+    typedef ptrdiff_t       difference_type;
+    typedef T*              pointer;
+    typedef T&              reference;
+
+    iter() { arr = NULL; n = 0; };
+    iter( const VS_ARRAY_CLASS* a_arr, int a_n ) { arr = a_arr; n = a_n; };
+    template< class U > iter( const iter<U>& it ) { arr = it.array(); n = it.index(); }; // writable to const
+
+    const VS_ARRAY_CLASS* array() const { return arr; };
+    int index() const { return n; };
+
+    T& operator *  () const { return *at( (T*)NULL ); };
+    T* operator -> () const { return  at( (T*)NULL ); };
+    T& operator [] ( difference_type d ) const { return *at( d ); };
+
+    iter& operator ++ () { n++; return *this; };
+    iter& operator -- () { n--; return *this; };
+    iter  operator ++ ( int ) { iter it = *this; n++; return it; };
+    iter  operator -- ( int ) { iter it = *this; n--; return it; };
+    iter& operator += ( difference_type d ) { n += d; return *this; };
+    iter& operator -= ( difference_type d ) { n -= d; return *this; };
+
+    friend iter operator + ( iter it, difference_type d ) { it.n += d; return it; };
+    friend iter operator + ( difference_type d, iter it ) { it.n += d; return it; };
+    friend iter operator - ( iter it, difference_type d ) { it.n -= d; return it; };
+    friend difference_type operator - ( const iter& a, const iter& b ) { return a.n - b.n; };
+
+    friend int operator == ( const iter& a, const iter& b ) { return a.n == b.n; };
+    friend int operator != ( const iter& a, const iter& b ) { return a.n != b.n; };
+    friend int operator <  ( const iter& a, const iter& b ) { return a.n <  b.n; };
+    friend int operator >  ( const iter& a, const iter& b ) { return a.n >  b.n; };
+    friend int operator <= ( const iter& a, const iter& b ) { return a.n <= b.n; };
+    friend int operator >= ( const iter& a, const iter& b ) { return a.n >= b.n; };
+    };
+
+  typedef iter<const VS_STRING_CLASS> const_iterator;
+  typedef iter<VS_STRING_CLASS>       iterator;
+
+  // read only, never detach nor copy, each iterator has its own position so
+  // any number of loops or threads may walk the same array. range-for uses
+  // these for non-const arrays too.
+  const_iterator begin()  const { return const_iterator( this, 0 ); };
+  const_iterator end()    const { return const_iterator( this, box->_count ); };
+  const_iterator cbegin() const { return begin(); };
+  const_iterator cend()   const { return end(); };
+
+  // writable (e.g. for std::sort), detach and own all elements once (in
+  // whichever is called first). an element written after the array is
+  // copied detaches it again, so copies never see the writes. positions
+  // are valid until elements are inserted or removed by other means.
+  // element strings are swapped by sharing and reference counts are not
+  // atomic, so parallel algorithms (std::execution::par) must not copy
+  // nor swap elements, i.e. they may only read or write in place.
+  iterator begin_rw() { own_all(); return iterator( this, 0 ); };
+  iterator end_rw()   { own_all(); return iterator( this, box->_count ); };
+
   int max_len(); // return the length of the longest string in the array
   int min_len(); // return the length of the shortest string in the array
 };
 
 /***************************************************************************
 **
-** VTRIENODE -- INTERNAL!
+** VARRAYMAP
+**
+** read-only view of VS_ARRAY_CLASS::bsave() file. open() maps the file and
+** checks the header only, elements are pointers into the mapping, valid
+** until close(). layout: header, count+1 offsets, 0-terminated strings.
 **
 ****************************************************************************/
 
-class VS_TRIE_NODE
+class VS_ARRAY_MAP_CLASS
 {
-public:
+  void*                     _map;
+  size_t                    _map_size;
+  int                       _count;
+  const unsigned long long* _offs;  // element offsets in the blob, count+1
+  const VS_CHAR*            _blob;
+  unsigned long long        _blob_len;
+
+  VS_ARRAY_MAP_CLASS( const VS_ARRAY_MAP_CLASS& );
+  const VS_ARRAY_MAP_CLASS& operator = ( const VS_ARRAY_MAP_CLASS& );
+
+  public:
 
-  VS_TRIE_NODE();
-  ~VS_TRIE_NODE();
+  VS_ARRAY_MAP_CLASS();
+  ~VS_ARRAY_MAP_CLASS();
+
+  int open( const char* fname ); // return 0 for ok, 1 open error, 3 bad format
+  void close();
+
+  int count() const { return _count; };
+  const VS_CHAR* get( int n ) const; // element at `n', NULL if out of range
+  int len( int n ) const; // element length, -1 if out of range
+
+  const VS_CHAR* operator []( int n ) const
+    { const VS_CHAR* ps = get( n ); return ps ? ps : VS_CHAR_L(""); };
+};
 
-  VS_TRIE_NODE *next;
-  VS_TRIE_NODE *down;
-  VS_CHAR      c;
-  VS_STRING_CLASS   *data;
+/***************************************************************************
+**
+** VTRIENODE -- INTERNAL!
+**
+** key+value leaf of the radix tree. key is kept as bytes with the
+** terminating 0 (stored right after the node), wide keys are encoded as
+** UTF-8 (extended to 32 bits), so byte order is the same as chars order
+**
+****************************************************************************/
 
-  void detach() { next = down = NULL; }
+class VS_TRIE_NODE : public vs_art_leaf
+{
+public:
 
-  VS_TRIE_NODE *clone();
-  void print();
+  VS_STRING_CLASS data;
 };
 
 /***************************************************************************
@@ -581,21 +835,20 @@ class VS_TRIE_BOX : public VRef
 {
 public:
 
-  VS_TRIE_NODE *root;
+  vs_art<VS_TRIE_NODE> art;
 
-  VS_TRIE_BOX()  { root = new VS_TRIE_NODE(); }
-  ~VS_TRIE_BOX() { ASSERT( root ); delete root; }
+  VS_TRIE_BOX()  {};
+  ~VS_TRIE_BOX() { undef(); };
 
-  VS_TRIE_NODE* find_node( VS_TRIE_NODE* node, const VS_CHAR* key, int create = 0 );
-  void del_node( VS_TRIE_NODE* node, const VS_CHAR *key, int branch = 0 );
+  VS_TRIE_NODE* find_node( const VS_CHAR* key ) const;
+  VS_TRIE_NODE* add_node( const VS_CHAR* key ); // find or create
+  void del_node( const VS_CHAR* key, int branch = 0 );
 
-  int count_data_nodes( VS_TRIE_NODE* node );
+  int count_nodes( const VS_CHAR* prefix, int max = 0 ) const; // keys starting with `prefix', up to `max' if given
 
-  VS_TRIE_BOX* clone();
-  void undef() { ASSERT( root ); delete root; root = new VS_TRIE_NODE(); };
-
-  int vacuum_node( VS_TRIE_NODE* node );
-  int vacuum();
+  VS_TRIE_BOX* clone(); // shares all nodes, O(1), writes copy their path
+  VS_TRIE_BOX* copy();  // own nodes in new slabs
+  void undef();
 };
 
 /***************************************************************************
@@ -609,23 +862,26 @@ class VS_TRIE_CLASS
   VS_TRIE_BOX *box;
 
   void detach();
-  void trace_node( VS_TRIE_NODE *node, VS_ARRAY_CLASS* keys, VS_ARRAY_CLASS *vals );
-  void print_trace_node( VS_TRIE_NODE *node, int level );
+  void print_trace_node( const void *node, int level );
+
+  const VS_STRING_CLASS _ret_empty; // return-empty-container
 
-  VS_STRING_CLASS temp_key;
+  VS_STRING_CLASS& ref( const VS_CHAR* key ); // writable data, detaches, creates the key if needed
+
+  friend class VS_STRING_CLASS::Ref;
 
   public:
 
-  int compact;
+  int compact; // values are compact strings (default), see VS_STRING_CLASS::compact()
 
   VS_TRIE_CLASS();
   VS_TRIE_CLASS( const VS_ARRAY_CLASS& arr );
   VS_TRIE_CLASS( const VS_TRIE_CLASS& tr );
   ~VS_TRIE_CLASS();
 
-  int vacuum() { return box->vacuum(); };
+  int vacuum(); // repack nodes into new slabs, returns released bytes
 
-  int count( const VS_CHAR* key = NULL );
+  int count( const VS_CHAR* key = NULL, int max = 0 ); // keys count, only ones starting with `key' if given, stops at `max' if given
 
   void set( const VS_CHAR* key, const VS_CHAR* data ); // set data, same as []=
   void del( const VS_CHAR* key, int branch = 0      ); // remove data associated with `key' or all data below this branch
@@ -641,6 +897,20 @@ class VS_TRIE_CLASS
   VS_ARRAY_CLASS keys();   // returns VS_ARRAY_CLASS with keys currently used
   VS_ARRAY_CLASS values(); // returns VS_ARRAY_CLASS with keys' values
 
+  // ordered walks over part of the trie, only nodes below `prefix' (or
+  // from `from' on) are visited. callback must not change the trie and
+  // returns != 0 to stop, walks return the count of the calls
+  typedef int (*walk_func)( const VS_CHAR* key, const VS_CHAR* value, void* arg );
+
+  int walk( const VS_CHAR* prefix, walk_func fn, void* arg = NULL ); // keys starting with `prefix'
+  int walk_range( const VS_CHAR* from, const VS_CHAR* to, walk_func fn, void* arg = NULL ); // keys >= `from' and < `to', NULL for no limit
+
+  VS_ARRAY_CLASS keys_with_prefix( const VS_CHAR* prefix ); // sorted
+
+  // value of the longest key which is prefix of `key' (or the same one),
+  // NULL if none, `len' gets the matched key length
+  const VS_CHAR* longest_prefix( const VS_CHAR* key, int* len = NULL );
+
   void reverse(); // reverse keys <-> values
 
   void merge( VS_TRIE_CLASS  *tr  ); // adds keys+values (or modify existing keys)
@@ -649,20 +919,25 @@ class VS_TRIE_CLASS
   //void print_nodes() { print_node( root ); }; // for debug only
   void print(); // print trie data to stdout (console)
   void print_trace(); // print trie data structure details
+  void print_stats(); // print nodes count, lookup depth and memory used
 
   int fload( const char* fname ); // return 0 for ok
   int fsave( const char* fname ); // return 0 for ok
   int fload( FILE* f ); // return 0 for ok
   int fsave( FILE* f ); // return 0 for ok
 
-  VS_STRING_CLASS& operator []( const VS_CHAR* key )
+  // compiled binary image, VS_TRIE_MAP_CLASS serves it without loading
+  int bload( const char* fname ); // return 0 for ok, 3 for bad format
+  int bsave( const char* fname ); // return 0 for ok
+
+  // as VS_ARRAY_CLASS: reading does not detach shared trie (nor creates
+  // missing keys), writes do
+  VS_STRING_REF operator []( const VS_CHAR* key );
+
+  const VS_STRING_CLASS& operator []( const VS_CHAR* key ) const
     {
-    detach(); // I don't know if user will change returned VS_STRING_CLASS?!
-    VS_TRIE_NODE *node = box->find_node( box->root, key, 1 );
-    ASSERT( node );
-    if ( ! node->data )
-      node->data = new VS_STRING_CLASS();
-    return *(node->data);
+    VS_TRIE_NODE *node = box->find_node( key );
+    return node ? node->data : _ret_empty;
     }
 
   const VS_TRIE_CLASS& operator = ( const VS_TRIE_CLASS& tr )
@@ -679,8 +954,576 @@ class VS_TRIE_CLASS
     { merge( (VS_ARRAY_CLASS*)&arr ); return *this; };
   const VS_TRIE_CLASS& operator += ( const VS_TRIE_CLASS& tr )
     { merge( (VS_TRIE_CLASS*)&tr ); return *this; };
+
+  /* forward iterators over key+value pairs, same order as keys_and_values() */
+  struct entry
+    {
+    const VS_CHAR* key;   // valid until the iterator moves
+    const VS_CHAR* value;
+    };
+
+  class const_iterator
+    {
+    vs_art_iter<VS_TRIE_NODE> it;
+    #ifdef _VSTRING_WIDE_
+    VS_CHAR*       key;   // decoded key of the current node
+    int            size;
+    #endif
+    entry          e;
+
+    void set();  // fill `e' from current node
+    void copy( const const_iterator& a_it );
+
+    public:
+
+    typedef std::forward_iterator_tag iterator_category;
+    typedef entry           value_type;
+    typedef ptrdiff_t       difference_type;
+    typedef const entry*    pointer;
+    typedef const entry&    reference;
+
+    const_iterator();
+    const_iterator( const void* root );
+    const_iterator( const void* root, const VS_CHAR* key ); // from the first key not less than `key'
+    const_iterator( const const_iterator& a_it );
+    ~const_iterator();
+
+    const const_iterator& operator = ( const const_iterator& a_it )
+      { if ( this != &a_it ) copy( a_it ); return *this; };
+
+    const entry& operator *  () const { return  e; };
+    const entry* operator -> () const { return &e; };
+
+    const_iterator& operator ++ () { it.next(); set(); return *this; };
+    const_iterator  operator ++ ( int ) { const_iterator r = *this; it.next(); set(); return r; };
+
+    friend int operator == ( const const_iterator& a, const const_iterator& b )
+      { return a.it.leaf == b.it.leaf; };
+    friend int operator != ( const const_iterator& a, const const_iterator& b )
+      { return ! ( a == b ); };
+    };
+
+  // never detach nor copy values, each iterator keeps its own path, so
+  // any number of loops or threads may walk the same trie
+  const_iterator begin()  const { return const_iterator( box->art.root ); };
+  const_iterator end()    const { return const_iterator(); };
+  const_iterator cbegin() const { return begin(); };
+  const_iterator cend()   const { return end(); };
+
+  const_iterator begin( const VS_CHAR* prefix ) const; // only keys starting with `prefix'
+  const_iterator lower_bound( const VS_CHAR* key ) const // from the first key not less than `key' to the end
+    { return const_iterator( box->art.root, key ); };
+};
+
+/***************************************************************************
+**
+** VTRIEMAP
+**
+** read-only view of VS_TRIE_CLASS::bsave() file. open() maps the file and
+** checks the header only, nodes are checked on access and nothing is
+** allocated per key. results are pointers into the mapping, valid until
+** close(). layout: header, count+1 value offsets, 0-terminated values,
+** radix tree nodes in pre-order (subtree of a node is contiguous and its
+** keys are consecutive in sorted order):
+**
+**   u32 first;          // index of the first key below, keys are sorted
+**   u32 pl << 9 | n;    // prefix length and children count, 0 for key end
+**   u32 count;          // keys below, only if n > 0
+**   u8  prefix[pl];     // full, key end nodes hold the rest of the key
+**   u8  keys[n];        // sorted, 0 for key ending here
+**   u32 child[n];       // 4-aligned, offsets in 4 byte words
+**
+****************************************************************************/
+
+class VS_TRIE_MAP_CLASS
+{
+  void*                     _map;
+  size_t                    _map_size;
+  int                       _count;
+  const unsigned long long* _offs;  // value offsets in the blob, count+1
+  const VS_CHAR*            _blob;
+  unsigned long long        _blob_len;
+  const unsigned char*      _nodes;
+  unsigned long long        _nodes_size;
+
+  VS_TRIE_MAP_CLASS( const VS_TRIE_MAP_CLASS& );
+  const VS_TRIE_MAP_CLASS& operator = ( const VS_TRIE_MAP_CLASS& );
+
+  long long find( const VS_CHAR* key, int prefix, int* depth ) const; // node offset, -1 if not found
+  const VS_CHAR* value( unsigned int n ) const; // NULL for damaged file
+
+  public:
+
+  VS_TRIE_MAP_CLASS();
+  ~VS_TRIE_MAP_CLASS();
+
+  int open( const char* fname ); // return 0 for ok, 1 open error, 3 bad format
+  void close();
+
+  int count( const VS_CHAR* prefix = NULL ) const; // keys count, only ones starting with `prefix' if given
+  const VS_CHAR* get( const VS_CHAR* key ) const; // value, NULL if not found
+  int exists( const VS_CHAR* key ) const { return get( key ) != NULL; };
+
+  // same as VS_TRIE_CLASS ones, keys in sorted order
+  int walk( const VS_CHAR* prefix, VS_TRIE_CLASS::walk_func fn, void* arg = NULL ) const;
+  VS_ARRAY_CLASS keys_with_prefix( const VS_CHAR* prefix ) const;
+
+  const VS_CHAR* operator []( const VS_CHAR* key ) const
+    { const VS_CHAR* ps = get( key ); return ps ? ps : VS_CHAR_L(""); };
 };
 
+/***************************************************************************
+**
+** VDATRIE
+**
+** double-array trie, read-only copy of VS_TRIE_CLASS for lookups only.
+** built from sorted keys in one pass, then each key byte (chars are UTF-8
+** encoded for the wide one) costs single step: cell `t = base[s] + byte'
+** is child of `s' if `check[t] == s'. key end is byte 0, its cell holds
+** the value offset in the values blob. once a branch has single key left,
+** the rest of it is kept in the tail buffer and compared at once, so long
+** unique key ends take no cells. no node layout nor pointers to follow.
+**
+****************************************************************************/
+
+class VS_DATRIE_CLASS
+{
+  struct cell
+    {
+    int base;  // children offset, < 0 for leaves: -1 - value offset for
+               // key end (byte 0) cells, -1 - tail offset for the others
+    int check; // parent cell, -1 for free
+    };
+
+  cell*          _cells;
+  int            _size;  // cells up to the last used one
+  int            _cap;   // allocated, at least 256 past `_size' so lookups need no bounds checks
+  int            _count;
+  unsigned char* _tail;  // int value offset + rest of the key with its 0 for each single key branch
+  int            _tail_len;
+  VS_CHAR*       _blob;  // 0-terminated values
+  int            _blob_len;
+
+  VS_DATRIE_CLASS( const VS_DATRIE_CLASS& );
+  const VS_DATRIE_CLASS& operator = ( const VS_DATRIE_CLASS& );
+
+  int grow( int need ); // new cells are free
+  int make( const unsigned char* kb, const int* ko, const int* vo, int n ); // sorted keys at `kb + ko[i]'
+
+  public:
+
+  VS_DATRIE_CLASS();
+  ~VS_DATRIE_CLASS();
+
+  int build( const VS_TRIE_CLASS& tr );   // return 0 for ok, 1 for no memory or too large
+  int build( const VS_ARRAY_CLASS& arr ); // key+value pairs, same as VS_TRIE_CLASS( arr )
+  void undef();
+
+  int count() const { return _count; };
+  const VS_CHAR* get( const VS_CHAR* key ) const; // value, NULL if not found
+  int exists( const VS_CHAR* key ) const { return get( key ) != NULL; };
+
+  void print_stats() const; // print keys, cells and memory used
+
+  const VS_CHAR* operator []( const VS_CHAR* key ) const
+    { const VS_CHAR* ps = get( key ); return ps ? ps : VS_CHAR_L(""); };
+};
+
+/***************************************************************************
+**
+** VHASHNODE -- INTERNAL!
+**
+****************************************************************************/
+
+class VS_HASH_NODE
+{
+public:
+
+  unsigned int    hash; // cached, table grows without hashing keys again
+  int             kl;   // key length
+  const VS_CHAR*  key;  // stored right after the node
+  VS_STRING_CLASS data;
+};
+
+/***************************************************************************
+**
+** VHASHBOX -- INTERNAL!
+**
+** open addressing (Swiss table) over groups of VHASH_GROUP slots. each
+** slot has control byte: empty, deleted or low 7 bits of the key hash,
+** so whole group is matched at once and keys are compared only when
+** control byte matches.
+**
+****************************************************************************/
+
+#define VHASH_GROUP          16
+#define VHASH_CTRL_EMPTY   (-128)
+#define VHASH_CTRL_DELETED   (-2)
+
+class VS_HASH_BOX : public VRef
+{
+public:
+
+  VS_HASH_NODE** slots;
+  signed char*   ctrl;  // `size' + VHASH_GROUP bytes, first group is mirrored at the end
+  int            size;  // slots count, power of 2, 0 for empty table
+  int            used;  // keys count
+  int            left;  // free slots before next resize (keeps load under 7/8)
+
+  VS_HASH_BOX()  { slots = NULL; ctrl = NULL; size = used = left = 0; };
+  ~VS_HASH_BOX() { undef(); };
+
+  VS_HASH_NODE* find_node( const VS_CHAR* key ) const;
+  VS_HASH_NODE* add_node( const VS_CHAR* key ); // find or create
+  void del_node( const VS_CHAR* key );
+
+  int resize( int new_size ); // rehash into `new_size' slots, returns 0 if out of memory
+
+  VS_HASH_BOX* clone();
+  void undef();
+};
+
+/***************************************************************************
+**
+** VHASH
+**
+** same interface as VS_TRIE_CLASS but keys are hashed, so lookups do not
+** depend on the keys length nor count. keys order is not defined.
+**
+****************************************************************************/
+
+class VS_HASH_CLASS
+{
+  VS_HASH_BOX *box;
+
+  void detach();
+
+  const VS_STRING_CLASS _ret_empty; // return-empty-container
+
+  VS_STRING_CLASS& ref( const VS_CHAR* key ); // writable data, detaches, creates the key if needed
+
+  friend class VS_STRING_CLASS::Ref;
+
+  public:
+
+  int compact; // values are compact strings (default), see VS_STRING_CLASS::compact()
+
+  VS_HASH_CLASS();
+  VS_HASH_CLASS( const VS_ARRAY_CLASS& arr );
+  VS_HASH_CLASS( const VS_HASH_CLASS& hs );
+  ~VS_HASH_CLASS();
+
+  int count() const { return box->used; };
+
+  void reserve( int n ); // make room for `n' keys without resizing
+
+  void set( const VS_CHAR* key, const VS_CHAR* data ); // set data, same as []=
+  void del( const VS_CHAR* key                      ); // remove data associated with `key'
+  const VS_CHAR* get( const VS_CHAR* key            ); // get data by `key', same as []
+
+  int exists( const VS_CHAR* key ); // return != 0 if key exist (i.e. is used)
+
+  void undef() // delete all key+data pairs
+    { box->unref(); box = new VS_HASH_BOX(); }
+
+  void keys_and_values( VS_ARRAY_CLASS *keys, VS_ARRAY_CLASS *values );
+
+  VS_ARRAY_CLASS keys();   // returns VS_ARRAY_CLASS with keys currently used
+  VS_ARRAY_CLASS values(); // returns VS_ARRAY_CLASS with keys' values
+
+  void reverse(); // reverse keys <-> values
+
+  void merge( VS_HASH_CLASS  *hs  ); // adds keys+values (or modify existing keys)
+  void merge( VS_ARRAY_CLASS *arr ); // adds keys+values (by VS_ARRAY_CLASS pair values)
+
+  void print(); // print hash data to stdout (console)
+
+  int fload( const char* fname ); // return 0 for ok
+  int fsave( const char* fname ); // return 0 for ok
+  int fload( FILE* f ); // return 0 for ok
+  int fsave( FILE* f ); // return 0 for ok
+
+  // as VS_TRIE_CLASS: reading does not detach shared hash (nor creates
+  // missing keys), writes do
+  VS_STRING_REF operator []( const VS_CHAR* key );
+
+  const VS_STRING_CLASS& operator []( const VS_CHAR* key ) const
+    {
+    VS_HASH_NODE *node = box->find_node( key );
+    return node ? node->data : _ret_empty;
+    }
+
+  const VS_HASH_CLASS& operator = ( const VS_HASH_CLASS& hs )
+    {
+    box->unref();
+    box = hs.box;
+    box->ref();
+    return *this;
+    };
+
+  const VS_HASH_CLASS& operator = ( const VS_ARRAY_CLASS& arr )
+    { undef(); merge( (VS_ARRAY_CLASS*)&arr ); return *this; };
+  const VS_HASH_CLASS& operator += ( const VS_ARRAY_CLASS& arr )
+    { merge( (VS_ARRAY_CLASS*)&arr ); return *this; };
+  const VS_HASH_CLASS& operator += ( const VS_HASH_CLASS& hs )
+    { merge( (VS_HASH_CLASS*)&hs ); return *this; };
+
+  /* forward iterators over key+value pairs, same order as keys_and_values() */
+  struct entry
+    {
+    const VS_CHAR* key;
+    const VS_CHAR* value;
+    };
+
+  class const_iterator
+    {
+    const VS_HASH_BOX* box;
+    int                i;  // slot, box->size at the end
+    entry              e;
+
+    void seek( int a_i ) // move to first used slot from `a_i'
+      {
+      i = a_i;
+      while( i < box->size && box->ctrl[i] < 0 ) i++;
+      if ( i < box->size )
+        {
+        e.key   = box->slots[i]->key;
+        e.value = box->slots[i]->data.data();
+        }
+      else
+        e.key = e.value = NULL;
+      };
+
+    public:
+
+    typedef std::forward_iterator_tag iterator_category;
+    typedef entry           value_type;
+    typedef ptrdiff_t       difference_type;
+    typedef const entry*    pointer;
+    typedef const entry&    reference;
+
+    const_iterator( const VS_HASH_BOX* a_box, int a_i ) { box = a_box; seek( a_i ); };
+
+    const entry& operator *  () const { return  e; };
+    const entry* operator -> () const { return &e; };
+
+    const_iterator& operator ++ () { seek( i + 1 ); return *this; };
+    const_iterator  operator ++ ( int ) { const_iterator r = *this; seek( i + 1 ); return r; };
+
+    friend int operator == ( const const_iterator& a, const const_iterator& b )
+      { return a.box == b.box && a.i == b.i; };
+    friend int operator != ( const const_iterator& a, const const_iterator& b )
+      { return ! ( a == b ); };
+    };
+
+  // never detach nor copy values, iterators are valid until hash is changed
+  const_iterator begin()  const { return const_iterator( box, 0 ); };
+  const_iterator end()    const { return const_iterator( box, box->size ); };
+  const_iterator cbegin() const { return begin(); };
+  const_iterator cend()   const { return end(); };
+};
+
+/****************************************************************************
+**
+** VSTRING REF
+**
+** returned by non-const VS_ARRAY_CLASS, VS_TRIE_CLASS and VS_HASH_CLASS operator[].
+** reads go straight to the (possibly shared) element, the container is
+** detached only on write or when VS_STRING_CLASS& is taken from it, while
+** const VS_STRING_CLASS& never detaches. it is nested in VS_STRING_CLASS so
+** all str_*() friends are found for it. it keeps the key pointer only, so
+** it must not outlive the key: `auto r = tr[ VString( "k" ) ]' dangles.
+**
+****************************************************************************/
+
+class VS_STRING_CLASS::Ref
+{
+  VS_ARRAY_CLASS* arr;
+  VS_TRIE_CLASS*  tr;
+  VS_HASH_CLASS*  hs;
+  int             n;
+  const VS_CHAR*  key; // not copied, see above
+
+  // VS_STRING_CLASS& conversion is template so it is never taken for
+  // const VS_STRING_CLASS& (which would be ambiguous otherwise)
+  template< class T, int D = 0 > struct writable {};
+  template< int D > struct writable< VS_STRING_CLASS, D > { typedef VS_STRING_CLASS type; };
+
+public:
+
+  Ref( VS_ARRAY_CLASS* a_arr, int a_n )          { arr = a_arr; tr = NULL; hs = NULL; n = a_n; key = NULL; };
+  Ref( VS_TRIE_CLASS* a_tr, const VS_CHAR* a_key ) { arr = NULL; tr = a_tr; hs = NULL; n = 0; key = a_key; };
+  Ref( VS_HASH_CLASS* a_hs, const VS_CHAR* a_key ) { arr = NULL; tr = NULL; hs = a_hs; n = 0; key = a_key; };
+  Ref( const Ref& r )                             { arr = r.arr; tr = r.tr; hs = r.hs; n = r.n; key = r.key; };
+
+  const VS_STRING_CLASS& str() const // read only, never detaches
+    {
+    if ( arr ) return ((const VS_ARRAY_CLASS*)arr)->operator[]( n );
+    if ( tr  ) return ((const VS_TRIE_CLASS*)tr)->operator[]( key );
+    return ((const VS_HASH_CLASS*)hs)->operator[]( key );
+    };
+  VS_STRING_CLASS& ref() const // writable, detaches the container
+    { return arr ? arr->ref( n ) : tr ? tr->ref( key ) : hs->ref( key ); };
+
+  operator const VS_CHAR* () const   { return str().data(); };
+  const VS_CHAR* data() const         { return str().data(); };
+  operator const VS_STRING_CLASS& () const { return str(); };
+  template< class T, class W = typename writable< T >::type >
+  operator T& () const { return ref(); };
+
+  // same as VS_STRING_CLASS ones, reads never detach, writes go to ref()
+  int       i()  const { return str().i();  };
+  long      l()  const { return str().l();  };
+  long long ll() const { return str().ll(); };
+  double    f()  const { return str().f();  };
+  double    fi() const { return str().fi(); };
+  void      print() const { str().print(); };
+
+  void i ( const int       n ) { ref().i( n );  };
+  void l ( const long      n ) { ref().l( n );  };
+  void ll( const long long n ) { ref().ll( n ); };
+  void f ( const double    d ) { ref().f( d );  };
+  void fi( const double    d ) { ref().fi( d ); };
+
+  void set ( const VS_CHAR*   ps )          { ref().set( ps );        };
+  void set ( const VS_CHAR_R* prs )         { ref().set( prs );       };
+  void cat ( const VS_CHAR*   ps )          { ref().cat( ps );        };
+  void setn( const VS_CHAR*   ps, int len ) { ref().setn( ps, len );  };
+  void catn( const VS_CHAR*   ps, int len ) { ref().catn( ps, len );  };
+
+  void undef()                              { ref().undef();                };
+  void compact( int a_compact )             { ref().compact( a_compact );   };
+  void set_block_size( int new_block_size ) { ref().set_block_size( new_block_size ); };
+  void resize( int new_size )               { ref().resize( new_size );     };
+  void reserve( int len )                   { ref().reserve( len );         };
+  void fixlen()                             { ref().fixlen();               };
+  void fix()                                { ref().fix();                  };
+  void fixbuf()                             { ref().fixbuf();               };
+
+  class Char; // element char, read/write as VS_CHAR_REF
+  Char operator [] ( int n ) const;
+
+  friend ssize_t str_len( const VS_STRING_REF& r ) { return str_len( r.str() ); };
+
+  const VS_STRING_REF& operator  = ( const VS_STRING_REF&   r   ) { ref() = r.str(); return *this; };
+  const VS_STRING_REF& operator  = ( const VS_STRING_CLASS& str ) { ref() = str;     return *this; };
+  const VS_STRING_REF& operator  = ( const VS_CHAR*  ps  ) { ref() = ps; return *this; };
+  const VS_STRING_REF& operator  = ( const int       n   ) { ref() = n;  return *this; };
+  const VS_STRING_REF& operator  = ( const long      n   ) { ref() = n;  return *this; };
+  const VS_STRING_REF& operator  = ( const long long n   ) { ref() = n;  return *this; };
+  const VS_STRING_REF& operator  = ( const double    n   ) { ref() = n;  return *this; };
+
+  const VS_STRING_REF& operator += ( const VS_STRING_REF&   r   ) { ref() += r.str(); return *this; };
+  const VS_STRING_REF& operator += ( const VS_STRING_CLASS& str ) { ref() += str;     return *this; };
+  const VS_STRING_REF& operator += ( const VS_CHAR*  ps  ) { ref() += ps; return *this; };
+  const VS_STRING_REF& operator += ( const int       n   ) { ref() += n;  return *this; };
+  const VS_STRING_REF& operator += ( const long      n   ) { ref() += n;  return *this; };
+  const VS_STRING_REF& operator += ( const long long n   ) { ref() += n;  return *this; };
+  const VS_STRING_REF& operator += ( const double    n   ) { ref() += n;  return *this; };
+
+  friend VS_STRING_CLASS operator + ( const VS_STRING_REF& r1, const VS_STRING_REF& r2 )   { return r1.str() + r2.str(); };
+  friend VS_STRING_CLASS operator + ( const VS_STRING_REF& r, const VS_STRING_CLASS& str ) { return r.str() + str; };
+  friend VS_STRING_CLASS operator + ( const VS_STRING_CLASS& str, const VS_STRING_REF& r ) { return str + r.str(); };
+  friend VS_STRING_CLASS operator + ( const VS_STRING_REF& r, const VS_CHAR* ps )          { return r.str() + ps; };
+  friend VS_STRING_CLASS operator + ( const VS_CHAR* ps, const VS_STRING_REF& r )          { return ps + r.str(); };
+  friend VS_STRING_CLASS operator + ( const VS_STRING_REF& r, const int    n )             { return r.str() + n; };
+  friend VS_STRING_CLASS operator + ( const VS_STRING_REF& r, const long   n )             { return r.str() + n; };
+  friend VS_STRING_CLASS operator + ( const VS_STRING_REF& r, const double n )             { return r.str() + n; };
+
+  friend int operator == ( const VS_STRING_REF&   r1, const VS_STRING_REF&   r2 ) { return VS_FN_STRCMP( r1.data(), r2.data() ) == 0; };
+  friend int operator == ( const VS_STRING_REF&   r,  const VS_STRING_CLASS& s  ) { return VS_FN_STRCMP( r.data(),  s.data()  ) == 0; };
+  friend int operator == ( const VS_STRING_CLASS& s,  const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( s.data(),  r.data()  ) == 0; };
+  friend int operator == ( const VS_STRING_REF&   r,  const VS_CHAR*         ps ) { return VS_FN_STRCMP( r.data(),  ps        ) == 0; };
+  friend int operator == ( const VS_CHAR*         ps, const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( ps,        r.data()  ) == 0; };
+
+  friend int operator != ( const VS_STRING_REF&   r1, const VS_STRING_REF&   r2 ) { return VS_FN_STRCMP( r1.data(), r2.data() ) != 0; };
+  friend int operator != ( const VS_STRING_REF&   r,  const VS_STRING_CLASS& s  ) { return VS_FN_STRCMP( r.data(),  s.data()  ) != 0; };
+  friend int operator != ( const VS_STRING_CLASS& s,  const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( s.data(),  r.data()  ) != 0; };
+  friend int operator != ( const VS_STRING_REF&   r,  const VS_CHAR*         ps ) { return VS_FN_STRCMP( r.data(),  ps        ) != 0; };
+  friend int operator != ( const VS_CHAR*         ps, const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( ps,        r.data()  ) != 0; };
+
+  friend int operator >  ( const VS_STRING_REF&   r1, const VS_STRING_REF&   r2 ) { return VS_FN_STRCMP( r1.data(), r2.data() ) >  0; };
+  friend int operator >  ( const VS_STRING_REF&   r,  const VS_STRING_CLASS& s  ) { return VS_FN_STRCMP( r.data(),  s.data()  ) >  0; };
+  friend int operator >  ( const VS_STRING_CLASS& s,  const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( s.data(),  r.data()  ) >  0; };
+  friend int operator >  ( const VS_STRING_REF&   r,  const VS_CHAR*         ps ) { return VS_FN_STRCMP( r.data(),  ps        ) >  0; };
+  friend int operator >  ( const VS_CHAR*         ps, const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( ps,        r.data()  ) >  0; };
+
+  friend int operator >= ( const VS_STRING_REF&   r1, const VS_STRING_REF&   r2 ) { return VS_FN_STRCMP( r1.data(), r2.data() ) >= 0; };
+  friend int operator >= ( const VS_STRING_REF&   r,  const VS_STRING_CLASS& s  ) { return VS_FN_STRCMP( r.data(),  s.data()  ) >= 0; };
+  friend int operator >= ( const VS_STRING_CLASS& s,  const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( s.data(),  r.data()  ) >= 0; };
+  friend int operator >= ( const VS_STRING_REF&   r,  const VS_CHAR*         ps ) { return VS_FN_STRCMP( r.data(),  ps        ) >= 0; };
+  friend int operator >= ( const VS_CHAR*         ps, const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( ps,        r.data()  ) >= 0; };
+
+  friend int operator <  ( const VS_STRING_REF&   r1, const VS_STRING_REF&   r2 ) { return VS_FN_STRCMP( r1.data(), r2.data() ) <  0; };
+  friend int operator <  ( const VS_STRING_REF&   r,  const VS_STRING_CLASS& s  ) { return VS_FN_STRCMP( r.data(),  s.data()  ) <  0; };
+  friend int operator <  ( const VS_STRING_CLASS& s,  const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( s.data(),  r.data()  ) <  0; };
+  friend int operator <  ( const VS_STRING_REF&   r,  const VS_CHAR*         ps ) { return VS_FN_STRCMP( r.data(),  ps        ) <  0; };
+  friend int operator <  ( const VS_CHAR*         ps, const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( ps,        r.data()  ) <  0; };
+
+  friend int operator <= ( const VS_STRING_REF&   r1, const VS_STRING_REF&   r2 ) { return VS_FN_STRCMP( r1.data(), r2.data() ) <= 0; };
+  friend int operator <= ( const VS_STRING_REF&   r,  const VS_STRING_CLASS& s  ) { return VS_FN_STRCMP( r.data(),  s.data()  ) <= 0; };
+  friend int operator <= ( const VS_STRING_CLASS& s,  const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( s.data(),  r.data()  ) <= 0; };
+  friend int operator <= ( const VS_STRING_REF&   r,  const VS_CHAR*         ps ) { return VS_FN_STRCMP( r.data(),  ps        ) <= 0; };
+  friend int operator <= ( const VS_CHAR*         ps, const VS_STRING_REF&   r  ) { return VS_FN_STRCMP( ps,        r.data()  ) <= 0; };
+
+};
+
+class VS_STRING_CLASS::Ref::Char
+{
+  Ref r;
+  int n;
+
+public:
+
+  Char( const Ref& a_r, int a_n ) : r( a_r ) { n = a_n; };
+
+  operator VS_CHAR () const { return r.str()[n]; };
+
+  const Char& operator = ( VS_CHAR ch )      { r.ref()[n] = ch; return *this; };
+  const Char& operator = ( const Char& c )   { return *this = (VS_CHAR)c; };
+
+  VS_CHAR& ref() const { return r.ref()[n].ref(); };
+  VS_CHAR* operator & () const { return &ref(); };
+
+  const Char& operator += ( int d ) { r.ref()[n] += d; return *this; };
+  const Char& operator -= ( int d ) { r.ref()[n] -= d; return *this; };
+  const Char& operator ++ ()        { return *this += 1; };
+  const Char& operator -- ()        { return *this -= 1; };
+  VS_CHAR operator ++ ( int ) { VS_CHAR ch = *this; *this += 1; return ch; };
+  VS_CHAR operator -- ( int ) { VS_CHAR ch = *this; *this -= 1; return ch; };
+};
+
+  inline VS_STRING_REF::Char VS_STRING_REF::operator [] ( int n ) const { return Char( *this, n ); }
+
+  inline VS_STRING_REF VS_ARRAY_CLASS::operator []( int n ) { return VS_STRING_REF( this, n ); }
+  inline VS_STRING_REF VS_TRIE_CLASS::operator []( const VS_CHAR* key ) { return VS_STRING_REF( this, key ); }
+  inline VS_STRING_REF VS_HASH_CLASS::operator []( const VS_CHAR* key ) { return VS_STRING_REF( this, key ); }
+
+  inline void VS_ARRAY_CLASS::ins( int n, const VS_STRING_REF& r ) { ins( n, r.str() ); }
+  inline void VS_ARRAY_CLASS::set( int n, const VS_STRING_REF& r ) { set( n, r.str() ); }
+  inline int  VS_ARRAY_CLASS::push( const VS_STRING_REF& r )       { return push( r.str() ); }
+  inline int  VS_ARRAY_CLASS::unshift( const VS_STRING_REF& r )    { return unshift( r.str() ); }
+
+  inline VS_STRING_CLASS::VS_STRING_CLASS( const Ref& r ) { box = r.str().box; box->ref(); }
+  inline const VS_STRING_CLASS& VS_STRING_CLASS::operator  = ( const Ref& r ) { return *this = r.str(); }
+  inline const VS_STRING_CLASS& VS_STRING_CLASS::operator += ( const Ref& r ) { return *this += r.str(); }
+
+  inline VS_CHAR_REF::operator VS_CHAR () const
+    { return n >= 0 && n < str->box->sl ? str->box->s[n] : 0; }
+  inline VS_CHAR& VS_CHAR_REF::ref() const
+    {
+    if ( n < 0 || n >= str->box->sl ) return str->retch = 0;
+    str->detach();
+    return str->box->s[n];
+    }
+  inline const VS_CHAR_REF& VS_CHAR_REF::operator = ( VS_CHAR ch )
+    {
+    if ( n < 0 || n >= str->box->sl ) return *this;
+    str->detach();
+    str->box->s[n] = ch;
+    return *this;
+    }
+
 /****************************************************************************
 **
 ** VS_STRING_CLASS Utility functions
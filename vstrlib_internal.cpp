@@ -18,6 +18,10 @@
  ***************************************************************************/
 
 #include "vstrlib_internal.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 /****************************************************************************
 **
@@ -227,12 +231,13 @@ int mem_kmp_search( const VS_CHAR *p, int ps, const VS_CHAR *d, int ds )
 *****************************************************************************/
 
 #define QS_ASIZE 256
+#define QS_INDEX(c) ( (unsigned)(c) & ( QS_ASIZE - 1 ) ) // wide chars share slots, shift stays safe
 
 void __qs_preprocess( const VS_CHAR* p, int ps, int* badc )
 {
    int i;
    for (i = 0; i < QS_ASIZE; i++) badc[i] = ps + 1;
-   for (i = 0; i < ps; i++) badc[(unsigned)(VS_CHAR)p[i]] = ps - i;
+   for (i = 0; i < ps; i++) badc[QS_INDEX(p[i])] = ps - i;
 }
 
 int mem_quick_search( const VS_CHAR *p, int ps, const VS_CHAR *d, int ds )
@@ -246,7 +251,7 @@ int mem_quick_search( const VS_CHAR *p, int ps, const VS_CHAR *d, int ds )
       int i;
       for ( i = ps - 1; i >= 0 && p[i] == d[i + j]; --i );
       if ( i < 0 ) return j;
-      j += badc[(unsigned)(VS_CHAR)d[j + ps]];
+      j += badc[QS_INDEX(d[j + ps])];
    }
    return -1;
 }
@@ -257,7 +262,7 @@ void __qs_preprocess_nc( const VS_CHAR* p, int ps, int* badc )
 {
    int i;
    for (i = 0; i < QS_ASIZE; i++) badc[i] = ps + 1;
-   for (i = 0; i < ps; i++) badc[toupper((VS_CHAR)p[i])] = ps - i;
+   for (i = 0; i < ps; i++) badc[QS_INDEX(VS_FN_TOUPPER(p[i]))] = ps - i;
 }
 
 int mem_quick_search_nc( const VS_CHAR *p, int ps, const VS_CHAR *d, int ds )
@@ -269,9 +274,9 @@ int mem_quick_search_nc( const VS_CHAR *p, int ps, const VS_CHAR *d, int ds )
    while (j <= ds - ps)
    {
       int i;
-      for ( i = ps - 1; i >= 0 && toupper(p[i]) == toupper(d[i + j]); --i );
+      for ( i = ps - 1; i >= 0 && VS_FN_TOUPPER(p[i]) == VS_FN_TOUPPER(d[i + j]); --i );
       if ( i < 0 ) return j;
-      j += badc[toupper((VS_CHAR)d[j + ps])];
+      j += badc[QS_INDEX(VS_FN_TOUPPER(d[j + ps]))];
    }
    return -1;
 }
@@ -762,7 +767,7 @@ int mem_string_search( const VS_CHAR *p, const VS_CHAR* d, const VS_CHAR* opt )
   {
     if ( re ) pcre2_code_free( re );
     if ( md ) pcre2_match_data_free( md );
-    if ( pt ) delete pt;
+    if ( pt ) delete [] pt;
   }
 
   int VS_REGEXP_CLASS::get_options( const VS_CHAR* opt )
@@ -794,10 +799,13 @@ int mem_string_search( const VS_CHAR *p, const VS_CHAR* d, const VS_CHAR* opt )
   int VS_REGEXP_CLASS::comp( const VS_CHAR* pattern, const VS_CHAR *opt )
   {
     if ( re ) pcre2_code_free( re );
+    if ( md ) pcre2_match_data_free( md );
     if ( pt ) delete [] pt;
     re = NULL;
+    md = NULL;
     pt = NULL;
     pl = 0;
+    rc = 0;
 
     int options = get_options( opt );
     if( options == -1 ) return 0;
@@ -850,6 +858,11 @@ int mem_string_search( const VS_CHAR *p, const VS_CHAR* d, const VS_CHAR* opt )
   }
 
   int VS_REGEXP_CLASS::m( const VS_CHAR* line )
+  {
+    return m( line, line ? str_len( line ) : 0, 0 );
+  }
+
+  int VS_REGEXP_CLASS::m( const VS_CHAR* line, int len, int startpos )
   {
     if ( ! ok() )
       {
@@ -861,24 +874,29 @@ int mem_string_search( const VS_CHAR *p, const VS_CHAR* d, const VS_CHAR* opt )
       errstr = VS_CHAR_L("no data to search into");
       return 0;
       }
-    errstr = VS_CHAR_L("");
+    if ( errstr[0] ) errstr = VS_CHAR_L("");
     lp = line;
+    rc = 0;
+    pos = -1;
+    if ( startpos < 0 || startpos > len ) return 0;
     if ( opt_mode == MODE_REGEXP )
       {
-      if( md ) pcre2_match_data_free( md );
-      md = pcre2_match_data_create_from_pattern( re, NULL );
+      // match data is kept between calls, sized for the compiled pattern
+      if ( ! md ) md = pcre2_match_data_create_from_pattern( re, NULL );
+      if ( ! md ) return 0;
 
       unsigned int options = 0;
-      rc = pcre2_match( re, (PCRE2_SPTR)lp, str_len(lp), 0, options, md, NULL);
+      rc = pcre2_match( re, (PCRE2_SPTR)lp, len, startpos, options, md, NULL);
       if ( rc < 1 ) rc = 0;
       return rc;
       }
     else
       {
       if ( opt_nocase )
-        pos = mem_quick_search_nc( pt, pl, line, str_len(lp) );
+        pos = mem_quick_search_nc( pt, pl, line + startpos, len - startpos );
       else
-        pos = mem_quick_search( pt, pl, line, str_len(lp) );
+        pos = mem_quick_search( pt, pl, line + startpos, len - startpos );
+      if ( pos >= 0 ) pos += startpos;
       return pos >= 0;
       }
   }
@@ -947,79 +965,702 @@ int mem_string_search( const VS_CHAR *p, const VS_CHAR* d, const VS_CHAR* opt )
 
 /***************************************************************************
 **
-** UTILITIES
+** VTOKENIZER
 **
 ****************************************************************************/
 
-  // split `source' with `regexp_str' regexp
-  VS_ARRAY_CLASS str_split( const VS_CHAR* regexp_str, const VS_CHAR* source, int maxcount )
+namespace {
+
+  // delimiters without regexp special chars are searched as plain strings
+  int __vs_split_literal( const VS_CHAR* p )
   {
-    VS_ARRAY_CLASS arr;
-    VS_REGEXP_CLASS re;
-    int z = re.comp( regexp_str );
-    ASSERT( z );
-    if ( ! z ) return arr;
+    for( ; *p; p++ )
+      if ( VS_FN_STRCHR( VS_CHAR_L("\\^$.|?*+()[]{}"), *p ) ) return 0;
+    return 1;
+  }
+
+} // namespace
+
+  VS_TOKENIZER_CLASS::VS_TOKENIZER_CLASS()
+  {
+    mode = MODE_STRING;
+    dok  = 0;
+    memset( cm, 0, sizeof( cm ) );
+    reset( NULL );
+  }
+
+  VS_TOKENIZER_CLASS::VS_TOKENIZER_CLASS( const VS_CHAR* regexp_str )
+  {
+    mode = MODE_STRING;
+    dok  = 0;
+    memset( cm, 0, sizeof( cm ) );
+    reset( NULL );
+    set_regexp( regexp_str );
+  }
+
+  int VS_TOKENIZER_CLASS::set_regexp( const VS_CHAR* regexp_str )
+  {
+    if ( regexp_str && __vs_split_literal( regexp_str ) )
+      {
+      set_string( regexp_str );
+      return 1;
+      }
+    mode = MODE_REGEXP;
+    dok  = regexp_str && re.comp( regexp_str ) > 0;
+    return dok;
+  }
 
-    const VS_CHAR* ps = source;
+  void VS_TOKENIZER_CLASS::set_string( const VS_CHAR* delimiter_str )
+  {
+    mode = MODE_STRING;
+    dok  = delimiter_str != NULL;
+    dl   = delimiter_str;
+  }
+
+  void VS_TOKENIZER_CLASS::set_charset( const VS_CHAR* chars )
+  {
+    mode = MODE_CHARSET;
+    dok  = chars != NULL;
+    dl   = chars;
+    memset( cm, 0, sizeof( cm ) );
+    if ( ! chars ) return;
+    for( const VS_CHAR* p = chars; *p; p++ )
+      {
+      unsigned long c = sizeof( VS_CHAR ) == 1 ? (unsigned char)*p : (unsigned long)*p;
+      if ( c < 256 ) cm[ c ] = 1;
+      }
+  }
+
+  void VS_TOKENIZER_CLASS::reset( const VS_CHAR* source, int len, int maxcount )
+  {
+    src   = source;
+    sl    = ! source ? 0 : len < 0 ? str_len( source ) : len;
+    start = 0;
+    from  = 0;
+    left  = maxcount > 0 ? maxcount : 0;
+    fs    = 0;
+    fl    = 0;
+    fc    = 0;
+  }
+
+  // find next delimiter at or after `from', within source length
+  int VS_TOKENIZER_CLASS::find( int* sp, int* ep )
+  {
+    if ( mode == MODE_REGEXP )
+      {
+      if ( ! re.m( src, sl, from ) ) return 0;
+      *sp = re.sub_sp( 0 );
+      *ep = re.sub_ep( 0 );
+      return 1;
+      }
 
-    while( ps && ps[0] && re.m( ps ) )
+    if ( mode == MODE_CHARSET )
       {
-      if ( maxcount != -1 )
+      for( int i = from; i < sl; i++ )
         {
-        maxcount--;
-        if ( maxcount == 0 ) break;
+        unsigned long c = sizeof( VS_CHAR ) == 1 ? (unsigned char)src[i] : (unsigned long)src[i];
+        if ( c < 256 ? cm[ c ] : VS_FN_STRCHR( dl.data(), src[i] ) != NULL )
+          {
+          *sp = i;
+          *ep = i + 1;
+          return 1;
+          }
         }
-      VS_STRING_CLASS s;
-      s.setn( ps, re.sub_sp( 0 ) );
-      arr.push( s );
-      ps += re.sub_ep( 0 );
+      return 0;
       }
-    if ( ps && ps[0] )
-      arr.push( ps );
-    return arr;
+
+    const VS_CHAR* d  = dl.data();
+    int            dn = str_len( dl );
+    if ( dn == 0 )
+      {
+      *sp = *ep = from;
+      return 1;
+      }
+    // memchr() for the first char keeps the search inside `sl'
+    const VS_CHAR* p = src + from;
+    const VS_CHAR* e = src + sl - dn; // last possible match start
+    while( p <= e )
+      {
+      p = VS_FN_MEMCHR( p, d[0], e - p + 1 );
+      if ( ! p ) return 0;
+      if ( dn == 1 || VS_FN_STRNCMP( p + 1, d + 1, dn - 1 ) == 0 )
+        {
+        *sp = p - src;
+        *ep = *sp + dn;
+        return 1;
+        }
+      p++;
+      }
+    return 0;
   }
 
-  // split `source' with exact string `delimiter_str'
-  VS_ARRAY_CLASS str_split_simple( const VS_CHAR* delimiter_str, const VS_CHAR* source, int maxcount )
+  int VS_TOKENIZER_CLASS::next()
   {
-    VS_ARRAY_CLASS arr;
-    const VS_CHAR* ps = source;
-    const VS_CHAR* fs;
+    if ( ! dok || start >= sl ) return 0;
+    while(4)
+      {
+      int sp;
+      int ep;
+      if ( left == 1 || ! find( &sp, &ep ) )
+        { // last field holds the rest
+        fs    = start;
+        fl    = sl - start;
+        start = sl;
+        fc++;
+        return 1;
+        }
+      if ( ep == start )
+        { // empty match at the field start, fields get at least one char
+        from = start + 1;
+        continue;
+        }
+      if ( left > 1 ) left--;
+      fs    = start;
+      fl    = sp - start;
+      start = from = ep;
+      fc++;
+      return 1;
+      }
+  }
+
+/***************************************************************************
+**
+** VCSV
+**
+****************************************************************************/
+
+  VS_CSV_CLASS::VS_CSV_CLASS( VS_CHAR delim, VS_CHAR quote )
+  {
+    dc    = delim;
+    qc    = quote;
+    f     = NULL;
+    own_f = 0;
+    mp    = NULL;
+    ml    = 0;
+    mr    = 0;
+    sb    = NULL;
+    sbl   = sbs = 0;
+    rb    = NULL;
+    rbl   = rbs = 0;
+    fb    = NULL;
+    fbl   = fbs = 0;
+    fo    = NULL;
+    fc    = fos = 0;
+    reset( NULL );
+  }
+
+  VS_CSV_CLASS::~VS_CSV_CLASS()
+  {
+    close();
+    free( sb );
+    free( rb );
+    free( fb );
+    free( fo );
+  }
+
+  void VS_CSV_CLASS::reset( const VS_CHAR* source, long len )
+  {
+    close();
+    in  = source;
+    il  = ! source ? 0 : len < 0 ? str_len( source ) : len;
+    ip  = 0;
+    eof = 1;
+  }
+
+  int VS_CSV_CLASS::open( FILE* a_f )
+  {
+    reset( NULL );
+    if ( ! a_f ) return 1;
+    f   = a_f;
+    eof = 0;
+    return 0;
+  }
+
+  int VS_CSV_CLASS::open( const char* fname )
+  {
+    reset( NULL );
+    // regular files are mapped, narrow ones are parsed in place
+    int fd = ::open( fname, O_RDONLY );
+    if ( fd < 0 ) return 1;
+    struct stat st;
+    if ( fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 && (off_t)(size_t)st.st_size == st.st_size )
+      {
+      void* m = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if ( m != MAP_FAILED )
+        {
+        ::close( fd );
+        madvise( m, st.st_size, MADV_SEQUENTIAL );
+        mp = (const char*)m;
+        ml = st.st_size;
+        #ifdef _VSTRING_WIDE_
+        eof = 0;
+        #else
+        in  = mp;
+        il  = ml;
+        #endif
+        return 0;
+        }
+      }
+    f = fdopen( fd, "rb" );
+    if ( ! f )
+      {
+      ::close( fd );
+      return 1;
+      }
+    own_f = 1;
+    eof   = 0;
+    return 0;
+  }
+
+  void VS_CSV_CLASS::close()
+  {
+    if ( f && own_f ) fclose( f );
+    if ( mp ) munmap( (void*)mp, ml );
+    f     = NULL;
+    own_f = 0;
+    mp    = NULL;
+    ml    = mr = 0;
+    in    = NULL;
+    il    = ip = 0;
+    eof   = 1;
+    sbl   = 0;
+    rbl   = 0;
+    fc    = 0;
+  }
+
+  size_t VS_CSV_CLASS::read( char* buf, size_t len )
+  {
+    if ( f ) return fread( buf, 1, len, f );
+    if ( len > ml - mr ) len = ml - mr;
+    memcpy( buf, mp + mr, len );
+    mr += len;
+    return len;
+  }
+
+  // drop parsed data and read more, at least as much as already buffered so
+  // rows longer than the window are not parsed over and over. returns 0 at
+  // the end of the stream
+  int VS_CSV_CLASS::fill()
+  {
+    if ( eof ) return 0;
+    if ( ip )
+      {
+      sbl -= ip;
+      memmove( sb, sb + ip, sbl * sizeof( VS_CHAR ) );
+      ip = 0;
+      }
+
+    size_t want = sbl + rbl > VCSV_READ_WINDOW ? sbl + rbl : VCSV_READ_WINDOW;
+
+    #ifdef _VSTRING_WIDE_
+    if ( rbs - rbl < want )
+      {
+      char* new_rb = (char*)realloc( rb, rbl + want );
+      if ( ! new_rb ) return 0;
+      rb  = new_rb;
+      rbs = rbl + want;
+      }
+    size_t r = read( rb + rbl, want );
+    rbl += r;
+    if ( r == 0 ) eof = 1;
+    // decode up to the last newline, multi-byte chars never split there
+    size_t used = rbl;
+    if ( ! eof )
+      while( used > 0 && rb[used - 1] != '\n' ) used--;
+    if ( sbs - sbl < used + 1 )
+      {
+      VS_CHAR* new_sb = (VS_CHAR*)realloc( sb, ( sbl + used + 1 ) * sizeof( VS_CHAR ) );
+      if ( ! new_sb ) return 0;
+      sb  = new_sb;
+      sbs = sbl + used + 1;
+      }
+    sbl += str_mbs_decode( sb + sbl, rb, used );
+    rbl -= used;
+    memmove( rb, rb + used, rbl );
+    #else
+    if ( sbs - sbl < want )
+      {
+      VS_CHAR* new_sb = (VS_CHAR*)realloc( sb, sbl + want );
+      if ( ! new_sb ) return 0;
+      sb  = new_sb;
+      sbs = sbl + want;
+      }
+    size_t r = read( sb + sbl, want );
+    sbl += r;
+    if ( r == 0 ) eof = 1;
+    #endif
+
+    in = sb;
+    il = sbl;
+    return 1;
+  }
+
+  int VS_CSV_CLASS::put( const VS_CHAR* s, int len )
+  {
+    if ( fbs - fbl < len + 1 )
+      {
+      int new_size = fbs * 2 > fbl + len + 1 ? fbs * 2 : fbl + len + 64;
+      VS_CHAR* new_fb = (VS_CHAR*)realloc( fb, new_size * sizeof( VS_CHAR ) );
+      if ( ! new_fb ) return 0;
+      fb  = new_fb;
+      fbs = new_size;
+      }
+    memcpy( fb + fbl, s, len * sizeof( VS_CHAR ) );
+    fbl += len;
+    return 1;
+  }
+
+  // start new field, also keeps end offset of the previous one
+  int VS_CSV_CLASS::field()
+  {
+    if ( fc + 2 > fos )
+      {
+      int new_size = fos * 2 + 16;
+      int* new_fo = (int*)realloc( fo, new_size * sizeof( int ) );
+      if ( ! new_fo ) return 0;
+      fo  = new_fo;
+      fos = new_size;
+      }
+    fo[fc++] = fbl;
+    return 1;
+  }
+
+  // parse one row from `ip', returns 1 for row, 0 if more data is needed,
+  // -1 at the end of data. the row ends at the next newline (or the end of
+  // data), unquoted field is the span up to the nearest delimiter before it,
+  // so both are found with memchr() instead of checking each char. trailing
+  // '\r' of the row is dropped, also when it is the last char of the data
+  int VS_CSV_CLASS::parse()
+  {
+    if ( ip >= il ) return eof ? -1 : 0;
+    const VS_CHAR* p = in + ip;
+    const VS_CHAR* e = in + il;
+    const VS_CHAR* l = VS_FN_MEMCHR( p, '\n', e - p );
+    VS_CHAR        z = 0;
+    fc  = 0;
+    fbl = 0;
+
+    if ( ! l )
+      {
+      if ( ! eof ) return 0;
+      l = e;
+      }
+    if ( l == p || ( l == p + 1 && *p == '\r' ) )
+      { // empty line
+      ip = l < e ? l + 1 - in : il;
+      return 1;
+      }
 
-    int rl = str_len( delimiter_str );
+    while(4)
+      {
+      if ( ! field() ) return -1;
+      if ( qc && p < e && *p == qc )
+        {
+        p++;
+        while(4)
+          { // quoted parts are copied up to the next quote
+          const VS_CHAR* q = VS_FN_MEMCHR( p, qc, e - p );
+          if ( ! q )
+            {
+            if ( ! eof ) return 0;
+            if ( ! put( p, e - p ) ) return -1;
+            p = e;
+            break;
+            }
+          if ( ! put( p, q - p ) ) return -1;
+          p = q + 1;
+          if ( p == e && ! eof ) return 0; // may be doubled quote
+          if ( p == e || *p != qc ) break;
+          if ( ! put( p, 1 ) ) return -1;
+          p++;
+          }
+        if ( p > l )
+          { // quoted newlines, the row ends after them
+          l = VS_FN_MEMCHR( p, '\n', e - p );
+          if ( ! l )
+            {
+            if ( ! eof ) return 0;
+            l = e;
+            }
+          }
+        }
+      const VS_CHAR* s = p;
+      const VS_CHAR* d = VS_FN_MEMCHR( p, dc, l - p );
+      p = d ? d : l;
+      int fl = p - s;
+      if ( ! d && fl > 0 && s[fl - 1] == '\r' ) fl--;
+      if ( ! put( s, fl ) || ! put( &z, 1 ) ) return -1;
+      if ( d )
+        {
+        p++;
+        continue;
+        }
+      if ( p < e ) p++;
+      break;
+      }
+    fo[fc] = fbl;
+    ip = p - in;
+    return 1;
+  }
 
-    VS_STRING_CLASS s;
-    while( (fs = VS_FN_STRSTR( ps, delimiter_str )) )
+  int VS_CSV_CLASS::next()
+  {
+    while(4)
       {
-      if ( maxcount != -1 )
+      int r = parse();
+      if ( r > 0 ) return 1;
+      if ( r < 0 || ! fill() )
         {
-        maxcount--;
-        if ( maxcount == 0 ) break;
+        fc = 0;
+        return 0;
         }
-      int l = fs - ps;
-      s.setn( ps, l );
-      arr.push( s );
-      ps = (const VS_CHAR *)(ps + l + rl);
       }
-    if ( ps && ps[0] )
-      arr.push( ps );
+  }
+
+  int VS_CSV_CLASS::row( VS_ARRAY_CLASS& dest ) const
+  {
+    for( int i = 0; i < fc; i++ )
+      dest.push( fb + fo[i], fo[i+1] - fo[i] - 1 );
+    return fc;
+  }
+
+/***************************************************************************
+**
+** UTILITIES
+**
+****************************************************************************/
+
+namespace {
+
+  struct __vs_split_to_array
+  {
+    VS_ARRAY_CLASS* arr;
+    void operator()( const VS_CHAR* s, int len ) { arr->push( s, len ); };
+  };
+
+  struct __vs_split_to_pos
+  {
+    const VS_CHAR* base;
+    int*           pos;
+    int            max;
+    int            n;
+    void operator()( const VS_CHAR* s, int len )
+      {
+      if ( n < max )
+        {
+        pos[ 2 * n     ] = s - base;
+        pos[ 2 * n + 1 ] = s - base + len;
+        }
+      n++;
+      };
+  };
+
+  // `emit' gets each field, returns fields count or -1 for bad delimiter
+  template< class EMIT >
+  int __vs_split( VS_TOKENIZER_CLASS& tk, const VS_CHAR* source, int maxcount, EMIT& emit )
+  {
+    if ( ! tk.ok() ) return -1;
+    tk.reset( source, -1, maxcount );
+    while( tk.next() )
+      emit( tk.ptr(), tk.len() );
+    return tk.count();
+  }
+
+} // namespace
+
+  // split `source' with `regexp_str' regexp
+  VS_ARRAY_CLASS str_split( const VS_CHAR* regexp_str, const VS_CHAR* source, int maxcount )
+  {
+    VS_ARRAY_CLASS arr;
+    int z = str_split( arr, regexp_str, source, maxcount );
+    ASSERT( z >= 0 );
     return arr;
   }
 
+  int str_split( VS_ARRAY_CLASS& dest, const VS_CHAR* regexp_str, const VS_CHAR* source, int maxcount )
+  {
+    if ( ! regexp_str || ! source ) return 0;
+    VS_TOKENIZER_CLASS tk( regexp_str );
+    __vs_split_to_array emit;
+    emit.arr = &dest;
+    return __vs_split( tk, source, maxcount, emit );
+  }
+
+  int str_split_pos( int* pos, int max_fields, const VS_CHAR* regexp_str, const VS_CHAR* source, int maxcount )
+  {
+    if ( ! regexp_str || ! source ) return 0;
+    VS_TOKENIZER_CLASS tk( regexp_str );
+    __vs_split_to_pos emit;
+    emit.base = source;
+    emit.pos  = pos;
+    emit.max  = max_fields;
+    emit.n    = 0;
+    return __vs_split( tk, source, maxcount, emit );
+  }
+
+  // split `source' with exact string `delimiter_str'
+  VS_ARRAY_CLASS str_split_simple( const VS_CHAR* delimiter_str, const VS_CHAR* source, int maxcount )
+  {
+    VS_ARRAY_CLASS arr;
+    if ( ! delimiter_str || ! source ) return arr;
+    VS_TOKENIZER_CLASS tk;
+    tk.set_string( delimiter_str );
+    __vs_split_to_array emit;
+    emit.arr = &arr;
+    __vs_split( tk, source, maxcount, emit );
+    return arr;
+  }
+
+  int str_csv_split( VS_ARRAY_CLASS& dest, const VS_CHAR* source, VS_CHAR delim, VS_CHAR quote )
+  {
+    VS_CSV_CLASS csv( delim, quote );
+    csv.reset( source );
+    return csv.next() ? csv.row( dest ) : 0;
+  }
+
   // join array data to single string with `glue' string
   // returns the result string or store to optional `dest'
-  VS_STRING_CLASS str_join( VS_ARRAY_CLASS array, const VS_CHAR* glue )
+  VS_STRING_CLASS str_join( const VS_ARRAY_CLASS& array, const VS_CHAR* glue )
+  {
+    VS_STRING_CLASS str;
+    str_join( str, array, glue );
+    return str;
+  }
+
+  VS_STRING_CLASS& str_join( VS_STRING_CLASS& dest, const VS_ARRAY_CLASS& array, const VS_CHAR* glue, int n, int cnt )
+  {
+    int ac = array.count();
+    if ( n < 0 ) n += ac;
+    if ( n < 0 ) n = 0;
+    if ( cnt < 0 || n + cnt > ac ) cnt = ac - n;
+    if ( cnt < 1 ) return dest;
+
+    VS_ARRAY_CLASS::const_iterator b = array.begin() + n;
+    VS_ARRAY_CLASS::const_iterator e = b + cnt;
+    VS_ARRAY_CLASS::const_iterator it;
+    int gl  = glue ? str_len( glue ) : 0;
+    int len = str_len( dest ) + ( cnt - 1 ) * gl;
+    for( it = b; it != e; ++it )
+      len += str_len( *it );
+    dest.reserve( len );
+    for( it = b; it != e; ++it )
+      {
+      if ( gl && it != b ) dest.catn( glue, gl );
+      dest.catn( it->data(), str_len( *it ) );
+      }
+    return dest;
+  }
+
+namespace {
+
+  VS_STRING_CLASS __vs_join_trie( const VS_TRIE_CLASS& trie, const VS_CHAR* glue, int values )
   {
     VS_STRING_CLASS str;
-    for( int z = 0; z < array.count()-1; z++ )
+    VS_TRIE_CLASS::const_iterator b = trie.begin();
+    VS_TRIE_CLASS::const_iterator e = trie.end();
+    VS_TRIE_CLASS::const_iterator it;
+    int gl  = glue ? str_len( glue ) : 0;
+    int len = 0;
+    for( it = b; it != e; ++it )
+      len += str_len( values ? it->value : it->key ) + gl;
+    str.reserve( len );
+    for( it = b; it != e; ++it )
       {
-      str += array.get( z );
-      str += glue;
+      if ( gl && it != b ) str.catn( glue, gl );
+      const VS_CHAR* ps = values ? it->value : it->key;
+      str.catn( ps, str_len( ps ) );
       }
-    str += array.get( array.count()-1 );
     return str;
   }
 
+} // namespace
+
+  VS_STRING_CLASS str_join_keys( const VS_TRIE_CLASS& trie, const VS_CHAR* glue )
+  {
+    return __vs_join_trie( trie, glue, 0 );
+  }
+
+  VS_STRING_CLASS str_join_values( const VS_TRIE_CLASS& trie, const VS_CHAR* glue )
+  {
+    return __vs_join_trie( trie, glue, 1 );
+  }
+
+namespace {
+
+  struct __vs_grep_job
+  {
+    pcre2_code*        re;  // NULL for plain (find/hex) search
+    pcre2_match_data** md;  // per worker, created on first use
+    const VS_CHAR*     pt;
+    int                pl;
+    int                nocase;
+    int                invert;
+  };
+
+  int __vs_grep_match( const VS_CHAR* s, int k, void* arg )
+  {
+    __vs_grep_job* job = (__vs_grep_job*)arg;
+    int found;
+    if ( job->re )
+      {
+      if ( ! job->md[k] ) job->md[k] = pcre2_match_data_create_from_pattern( job->re, NULL );
+      found = job->md[k] && pcre2_match( job->re, (PCRE2_SPTR)s, PCRE2_ZERO_TERMINATED, 0, 0, job->md[k], NULL ) > 0;
+      }
+    else if ( job->nocase )
+      found = mem_quick_search_nc( job->pt, job->pl, s, str_len( s ) ) >= 0;
+    else
+      found = mem_quick_search( job->pt, job->pl, s, str_len( s ) ) >= 0;
+    return found != job->invert;
+  }
+
+} // namespace
+
+  VS_ARRAY_CLASS str_grep( VS_ARRAY_CLASS& arr, VS_REGEXP_CLASS& re, int invert )
+  {
+    VS_ARRAY_CLASS res;
+    str_grep( res, arr, re, invert );
+    return res;
+  }
+
+  VS_ARRAY_CLASS str_grep( VS_ARRAY_CLASS& arr, const VS_CHAR* pattern, const VS_CHAR* opt, int invert )
+  {
+    VS_ARRAY_CLASS res;
+    str_grep( res, arr, pattern, opt, invert );
+    return res;
+  }
+
+  int str_grep( VS_ARRAY_CLASS& dest, VS_ARRAY_CLASS& arr, VS_REGEXP_CLASS& re, int invert )
+  {
+    if ( ! re.ok() ) return -1;
+
+    // VS_REGEXP_CLASS::m() keeps match state in the object, so workers get
+    // their own match data for the shared compiled pattern
+    __vs_grep_job job;
+    job.re     = re.opt_mode == VS_REGEXP_CLASS::MODE_REGEXP ? re.re : NULL;
+    job.pt     = re.pt;
+    job.pl     = re.pl;
+    job.nocase = re.opt_nocase;
+    job.invert = invert != 0;
+
+    int threads = vs_parallel_threads();
+    job.md = (pcre2_match_data**)calloc( threads, sizeof( pcre2_match_data* ) );
+    ASSERT( job.md );
+
+    int found = arr.grep( dest, __vs_grep_match, &job );
+
+    for( int k = 0; k < threads; k++ )
+      if ( job.md[k] ) pcre2_match_data_free( job.md[k] );
+    free( job.md );
+    return found;
+  }
+
+  int str_grep( VS_ARRAY_CLASS& dest, VS_ARRAY_CLASS& arr, const VS_CHAR* pattern, const VS_CHAR* opt, int invert )
+  {
+    VS_REGEXP_CLASS re;
+    if ( ! re.comp( pattern, opt ) ) return -1;
+    return str_grep( dest, arr, re, invert );
+  }
+
 /*****************************************************************************
 **
 ** find/rfind versions for regexp separators
@@ -34,6 +34,9 @@
 /* max file_grep() text line input length... :| */
 #define MAX_GREP_LINE   4096
 
+/* VCSV file read window, grows for longer rows */
+#define VCSV_READ_WINDOW  ( 256*1024 )
+
 
 /****************************************************************************
 **
@@ -253,6 +256,8 @@ class VS_REGEXP_CLASS
 
   int get_options( const VS_CHAR* opt );
 
+  friend int str_grep( VS_ARRAY_CLASS& dest, VS_ARRAY_CLASS& arr, VS_REGEXP_CLASS& re, int invert );
+
   public:
 
   VS_REGEXP_CLASS();
@@ -273,6 +278,7 @@ class VS_REGEXP_CLASS
   int ok(); // return 1 if regexp is compiled ok, 0 if not
 
   int m( const VS_CHAR* line ); // execute re against line, return 1 for match
+  int m( const VS_CHAR* line, int len, int startpos ); // same for `len' chars long line, search from `startpos', positions are still from `line' start
   int m( const VS_CHAR* line, const VS_CHAR* pattern, const VS_CHAR *opt = NULL ); // same as exec, but compiles first
 
   VS_STRING_CLASS sub( int n ); // return n-th substring match
@@ -285,21 +291,205 @@ class VS_REGEXP_CLASS
   const VS_CHAR* error_str() { return errstr.data(); };
 };
 
+/***************************************************************************
+**
+** VTOKENIZER
+**
+****************************************************************************/
+/*
+** lazy split: yields one field at a time as pointer and length into the
+** source, which must stay intact while fields are used. delimiters have
+** the same semantics as in str_split(): empty matches split between chars
+** and trailing empty field is dropped. tokenizer can be reset() to any
+** number of sources, compiled regexp and match data are reused.
+**
+**   VTokenizer tk( ", *" );
+**   tk.reset( line );
+**   while( tk.next() )
+**     printf( "%.*s\n", tk.len(), tk.ptr() );
+**
+*/
+
+class VS_TOKENIZER_CLASS
+{
+  /* delimiter modes */
+  enum DelimMode { MODE_REGEXP = 0, MODE_STRING, MODE_CHARSET };
+
+  DelimMode        mode;
+  VS_REGEXP_CLASS  re;
+  VS_STRING_CLASS  dl;        // MODE_STRING delimiter or MODE_CHARSET chars
+  unsigned char    cm[256];   // MODE_CHARSET map for chars below 256
+  int              dok;       // 1 if delimiter is set and valid
+
+  const VS_CHAR*   src;       // current source, external
+  int              sl;        // source length
+  int              start;     // next field start
+  int              from;      // next delimiter search position
+  int              left;      // fields left before the rest is returned, -1 no limit
+  int              fs;        // current field start
+  int              fl;        // current field length
+  int              fc;        // fields returned so far
+
+  int find( int* sp, int* ep );
+
+  VS_TOKENIZER_CLASS( const VS_TOKENIZER_CLASS& );               // no copy
+  VS_TOKENIZER_CLASS& operator = ( const VS_TOKENIZER_CLASS& );  // no copy
+
+  public:
+
+  VS_TOKENIZER_CLASS();
+  VS_TOKENIZER_CLASS( const VS_CHAR* regexp_str ); // same as set_regexp()
+
+  int  set_regexp( const VS_CHAR* regexp_str ); // plain strings are searched as set_string(), returns 1 for success
+  void set_string( const VS_CHAR* delimiter_str ); // exact string, as str_split_simple()
+  void set_charset( const VS_CHAR* chars ); // any single char of `chars'
+  int  ok() { return dok; } // return 1 if delimiter is usable
+
+  // start over `source' (`len' chars long, -1 to count), return at most
+  // `maxcount' fields, last one holds the rest of the source
+  void reset( const VS_CHAR* source, int len = -1, int maxcount = -1 );
+  int  next(); // advance to the next field, return 0 at the end
+
+  const VS_CHAR* ptr() { return src + fs; } // current field, not 0-terminated!
+  int len()   { return fl; }                 // current field length
+  int sp()    { return fs; }                 // current field start position
+  int ep()    { return fs + fl; }            // current field end position
+  int count() { return fc; }                 // fields returned so far
+
+  VS_STRING_CLASS str() // current field copy
+    { VS_STRING_CLASS s; s.setn( src + fs, fl ); return s; }
+  VS_STRING_CLASS& str( VS_STRING_CLASS& dest ) // same, reuses `dest' buffer
+    { dest.setn( src + fs, fl ); return dest; }
+};
+
+/***************************************************************************
+**
+** VCSV
+**
+****************************************************************************/
+/*
+** quote-aware CSV/TSV reader. quoted fields may contain delimiters,
+** newlines and doubled quotes (""). rows end with \n or \r\n outside
+** quotes, empty lines give rows with no fields. `quote' 0 disables quoting
+** (plain TSV). malformed input is read as is: chars after closing quote
+** are kept, unterminated quote runs to the end of data.
+**
+** current row is kept in single flat buffer, fields are unescaped and
+** 0-terminated. memory data is parsed in place, files are read in windows
+** (regular ones are mapped), so memory use depends only on the longest row.
+** wide readers decode files as multi-byte strings (see str_mbs_decode()).
+**
+**   VCSV csv;
+**   if( csv.open( "data.csv" ) == 0 )
+**     while( csv.next() )
+**       printf( "%d fields, first is %s\n", csv.count(), csv[0] );
+**
+*/
+
+class VS_CSV_CLASS
+{
+  VS_CHAR          dc;     // delimiter
+  VS_CHAR          qc;     // quote, 0 for none
+
+  /* input data, external or `sb' */
+  const VS_CHAR*   in;
+  size_t           il;     // input length
+  size_t           ip;     // parse position
+  int              eof;    // no more data after `il'
+
+  /* stream input */
+  FILE*            f;
+  int              own_f;  // `f' is opened here
+  const char*      mp;     // mapped file, for wide streams
+  size_t           ml;     // mapped file size
+  size_t           mr;     // mapped bytes already read
+  VS_CHAR*         sb;     // stream buffer, decoded
+  size_t           sbl;
+  size_t           sbs;
+  char*            rb;     // raw bytes, wide streams only
+  size_t           rbl;
+  size_t           rbs;
+
+  /* current row */
+  VS_CHAR*         fb;     // fields, each one 0-terminated
+  int              fbl;
+  int              fbs;
+  int*             fo;     // field offsets in `fb'
+  int              fc;
+  int              fos;
+
+  int  parse();
+  int  fill();
+  int  put( const VS_CHAR* s, int len );
+  int  field();
+  size_t read( char* buf, size_t len );
+
+  VS_CSV_CLASS( const VS_CSV_CLASS& );                // no copy
+  VS_CSV_CLASS& operator = ( const VS_CSV_CLASS& );   // no copy
+
+  public:
+
+  VS_CSV_CLASS( VS_CHAR delim = VS_CHAR_L(','), VS_CHAR quote = VS_CHAR_L('"') );
+  ~VS_CSV_CLASS();
+
+  void reset( const VS_CHAR* source, long len = -1 ); // read rows from memory, `source' must stay intact
+  int  open( const char* fname ); // read rows from file, return 0 for ok, 1 open error
+  int  open( FILE* a_f ); // read rows from `a_f' (will not be closed), return 0 for ok
+  void close();
+
+  int  next(); // read next row, return 0 at the end
+
+  int count() const { return fc; }; // current row fields count
+  const VS_CHAR* get( int n ) const // field at `n', NULL if out of range
+    { return n >= 0 && n < fc ? fb + fo[n] : NULL; };
+  int len( int n ) const // field length, -1 if out of range
+    { return n >= 0 && n < fc ? fo[n+1] - fo[n] - 1 : -1; };
+  int row( VS_ARRAY_CLASS& dest ) const; // append current row fields to `dest', return fields count
+
+  const VS_CHAR* operator []( int n ) const
+    { const VS_CHAR* ps = get( n ); return ps ? ps : VS_CHAR_L(""); };
+};
+
 /***************************************************************************
 **
 ** UTILITIES
 **
 ****************************************************************************/
 
-// split `source' with `regexp_str' regexp
+// split `source' with `regexp_str' regexp. delimiters without regexp
+// special chars are searched as plain strings. empty matches split between
+// chars, trailing empty field is dropped
 VS_ARRAY_CLASS str_split( const VS_CHAR* regexp_str, const VS_CHAR* source, int maxcount = -1 );
+// same, but appends fields to `dest', returns fields count (-1 for bad regexp)
+int str_split( VS_ARRAY_CLASS& dest, const VS_CHAR* regexp_str, const VS_CHAR* source, int maxcount = -1 );
+// same, but creates no strings: stores start and end positions of first
+// `max_fields' fields in `pos' (2 ints per field), returns fields count
+int str_split_pos( int* pos, int max_fields, const VS_CHAR* regexp_str, const VS_CHAR* source, int maxcount = -1 );
 
 // split `source' with exact string `delimiter_str'
 VS_ARRAY_CLASS str_split_simple( const VS_CHAR* delimiter_str, const VS_CHAR* source, int maxcount = -1 );
 
 // join array data to single string with `glue' string
 // returns the result string or store to optional `dest'
-VS_STRING_CLASS str_join( VS_ARRAY_CLASS array, const VS_CHAR* glue = VS_CHAR_L("") );
+VS_STRING_CLASS str_join( const VS_ARRAY_CLASS& array, const VS_CHAR* glue = VS_CHAR_L("") );
+// append `cnt' elements from `n' (negative counts from the end, -1 for all
+// to the end) to `dest', result length is summed first and `dest' grows once
+VS_STRING_CLASS& str_join( VS_STRING_CLASS& dest, const VS_ARRAY_CLASS& array, const VS_CHAR* glue = VS_CHAR_L(""), int n = 0, int cnt = -1 );
+// join trie keys or values, same order as VS_TRIE_CLASS::keys_and_values()
+VS_STRING_CLASS str_join_keys  ( const VS_TRIE_CLASS& trie, const VS_CHAR* glue = VS_CHAR_L("") );
+VS_STRING_CLASS str_join_values( const VS_TRIE_CLASS& trie, const VS_CHAR* glue = VS_CHAR_L("") );
+
+// append fields of the first CSV row in `source' to `dest', returns fields count
+int str_csv_split( VS_ARRAY_CLASS& dest, const VS_CHAR* source, VS_CHAR delim = VS_CHAR_L(','), VS_CHAR quote = VS_CHAR_L('"') );
+
+// return elements of `arr' which match (or do not match if `invert') `re'
+// or `pattern' (see VS_REGEXP_CLASS::comp() for `opt'), pattern is compiled
+// once and large arrays are matched in parallel (see VS_ARRAY_CLASS::grep())
+VS_ARRAY_CLASS str_grep( VS_ARRAY_CLASS& arr, VS_REGEXP_CLASS& re, int invert = 0 );
+VS_ARRAY_CLASS str_grep( VS_ARRAY_CLASS& arr, const VS_CHAR* pattern, const VS_CHAR* opt = NULL, int invert = 0 );
+// append matching elements to `dest', returns their count or -1 for bad pattern
+int str_grep( VS_ARRAY_CLASS& dest, VS_ARRAY_CLASS& arr, VS_REGEXP_CLASS& re, int invert = 0 );
+int str_grep( VS_ARRAY_CLASS& dest, VS_ARRAY_CLASS& arr, const VS_CHAR* pattern, const VS_CHAR* opt = NULL, int invert = 0 );
 
 /*****************************************************************************
 **
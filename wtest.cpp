@@ -589,6 +589,258 @@ void test11()
   ASSERT( sfn_match( "vf*[u*xz", "vfu tar tar.xz" ) != 0 );
 }
 
+void test12()
+{
+  // bulk conversion in fload() matches per-string conversion, bad bytes included
+  const char* fn = "/tmp/wstring.test12";
+  FILE* f = fopen( fn, "wb" );
+  ASSERT( f );
+  fputs( "one\r\n\n\xD0\xBF\xD1\x80\xD0\xBE\xD0\xB1\xD0\xB0\n\xD1\x8E\xFF\xD1\nlast", f );
+  fclose( f );
+
+  VArray va;
+  WArray wa;
+  ASSERT( va.fload( fn ) == 0 );
+  ASSERT( wa.fload( fn ) == 0 );
+  ASSERT( wa.count() == 5 && va.count() == 5 );
+  for( int i = 0; i < va.count(); i++ )
+    {
+    WString ws;
+    ws.set_failsafe( va[i] );
+    ASSERT( wa[i] == ws );
+    }
+  ASSERT( wa[0] == L"one" && wa[1] == L"" && wa[4] == L"last" );
+
+  WArray wb;
+  f = fopen( fn, "rb" );
+  ASSERT( wb.fload( f ) == 0 );
+  fclose( f );
+  ASSERT( wb.count() == wa.count() && wb[3] == wa[3] );
+  remove( fn );
+}
+
+void test13()
+{
+  // wide fsave() converts in bulk, output equals per-string conversion
+  const char* fn = "/tmp/wstring.test13";
+  WArray wa;
+  wa.push( L"one" );
+  wa.push( L"" );
+  if ( MB_CUR_MAX > 1 ) wa.push( L"\x43f\x440\x43e\x431\x430 \x2603" );
+  WString big = L"xyz";
+  str_mul( big, 100000 );
+  wa.push( big );
+  ASSERT( wa.fsave( fn ) == 0 );
+  VArray va;
+  ASSERT( va.fload( fn ) == 0 );
+  ASSERT( va.count() == wa.count() );
+  for( int i = 0; i < wa.count(); i++ )
+    ASSERT( va[i] == VString( wa[i] ) );
+
+  WTrie tr;
+  tr[L"k1"] = L"v1";
+  tr[L"k2"] = big;
+  ASSERT( tr.fsave( fn ) == 0 );
+  WTrie tt;
+  ASSERT( tt.fload( fn ) == 0 );
+  ASSERT( tt[L"k1"] == L"v1" && tt[L"k2"] == big && tt.count() == 2 );
+  remove( fn );
+}
+
+void test14()
+{
+  // wide binary files hold wchar_t, narrow readers refuse them
+  const char* fn = "/tmp/wstring.test14";
+  WArray wa;
+  wa.push( L"\x43f\x440\x43e\x431\x430" );
+  wa.push( L"two\nlines" );
+  ASSERT( wa.bsave( fn ) == 0 );
+  WArrayMap wm;
+  ASSERT( wm.open( fn ) == 0 && wm.count() == 2 );
+  ASSERT( wcscmp( wm[0], L"\x43f\x440\x43e\x431\x430" ) == 0 && wm.len( 1 ) == 9 );
+  WArray wb;
+  ASSERT( wb.bload( fn ) == 0 && wb.count() == 2 && wb[1] == L"two\nlines" );
+  VArray va;
+  ASSERT( va.bload( fn ) == 3 );
+  remove( fn );
+}
+
+void test15()
+{
+  // grep/map on wide arrays
+  WArray wa;
+  wa.push( L"\x43f\x440\x43e\x431\x430" );
+  wa.push( L"two" );
+  wa.push( L"\x43f\x440\x43e\x441\x442\x43e" );
+  WArray wg = str_grep( wa, L"^\x43f\x440\x43e" );
+  ASSERT( wg.count() == 2 && wg[1] == L"\x43f\x440\x43e\x441\x442\x43e" );
+  wg = str_grep( wa, L"\x43f\x440\x43e", L"f", 1 );
+  ASSERT( wg.count() == 1 && wg[0] == L"two" );
+}
+
+void test16()
+{
+  // wide tokenizer, charset with chars above 256
+  WTokenizer tk;
+  tk.set_charset( L" \x2014" );
+  tk.reset( L"\x43f\x440\x43e\x2014two three" );
+  ASSERT( tk.next() && tk.str() == L"\x43f\x440\x43e" );
+  ASSERT( tk.next() && tk.str() == L"two" && tk.next() && tk.str() == L"three" && ! tk.next() );
+  tk.set_regexp( L"\x43e+" );
+  tk.reset( L"a\x43e\x43e" L"b" );
+  ASSERT( tk.next() && tk.str() == L"a" && tk.next() && tk.str() == L"b" && ! tk.next() );
+}
+
+void test17()
+{
+  // wide CSV, files are decoded from multi-byte
+  WCSV csv;
+  csv.reset( L"\x43f\x440\x43e,\"\x431\x430,\"\"x\"\"\"\n" );
+  ASSERT( csv.next() && csv.count() == 2 && wcscmp( csv[1], L"\x431\x430,\"x\"" ) == 0 && ! csv.next() );
+
+  VString lc = setlocale( LC_CTYPE, NULL );
+  if ( ! setlocale( LC_CTYPE, "C.UTF-8" ) ) return;
+  const char* fn = "/tmp/wstring.test17";
+  FILE* f = fopen( fn, "wb" );
+  for( int i = 0; i < 50000; i++ )
+    fprintf( f, "%d,\"\xd0\xbf\xd1\x80\xd0\xbe\n\xd0\xb1\xd0\xb0\"\n", i );
+  fclose( f );
+  for( int pass = 0; pass < 2; pass++ )
+    {
+    f = fopen( fn, "rb" );
+    ASSERT( pass == 0 ? csv.open( fn ) == 0 : csv.open( f ) == 0 );
+    int n = 0;
+    while( csv.next() )
+      {
+      ASSERT( csv.count() == 2 && wcstol( csv[0], NULL, 10 ) == n );
+      ASSERT( wcscmp( csv[1], L"\x43f\x440\x43e\n\x431\x430" ) == 0 );
+      n++;
+      }
+    ASSERT( n == 50000 );
+    csv.close();
+    fclose( f );
+    }
+  remove( fn );
+  setlocale( LC_CTYPE, lc );
+}
+
+void test18()
+{
+  // wide trie keys keep chars order, incl. ones above 16 bits
+  WTrie tr;
+  tr[L"\x43f\x440\x43e"] = L"1";
+  tr[L"\x43f\x440"]      = L"2";
+  tr[L"\x1F600"]         = L"3";
+  tr[L"z"]               = L"4";
+  tr[L"\x7FFFFFFF"]      = L"5";
+  tr[L"\x43f" L"a"]      = L"6";
+  ASSERT( tr.count() == 6 && tr.count( L"\x43f" ) == 3 && tr.count( L"\x43f\x440" ) == 2 );
+  ASSERT( tr[L"\x1F600"] == L"3" && tr[L"\x7FFFFFFF"] == L"5" && ! tr.exists( L"\x43f" ) );
+  WArray ka = tr.keys();
+  ASSERT( ka.count() == 6 );
+  ASSERT( ka[0] == L"z" && ka[1] == L"\x43f" L"a" && ka[2] == L"\x43f\x440" && ka[5] == L"\x7FFFFFFF" );
+  for( int i = 1; i < ka.count(); i++ )
+    ASSERT( wcscmp( ka[i-1], ka[i] ) < 0 );
+  int n = 0;
+  for( const WTrie::entry& e : tr )
+    ASSERT( ka[n++] == e.key );
+  tr.del( L"\x43f", 1 );
+  ASSERT( tr.count() == 3 && tr[L"z"] == L"4" );
+}
+
+void test19()
+{
+  // wide hash
+  WHash hs;
+  WString k;
+  for( int i = 0; i < 5000; i++ )
+    {
+    k = L"\x43a\x43b\x44e\x447-";
+    k += i;
+    hs[k] = i;
+    }
+  ASSERT( hs.count() == 5000 && hs[L"\x43a\x43b\x44e\x447-4999"] == L"4999" && ! hs.exists( L"\x43a" ) );
+  hs.del( L"\x43a\x43b\x44e\x447-0" );
+  WHash hc = hs;
+  hc[L"\x1F600"] = L"x";
+  ASSERT( hs.count() == 4999 && hc.count() == 5000 && hc[L"\x1F600"] == L"x" && ! hs.exists( L"\x1F600" ) );
+  int n = 0;
+  for( const WHash::entry& e : hc )
+    n += wcslen( e.key ) > 0;
+  ASSERT( n == 5000 );
+}
+
+int test20_count( const wchar_t*, const wchar_t*, void* arg )
+{
+  (*(int*)arg)++;
+  return 0;
+}
+
+void test20()
+{
+  // wide trie prefix and range queries
+  WTrie tr;
+  WString k;
+  for( int i = 0; i < 300; i++ )
+    {
+    k = L"\x43a\x43b\x44e\x447/";
+    k += i;
+    tr[k] = i;
+    }
+  tr[L"\x43a\x43b\x44e\x447"] = L"root";
+  int len;
+  const wchar_t* ps = tr.longest_prefix( L"\x43a\x43b\x44e\x447/1000", &len );
+  ASSERT( ps && wcscmp( ps, L"100" ) == 0 && len == 8 );
+  ps = tr.longest_prefix( L"\x43a\x43b\x44e\x447/x", &len );
+  ASSERT( ps && wcscmp( ps, L"root" ) == 0 && len == 4 );
+  ASSERT( tr.keys_with_prefix( L"\x43a\x43b\x44e\x447/2" ).count() == 111 );
+  int n = 0;
+  ASSERT( tr.walk_range( L"\x43a\x43b\x44e\x447/10", L"\x43a\x43b\x44e\x447/11", test20_count, &n ) == 11 && n == 11 );
+  WTrie::const_iterator it = tr.lower_bound( L"\x43a\x43b\x44e\x447/99" );
+  ASSERT( it != tr.end() && wcscmp( it->key, L"\x43a\x43b\x44e\x447/99" ) == 0 && ++it == tr.end() );
+}
+
+void test21()
+{
+  // wide compiled trie image
+  const char* fn = "/tmp/vstring.wtest21";
+  WTrie tr;
+  WString k;
+  for( int i = 0; i < 500; i++ )
+    {
+    k = i % 2 ? L"\x43a\x43b\x44e\x447/" : L"\x1F600/";
+    k += i;
+    tr[k] = L"\x437\x43d\x430\x447";
+    }
+  ASSERT( tr.bsave( fn ) == 0 );
+  WTrieMap tm;
+  ASSERT( tm.open( fn ) == 0 && tm.count() == 500 && tm.count( L"\x1F600" ) == 250 );
+  ASSERT( wcscmp( tm[L"\x43a\x43b\x44e\x447/499"], L"\x437\x43d\x430\x447" ) == 0 && ! tm.exists( L"\x43a" ) );
+  WArray a = tr.keys_with_prefix( L"\x43a\x43b\x44e\x447/1" );
+  WArray b = tm.keys_with_prefix( L"\x43a\x43b\x44e\x447/1" );
+  ASSERT( a.count() == 56 && a.count() == b.count() && a[55] == b[55] );
+  VTrieMap vm;
+  ASSERT( vm.open( fn ) == 3 ); // char size differs
+  remove( fn );
+}
+
+void test22()
+{
+  // wide double-array trie, keys are walked as UTF-8 bytes
+  WTrie tr;
+  WString k;
+  for( int i = 0; i < 500; i++ )
+    {
+    k = i % 2 ? L"\x43a\x43b\x44e\x447/" : L"\x1F600/";
+    k += i;
+    tr[k] = i;
+    }
+  WDATrie da;
+  ASSERT( da.build( tr ) == 0 && da.count() == 500 );
+  ASSERT( wcscmp( da[L"\x43a\x43b\x44e\x447/499"], L"499" ) == 0 && wcscmp( da[L"\x1F600/0"], L"0" ) == 0 );
+  ASSERT( ! da.exists( L"\x43a" ) && ! da.exists( L"\x1F600/" ) && ! da.exists( L"\x1F601/0" ) );
+}
+
 int main( void )
 {
   setlocale( LC_ALL, "" );
@@ -661,6 +913,17 @@ int main( void )
   #endif
   test10();
   test11();
+  test12();
+  test13();
+  test14();
+  test15();
+  test16();
+  test17();
+  test18();
+  test19();
+  test20();
+  test21();
+  test22();
 
   #endif
   return 0;